@@ -0,0 +1,12 @@
+// global descriptor set shared by all pipelines, see renderer.bindless
+#define BINDLESS_SET 0
+#define BINDLESS_SAMPLED_IMAGES 0
+#define BINDLESS_STORAGE_IMAGES 1
+#define BINDLESS_STORAGE_BUFFERS 2
+
+layout(set = BINDLESS_SET, binding = BINDLESS_SAMPLED_IMAGES) uniform sampler2D bindless_textures[];
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_IMAGES, rgba16f) uniform image2D bindless_images_rgba16f[];
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_IMAGES, rgba8) uniform image2D bindless_images_rgba8[];
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_IMAGES, r32f) uniform image2D bindless_images_r32f[];
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_IMAGES, rg32ui) uniform uimage2D bindless_images_rg32ui[];
+// storage buffers are declared per shader as arrays at BINDLESS_STORAGE_BUFFERS
\ No newline at end of file
@@ -0,0 +1,12 @@
+// color space conversions shared by all passes writing to the swapchain
+float linear_to_srgb (float col_linear) {
+  return col_linear <= 0.0031308
+       ? col_linear * 12.92
+       : pow(col_linear, 1.0/2.4) * 1.055 - 0.055;
+}
+vec3 linear_to_srgb (vec3 col_linear) {
+    col_linear.r = linear_to_srgb(col_linear.r);
+    col_linear.g = linear_to_srgb(col_linear.g);
+    col_linear.b = linear_to_srgb(col_linear.b);
+    return col_linear;
+}
\ No newline at end of file
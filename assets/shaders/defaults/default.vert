@@ -1,4 +1,7 @@
 #version 460
+#extension GL_ARB_shading_language_include: require
+#extension GL_EXT_nonuniform_qualifier: require
+#include "defaults/bindless.glsl"
 
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_normal;
@@ -8,14 +11,28 @@ layout(location = 1) out vec3 out_normal;
 layout(location = 2) out vec3 out_color;
 
 // Camera view and projection matrix
-layout(set = 0, binding = 0) uniform Camera {
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFERS) readonly buffer Camera {
     mat4x4 matrix;
-} camera;
+} cameras[];
+// Per-instance transform and color, indexed by the draw's first instance
+struct Instance {
+    mat4 transform;
+    vec4 color;
+    uint mesh_i;
+};
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFERS, std430) readonly buffer Instances {
+    Instance instances[];
+} instance_buffers[];
+layout(push_constant) uniform PushConstants {
+    uint camera_i;
+    uint instances_i;
+} push;
 
 void main() {
-    gl_Position = vec4(in_position, 1.0);
+    Instance instance = instance_buffers[push.instances_i].instances[gl_InstanceIndex];
+    gl_Position = instance.transform * vec4(in_position, 1.0);
     out_position = gl_Position.xyz;
-    gl_Position = camera.matrix * gl_Position;
-    out_normal = in_normal;
-    out_color = in_color;
+    gl_Position = cameras[push.camera_i].matrix * gl_Position;
+    out_normal = normalize(mat3(instance.transform) * in_normal);
+    out_color = in_color * instance.color.rgb;
 }
\ No newline at end of file
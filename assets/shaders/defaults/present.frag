@@ -0,0 +1,21 @@
+#version 460
+#extension GL_ARB_shading_language_include: require
+#extension GL_EXT_nonuniform_qualifier: require
+#include "defaults/bindless.glsl"
+#include "defaults/color.glsl"
+
+layout(constant_id = 0) const uint image_srgb = 1; // boolean
+layout(location = 0) in vec2 in_uv;
+layout(location = 0) out vec4 out_color;
+layout(push_constant) uniform PushConstants {
+    vec2 uv_scale; // rendered fraction of the image
+    vec2 uv_max; // keeps bilinear filtering within the rendered region
+    uint color_i;
+} push;
+
+// upscale and tone map the final image while writing it into the swapchain
+void main() {
+    vec2 uv = min(in_uv * push.uv_scale, push.uv_max);
+    out_color = texture(bindless_textures[push.color_i], uv);
+    if (image_srgb > 0) out_color.rgb = linear_to_srgb(out_color.rgb);
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#version 460
+#extension GL_ARB_shading_language_include: require
+#extension GL_EXT_nonuniform_qualifier: require
+#extension GL_EXT_shader_explicit_arithmetic_types_int64: require
+#include "defaults/bindless.glsl"
+
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFERS, std430) readonly buffer Target {
+    uint64_t pixels[];
+} target_buffers[];
+layout(constant_id = 0) const uint fill_holes = 1; // boolean
+layout(location = 0) out vec4 out_color;
+layout(push_constant) uniform PushConstants {
+    uint target_i;
+    uint target_width;
+    uvec2 render_size;
+} push;
+
+const uint64_t empty = 0xffffffffffffffffUL;
+
+uint64_t load(ivec2 pixel) {
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThanEqual(pixel, ivec2(push.render_size)))) return empty;
+    return target_buffers[push.target_i].pixels[pixel.y * push.target_width + pixel.x];
+}
+
+// write the nearest point of each pixel into the scene's color and depth, which test against the meshes
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint64_t value = load(pixel);
+    // gaps between sparse points take the nearest neighbour if the pixel is mostly surrounded
+    if (fill_holes > 0 && value == empty) {
+        uint covered = 0;
+        for (int y = -1; y <= 1; y++) {
+            for (int x = -1; x <= 1; x++) {
+                uint64_t neighbour = load(pixel + ivec2(x, y));
+                if (neighbour == empty) continue;
+                covered++;
+                value = min(value, neighbour);
+            }
+        }
+        if (covered < 4) value = empty;
+    }
+    if (value == empty) discard;
+    out_color = vec4(unpackUnorm4x8(uint(value)).rgb, 1.0);
+    gl_FragDepth = uintBitsToFloat(uint(value >> 32));
+}
\ No newline at end of file
@@ -1,3 +1,11 @@
+// quality is picked at pipeline creation following the SMAA presets, see ext.smaa
+layout(constant_id = 4) const float SMAA_THRESHOLD_SPEC = 0.05;
+layout(constant_id = 5) const int SMAA_MAX_SEARCH_STEPS_SPEC = 32;
+layout(constant_id = 6) const int SMAA_MAX_SEARCH_STEPS_DIAG_SPEC = 16;
+layout(constant_id = 7) const int SMAA_CORNER_ROUNDING_SPEC = 25;
+#define SMAA_THRESHOLD SMAA_THRESHOLD_SPEC
+#define SMAA_MAX_SEARCH_STEPS SMAA_MAX_SEARCH_STEPS_SPEC
+#define SMAA_MAX_SEARCH_STEPS_DIAG SMAA_MAX_SEARCH_STEPS_DIAG_SPEC
+#define SMAA_CORNER_ROUNDING SMAA_CORNER_ROUNDING_SPEC
 #define SMAA_GLSL_4
-#define SMAA_PRESET_ULTRA
 #include "SMAA.hlsl"
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 460
+
+layout(location = 0) flat in uint in_instance_i;
+layout(location = 0) out uvec2 out_ids;
+
+// zero is left by the clear for pixels without geometry
+void main() {
+    out_ids = uvec2(in_instance_i + 1, gl_PrimitiveID);
+}
\ No newline at end of file
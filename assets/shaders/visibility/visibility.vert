@@ -0,0 +1,33 @@
+#version 460
+#extension GL_ARB_shading_language_include: require
+#extension GL_EXT_nonuniform_qualifier: require
+#include "defaults/bindless.glsl"
+
+layout(location = 0) in vec3 in_position;
+// unused, declared to keep the vertex stride of the shared geometry buffer
+layout(location = 1) in vec3 in_normal;
+layout(location = 2) in vec3 in_color;
+layout(location = 0) flat out uint out_instance_i;
+
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFERS) readonly buffer Camera {
+    mat4x4 matrix;
+} cameras[];
+struct Instance {
+    mat4 transform;
+    vec4 color;
+    uint mesh_i;
+};
+layout(set = BINDLESS_SET, binding = BINDLESS_STORAGE_BUFFERS, std430) readonly buffer Instances {
+    Instance instances[];
+} instance_buffers[];
+layout(push_constant) uniform PushConstants {
+    uint camera_i;
+    uint instances_i;
+} push;
+
+// position only, attributes are fetched once per pixel by the shading pass
+void main() {
+    Instance instance = instance_buffers[push.instances_i].instances[gl_InstanceIndex];
+    gl_Position = cameras[push.camera_i].matrix * instance.transform * vec4(in_position, 1.0);
+    out_instance_i = gl_InstanceIndex;
+}
\ No newline at end of file
@@ -9,4 +9,4 @@ FetchContent_Declare(cme
 FetchContent_MakeAvailable(cme)
 
 cme_create_library(datasets STATIC CXX_MODULE BASE_DIR "${CMAKE_CURRENT_SOURCE_DIR}/assets/datasets")
-target_link_libraries(${PROJECT_NAME} PRIVATE cme::datasets)
\ No newline at end of file
+target_link_libraries(${PROJECT_NAME}_core PUBLIC cme::datasets)
\ No newline at end of file
@@ -18,8 +18,8 @@ if (NOT glm_FOUND)
 endif()
 
 # link glm
-target_compile_definitions(${PROJECT_NAME} PRIVATE
+target_compile_definitions(${PROJECT_NAME}_core PUBLIC
     "GLM_FORCE_DEPTH_ZERO_TO_ONE"
     "GLM_FORCE_ALIGNED_GENTYPES"
     "GLM_FORCE_INTRINSICS")
-target_link_libraries(${PROJECT_NAME} PRIVATE glm::glm)
\ No newline at end of file
+target_link_libraries(${PROJECT_NAME}_core PUBLIC glm::glm)
\ No newline at end of file
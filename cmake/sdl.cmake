@@ -12,4 +12,4 @@ if (NOT SDL3_FOUND)
         SYSTEM)
     FetchContent_MakeAvailable(sdl)
 endif()
-target_link_libraries(${PROJECT_NAME} PRIVATE SDL3::SDL3)
+target_link_libraries(${PROJECT_NAME}_core PUBLIC SDL3::SDL3)
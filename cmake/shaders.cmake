@@ -14,7 +14,7 @@ FetchContent_Declare(spirv-reflect
     EXCLUDE_FROM_ALL
     SYSTEM)
 FetchContent_MakeAvailable(spirv-reflect)
-target_link_libraries(${PROJECT_NAME} PRIVATE spirv-reflect-static)
+target_link_libraries(${PROJECT_NAME}_core PRIVATE spirv-reflect-static)
 
 # SMAA for anti-aliasing
 FetchContent_Declare(smaa
@@ -25,7 +25,7 @@ FetchContent_Declare(smaa
     EXCLUDE_FROM_ALL
     SYSTEM)
 FetchContent_MakeAvailable(smaa)
-target_include_directories(${PROJECT_NAME} SYSTEM PRIVATE "${smaa_SOURCE_DIR}/Textures")
+target_include_directories(${PROJECT_NAME}_core SYSTEM PRIVATE "${smaa_SOURCE_DIR}/Textures")
 
 # SPVRC for shader compilation and embedding
 set(SPVRC_SHADER_ENV "vulkan1.3")
@@ -39,4 +39,4 @@ FetchContent_Declare(spvrc
     EXCLUDE_FROM_ALL
     SYSTEM)
 FetchContent_MakeAvailable(spvrc)
-target_link_libraries(${PROJECT_NAME} PRIVATE spvrc::spvrc)
\ No newline at end of file
+target_link_libraries(${PROJECT_NAME}_core PRIVATE spvrc::spvrc)
\ No newline at end of file
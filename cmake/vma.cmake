@@ -25,6 +25,6 @@ if (NOT VulkanMemoryAllocator-Hpp_FOUND)
     FetchContent_MakeAvailable(vulkanmemoryallocator-hpp)
 endif()
 
-target_link_libraries(${PROJECT_NAME} PRIVATE 
+target_link_libraries(${PROJECT_NAME}_core PUBLIC 
     GPUOpen::VulkanMemoryAllocator
     VulkanMemoryAllocator-Hpp::VulkanMemoryAllocator-Hpp)
\ No newline at end of file
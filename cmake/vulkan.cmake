@@ -25,7 +25,7 @@ if(NOT TARGET Vulkan::HppModule)
         FILES "${Vulkan_INCLUDE_DIR}/vulkan/vulkan.cppm")
 endif()
 
-target_link_libraries(${PROJECT_NAME} PRIVATE Vulkan::HppModule)
+target_link_libraries(${PROJECT_NAME}_core PUBLIC Vulkan::HppModule)
 target_compile_definitions(Vulkan-HppModule PUBLIC
     "VK_NO_PROTOTYPES"
     "VULKAN_HPP_ENABLE_STD_MODULE"
@@ -0,0 +1,252 @@
+module;
+#include <glm/glm.hpp>
+module bench.benchmark;
+import bench.procedural;
+import scene.camera;
+import scene.instances;
+
+using Clock = std::chrono::steady_clock;
+auto elapsed_ms(Clock::time_point begin, Clock::time_point end) -> double {
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+auto get_percentiles(std::vector<double> samples) -> Benchmark::Percentiles {
+    if (samples.empty()) return {};
+    std::sort(samples.begin(), samples.end());
+    // nearest rank
+    auto rank = [&](double p) { return samples[(std::size_t)std::max(0.0, std::ceil(p * (double)samples.size()) - 1.0)]; };
+    return {
+        .mean = std::accumulate(samples.cbegin(), samples.cend(), 0.0) / (double)samples.size(),
+        .p50 = rank(0.50),
+        .p95 = rank(0.95),
+        .p99 = rank(0.99),
+        .max = samples.back(),
+    };
+}
+auto get_name(AntiAliasing antialiasing) -> std::string_view {
+    switch (antialiasing) {
+        case AntiAliasing::eOff: return "off";
+        case AntiAliasing::eFXAA: return "fxaa";
+        case AntiAliasing::eSMAALow: return "smaa_low";
+        case AntiAliasing::eSMAAMedium: return "smaa_medium";
+        case AntiAliasing::eSMAAHigh: return "smaa_high";
+        case AntiAliasing::eSMAAUltra: return "smaa_ultra";
+    }
+    return "unknown";
+}
+auto get_name(Benchmark::Kind kind) -> std::string_view {
+    return kind == Benchmark::Kind::eMesh ? "mesh" : "grid";
+}
+auto parse_extent(std::string_view str) -> std::optional<vk::Extent2D> {
+    std::size_t x = str.find('x');
+    if (x == std::string_view::npos) return std::nullopt;
+    vk::Extent2D extent;
+    std::from_chars(str.data(), str.data() + x, extent.width);
+    std::from_chars(str.data() + x + 1, str.data() + str.size(), extent.height);
+    return extent;
+}
+// comma separated list, "none" yields an empty list
+auto split(std::string_view str) -> std::vector<std::string_view> {
+    std::vector<std::string_view> parts;
+    if (str == "none") return parts;
+    for (auto part: std::views::split(str, ',')) parts.emplace_back(part.begin(), part.end());
+    return parts;
+}
+
+void Benchmark::parse_arguments(int argc, char** argv) {
+    // --meshes <n,..>, --grids <n,..>, --resolutions <WxH,..>, --aa <mode,..>, --frames <n>, --warmup <n>, --output <file.json>
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if ((arg == "--meshes" || arg == "--grids") && has_value) {
+            auto& sizes = arg == "--meshes" ? _mesh_sizes : _grid_sizes;
+            sizes.clear();
+            for (auto part: split(argv[++i])) sizes.push_back(std::stoull(std::string(part)));
+        }
+        else if (arg == "--resolutions" && has_value) {
+            _resolutions.clear();
+            for (auto part: split(argv[++i])) {
+                auto extent = parse_extent(part);
+                if (extent.has_value()) _resolutions.push_back(extent.value());
+                else std::println("Invalid resolution {}, expected <width>x<height>", part);
+            }
+        }
+        else if (arg == "--aa" && has_value) {
+            _antialiasing.clear();
+            for (auto part: split(argv[++i])) {
+                bool found = false;
+                for (uint32_t mode = 0; mode <= (uint32_t)AntiAliasing::eSMAAUltra && !found; mode++) {
+                    if (get_name((AntiAliasing)mode) != part) continue;
+                    _antialiasing.push_back((AntiAliasing)mode);
+                    found = true;
+                }
+                if (!found) std::println("Unknown anti-aliasing mode: {}", part);
+            }
+        }
+        else if (arg == "--frames" && has_value) _frames = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--warmup" && has_value) _warmup_frames = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--output" && has_value) _output_path = argv[++i];
+        else std::println("Unknown argument: {}", arg);
+    }
+    if (_resolutions.empty()) _resolutions.push_back({ 1280, 720 });
+    if (_antialiasing.empty()) _antialiasing.push_back(AntiAliasing::eOff);
+    _frames = std::max(_frames, 1u);
+}
+auto Benchmark::run() -> int {
+    // engine renders offscreen, frames are driven from here without a limit
+    std::vector<std::string> args { "chad_vis_bench", "--headless", "--size",
+        std::format("{}x{}", _resolutions.front().width, _resolutions.front().height) };
+    std::vector<char*> args_p;
+    for (auto& arg: args) args_p.push_back(arg.data());
+    Engine engine((int)args_p.size(), args_p.data());
+    engine._frame_limit = 0;
+    engine._scene._camera._scripted = true;
+    engine._renderer._profiler._enabled = true;
+
+    std::vector<Result> results;
+    for (uint64_t size: _mesh_sizes) results.push_back(run_scene(engine, Kind::eMesh, size));
+    for (uint64_t size: _grid_sizes) results.push_back(run_scene(engine, Kind::eGrid, size));
+    engine._device._logical.waitIdle();
+    write_json(engine, results);
+    return 0;
+}
+auto Benchmark::run_scene(Engine& engine, Kind kind, uint64_t size) -> Result {
+    Result result { .kind = kind, .size = size, .skipped = false };
+    
+    // skip geometry that would not fit into the largest device local heap alongside everything else
+    uint64_t vertex_estimate = kind == Kind::eMesh ? size / 2 : size * 8;
+    uint64_t index_estimate = kind == Kind::eMesh ? size * 3 : size * 36;
+    uint64_t bytes = vertex_estimate * sizeof(Procedural::Vertex) + index_estimate * sizeof(Procedural::Index);
+    vk::DeviceSize heap_size = 0;
+    auto mem_props = engine._device._physical.getMemoryProperties();
+    for (uint32_t i = 0; i < mem_props.memoryHeapCount; i++) {
+        if (mem_props.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) heap_size = std::max(heap_size, mem_props.memoryHeaps[i].size);
+    }
+    if (bytes > heap_size / 2 || index_estimate > std::numeric_limits<uint32_t>::max()) {
+        std::println("Skipping {} of size {}: ~{} MiB exceeds device memory", get_name(kind), size, bytes >> 20);
+        result.skipped = true;
+        return result;
+    }
+
+    // generate geometry on the CPU
+    std::vector<Procedural::Vertex> vertices;
+    std::vector<Procedural::Index> indices;
+    auto load_begin = Clock::now();
+    if (kind == Kind::eMesh) Procedural::sphere(size, vertices, indices);
+    else Procedural::grid(size, vertices, indices);
+    auto load_end = Clock::now();
+    result.load_ms = elapsed_ms(load_begin, load_end);
+    result.vertex_count = vertices.size();
+    result.triangle_count = indices.size() / 3;
+
+    // replace the current mesh once no frame reads it anymore
+    engine._device._logical.waitIdle();
+    MeshInstances& instances = engine._scene._instances;
+    instances.clear();
+    instances.add_instance(instances.add_mesh(vertices, indices, false), glm::mat4(1));
+    vertices = {};
+    indices = {};
+    auto upload_begin = Clock::now();
+    instances.upload(engine._device._vmalloc);
+    auto upload_end = Clock::now();
+    engine._scene._dirty = true;
+    result.upload_ms = elapsed_ms(upload_begin, upload_end);
+
+    // time to first frame at the current resolution and anti-aliasing mode
+    set_camera(engine, kind, 0);
+    engine.handle_iteration();
+    engine._device._logical.waitIdle();
+    result.first_frame_ms = elapsed_ms(upload_end, Clock::now());
+    std::println("{} {}: {} triangles, load {:.1f} ms, upload {:.1f} ms, first frame {:.1f} ms",
+        get_name(kind), size, result.triangle_count, result.load_ms, result.upload_ms, result.first_frame_ms);
+
+    for (auto extent: _resolutions) {
+        set_resolution(engine, extent);
+        for (auto antialiasing: _antialiasing) {
+            engine._device._logical.waitIdle();
+            engine._renderer.set_antialiasing(engine._device, engine._swapchain, antialiasing, false);
+            for (uint32_t frame = 0; frame < _warmup_frames; frame++) {
+                set_camera(engine, kind, frame);
+                engine.handle_iteration();
+            }
+
+            // cpu time covers the whole iteration including waits on frames in flight,
+            // gpu time is read back a few frames late but covers the same camera path
+            std::vector<double> cpu_ms, gpu_ms;
+            cpu_ms.reserve(_frames);
+            gpu_ms.reserve(_frames);
+            for (uint32_t frame = 0; frame < _frames; frame++) {
+                set_camera(engine, kind, frame);
+                auto begin = Clock::now();
+                engine.handle_iteration();
+                cpu_ms.push_back(elapsed_ms(begin, Clock::now()));
+                double frame_ms = engine._renderer._profiler.frame_ms();
+                if (frame_ms > 0.0) gpu_ms.push_back(frame_ms);
+            }
+            Run run { .extent = extent, .antialiasing = antialiasing, .cpu_ms = get_percentiles(cpu_ms), .gpu_ms = get_percentiles(gpu_ms) };
+            std::println("  {}x{} aa {}: cpu p50 {:.2f} p99 {:.2f} ms, gpu p50 {:.2f} p99 {:.2f} ms",
+                extent.width, extent.height, get_name(antialiasing), run.cpu_ms.p50, run.cpu_ms.p99, run.gpu_ms.p50, run.gpu_ms.p99);
+            result.runs.push_back(run);
+        }
+    }
+    return result;
+}
+void Benchmark::set_resolution(Engine& engine, vk::Extent2D extent) {
+    engine._device._logical.waitIdle();
+    engine._swapchain.destroy(engine._device);
+    engine._swapchain.init_headless(engine._device, extent, engine._frames_in_flight + 1);
+    engine._scene._camera.resize(extent);
+    engine._renderer.resize(engine._device, engine._swapchain);
+}
+void Benchmark::set_camera(Engine& engine, Kind kind, uint32_t frame) {
+    // orbit around the origin facing it, one revolution per measured frame count
+    float radius = kind == Kind::eMesh ? 2.5f : 3.5f;
+    float angle = 2.0f * std::numbers::pi_v<float> * (float)(frame % _frames) / (float)_frames;
+    Camera& camera = engine._scene._camera;
+    camera._pos = { -radius * std::sin(angle), 0.0f, -radius * std::cos(angle) };
+    camera._rot = { 0.0f, angle, 0.0f };
+}
+void Benchmark::write_json(Engine& engine, const std::vector<Result>& results) {
+    std::ofstream file(_output_path);
+    if (!file) {
+        std::println("Failed to open {}", _output_path);
+        return;
+    }
+    auto write_percentiles = [&](const Percentiles& p) {
+        std::print(file, R"({{ "mean": {:.4f}, "p50": {:.4f}, "p95": {:.4f}, "p99": {:.4f}, "max": {:.4f} }})", p.mean, p.p50, p.p95, p.p99, p.max);
+    };
+    auto props = engine._device._physical.getProperties();
+    std::println(file, "{{");
+    std::println(file, R"(  "device": "{}",)", std::string_view(props.deviceName.data()));
+    std::println(file, R"(  "warmup_frames": {},)", _warmup_frames);
+    std::println(file, R"(  "frames": {},)", _frames);
+    std::println(file, R"(  "scenes": [)");
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        std::println(file, "    {{");
+        std::println(file, R"(      "kind": "{}",)", get_name(result.kind));
+        std::println(file, R"(      "size": {},)", result.size);
+        if (result.skipped) std::println(file, R"(      "skipped": true)");
+        else {
+            std::println(file, R"(      "triangles": {},)", result.triangle_count);
+            std::println(file, R"(      "vertices": {},)", result.vertex_count);
+            std::println(file, R"(      "load_ms": {:.4f},)", result.load_ms);
+            std::println(file, R"(      "upload_ms": {:.4f},)", result.upload_ms);
+            std::println(file, R"(      "first_frame_ms": {:.4f},)", result.first_frame_ms);
+            std::println(file, R"(      "runs": [)");
+            for (std::size_t run_i = 0; run_i < result.runs.size(); run_i++) {
+                const Run& run = result.runs[run_i];
+                std::print(file, R"(        {{ "width": {}, "height": {}, "antialiasing": "{}", "cpu_ms": )",
+                    run.extent.width, run.extent.height, get_name(run.antialiasing));
+                write_percentiles(run.cpu_ms);
+                std::print(file, R"(, "gpu_ms": )");
+                write_percentiles(run.gpu_ms);
+                std::println(file, " }}{}", run_i + 1 < result.runs.size() ? "," : "");
+            }
+            std::println(file, "      ]");
+        }
+        std::println(file, "    }}{}", i + 1 < results.size() ? "," : "");
+    }
+    std::println(file, "  ]");
+    std::println(file, "}}");
+    std::println("Benchmark results written to {}", _output_path);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+export module bench.benchmark;
+import std;
+import vulkan_hpp;
+import core.engine;
+import renderer.renderer;
+
+// headless rendering benchmark over procedural scenes of increasing size
+// every scene is rendered at each resolution and anti-aliasing mode along the same camera orbit
+export struct Benchmark {
+    enum class Kind { eMesh, eGrid };
+    struct Percentiles {
+        double mean, p50, p95, p99, max;
+    };
+    struct Run {
+        vk::Extent2D extent;
+        AntiAliasing antialiasing;
+        Percentiles cpu_ms;
+        Percentiles gpu_ms;
+    };
+    struct Result {
+        Kind kind;
+        uint64_t size; // triangles for meshes, cells for grids
+        uint64_t triangle_count;
+        uint64_t vertex_count;
+        bool skipped; // geometry would not fit into device memory
+        double load_ms; // generating the geometry on the CPU
+        double upload_ms; // creating and filling the GPU buffers
+        double first_frame_ms; // from upload completion until the first frame finished on the GPU
+        std::vector<Run> runs;
+    };
+
+    void parse_arguments(int argc, char** argv);
+    auto run() -> int;
+
+    std::vector<uint64_t> _mesh_sizes = { 1'000'000, 10'000'000, 100'000'000 };
+    std::vector<uint64_t> _grid_sizes = { 1'000'000, 8'000'000 };
+    std::vector<vk::Extent2D> _resolutions = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    std::vector<AntiAliasing> _antialiasing = { AntiAliasing::eOff, AntiAliasing::eSMAAUltra };
+    uint32_t _warmup_frames = 16;
+    uint32_t _frames = 240; // one full orbit
+    std::string _output_path = "bench.json";
+
+private:
+    auto run_scene(Engine& engine, Kind kind, uint64_t size) -> Result;
+    void set_resolution(Engine& engine, vk::Extent2D extent);
+    void set_camera(Engine& engine, Kind kind, uint32_t frame);
+    void write_json(Engine& engine, const std::vector<Result>& results);
+};
\ No newline at end of file
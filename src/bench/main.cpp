@@ -0,0 +1,7 @@
+import bench.benchmark;
+
+int main(int argc, char** argv) {
+    Benchmark benchmark;
+    benchmark.parse_arguments(argc, argv);
+    return benchmark.run();
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+module;
+#include <glm/glm.hpp>
+module bench.micro;
+import scene.plymesh;
+import scene.grid;
+import scene.bvh;
+import bench.procedural;
+import core.parallel;
+
+using Clock = std::chrono::steady_clock;
+
+void MicroBenchmark::parse_arguments(int argc, char** argv) {
+    // --vertices <n>, --cells <n>, --triangles <n>, --queries <n>, --threads <n,..>, --repeats <n>, --output <file.csv>
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--vertices" && has_value) _vertex_count = std::stoull(argv[++i]);
+        else if (arg == "--cells" && has_value) _cell_count = std::stoull(argv[++i]);
+        else if (arg == "--triangles" && has_value) _bvh_triangle_count = std::stoull(argv[++i]);
+        else if (arg == "--queries" && has_value) _bvh_query_count = std::max(1u, (uint32_t)std::stoul(argv[++i]));
+        else if (arg == "--repeats" && has_value) _repeats = std::max(1u, (uint32_t)std::stoul(argv[++i]));
+        else if (arg == "--output" && has_value) _output_path = argv[++i];
+        else if (arg == "--threads" && has_value) {
+            std::string_view list = argv[++i];
+            for (auto part: std::views::split(list, ',')) {
+                uint32_t count = 0;
+                std::from_chars(part.data(), part.data() + part.size(), count);
+                if (count > 0) _thread_counts.push_back(count);
+            }
+        }
+        else std::println("Unknown argument: {}", arg);
+    }
+    // powers of two up to all hardware threads by default
+    if (_thread_counts.empty()) {
+        uint32_t max_threads = Parallel::default_thread_count();
+        for (uint32_t count = 1; count < max_threads; count *= 2) _thread_counts.push_back(count);
+        _thread_counts.push_back(max_threads);
+    }
+}
+auto MicroBenchmark::run() -> int {
+    // PLY: header, coordinate conversion, index conversion and the full parse
+    {
+        std::vector<uint8_t> data;
+        generate_ply(data);
+        auto header = Plymesh::parse_header(data.data());
+        if (!header.has_value()) {
+            std::println("Generated PLY is malformed");
+            return 1;
+        }
+        const uint8_t* vertices_p = data.data() + header->body_offset;
+        const uint8_t* faces_p = vertices_p + header->vertex_count * sizeof(Plymesh::RawVertex);
+        std::vector<Plymesh::Vertex> vertices(header->vertex_count);
+        std::vector<Plymesh::Index> indices(header->face_count * 3);
+
+        // header parsing is tiny and sequential, batch it for measurable times
+        constexpr uint32_t header_batch = 10'000;
+        measure("ply_header", 1, header->body_offset * header_batch, header_batch, [&]() {
+            for (uint32_t i = 0; i < header_batch; i++) std::ignore = Plymesh::parse_header(data.data());
+        });
+        for (uint32_t thread_count: _thread_counts) {
+            measure("ply_vertices", thread_count, header->vertex_count * sizeof(Plymesh::RawVertex), header->vertex_count, [&]() {
+                Plymesh::convert_vertices(vertices_p, std::nullopt, vertices, thread_count);
+            });
+            measure("ply_faces", thread_count, header->face_count * Plymesh::face_stride, header->face_count, [&]() {
+                Plymesh::convert_faces(faces_p, indices, thread_count);
+            });
+            measure("ply_parse", thread_count, data.size(), header->vertex_count + header->face_count, [&]() {
+                Plymesh::parse(data.data(), std::nullopt, vertices, indices, thread_count);
+            });
+        }
+    }
+
+    // grid: header, query point decoding, cell index expansion and the full parse
+    {
+        std::vector<std::byte> data;
+        generate_grid(data);
+        auto header = Grid::parse_header(data);
+        if (!header.has_value()) {
+            std::println("Generated grid is malformed");
+            return 1;
+        }
+        const std::byte* query_points_p = data.data() + Grid::header_size;
+        const std::byte* cells_p = query_points_p + header->query_point_count * Grid::query_point_stride;
+        std::vector<Grid::QueryPoint> query_points(header->query_point_count);
+        std::vector<Grid::Index> cell_indices(header->cell_count * Grid::indices_per_cell);
+
+        for (uint32_t thread_count: _thread_counts) {
+            measure("grid_query_points", thread_count, header->query_point_count * Grid::query_point_stride, header->query_point_count, [&]() {
+                Grid::decode_query_points(query_points_p, header->voxel_size, query_points, thread_count);
+            });
+            measure("grid_cells", thread_count, header->cell_count * Grid::cell_stride, header->cell_count, [&]() {
+                Grid::expand_cells(cells_p, cell_indices, thread_count);
+            });
+            measure("grid_parse", thread_count, data.size(), header->query_point_count + header->cell_count, [&]() {
+                Grid::parse(data, query_points, cell_indices, thread_count);
+            });
+        }
+    }
+
+    // BVH: parallel build over a sphere surface, then rays and closest point queries from around it
+    {
+        std::vector<Procedural::Vertex> vertices;
+        std::vector<Procedural::Index> indices;
+        Procedural::sphere(_bvh_triangle_count, vertices, indices);
+        std::size_t triangle_count = indices.size() / 3;
+        Bvh bvh;
+        for (uint32_t thread_count: _thread_counts) {
+            measure("bvh_build", thread_count, indices.size() * sizeof(Procedural::Index), triangle_count, [&]() {
+                bvh.build(std::span<const Procedural::Vertex>(vertices), indices, thread_count);
+            });
+        }
+
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+        std::vector<std::pair<glm::vec3, glm::vec3>> queries(_bvh_query_count);
+        for (auto& [origin, target]: queries) {
+            origin = glm::normalize(glm::vec3(coord(rng), coord(rng), coord(rng))) * 3.0f;
+            target = glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.5f;
+        }
+        uint32_t hits = 0;
+        measure("bvh_raycast", 1, 0, queries.size(), [&]() {
+            for (auto& [origin, target]: queries) hits += bvh.intersect(origin, glm::normalize(target - origin)).has_value();
+        });
+        measure("bvh_closest_point", 1, 0, queries.size(), [&]() {
+            for (auto& [origin, target]: queries) hits += bvh.closest_point(origin * 0.5f).has_value();
+        });
+        if (hits == 0) std::println("BVH queries missed every surface");
+    }
+    write_csv();
+    return 0;
+}
+void MicroBenchmark::generate_ply(std::vector<uint8_t>& data) {
+    // same layout as the datasets: binary little endian, float xyz + normals, uint8 count + int32 triangle faces
+    std::size_t face_count = _vertex_count * 2;
+    std::string header = std::format(
+        "ply\nformat binary_little_endian 1.0\nelement vertex {}\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property float nx\nproperty float ny\nproperty float nz\n"
+        "element face {}\nproperty list uchar int vertex_indices\nend_header\n",
+        _vertex_count, face_count);
+    data.resize(header.size() + _vertex_count * sizeof(Plymesh::RawVertex) + face_count * Plymesh::face_stride);
+    std::memcpy(data.data(), header.data(), header.size());
+
+    // fixed seed keeps inputs identical between runs
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_int_distribution<int32_t> index(0, (int32_t)std::max<std::size_t>(_vertex_count, 1) - 1);
+    uint8_t* it = data.data() + header.size();
+    for (std::size_t i = 0; i < _vertex_count; i++) {
+        Plymesh::RawVertex vertex { { coord(rng), coord(rng), coord(rng) }, glm::normalize(glm::vec3(coord(rng), coord(rng), 1.0f)) };
+        std::memcpy(it, &vertex, sizeof(vertex));
+        it += sizeof(vertex);
+    }
+    for (std::size_t i = 0; i < face_count; i++) {
+        *it++ = 3;
+        std::array<int32_t, 3> face { index(rng), index(rng), index(rng) };
+        std::memcpy(it, face.data(), sizeof(face));
+        it += sizeof(face);
+    }
+}
+void MicroBenchmark::generate_grid(std::vector<std::byte>& data) {
+    std::size_t query_point_count = _cell_count;
+    data.resize(Grid::header_size + query_point_count * Grid::query_point_stride + _cell_count * Grid::cell_stride);
+    std::byte* it = data.data();
+    auto write = [&it](const auto& value) {
+        std::memcpy(it, &value, sizeof(value));
+        it += sizeof(value);
+    };
+    write(0.01f);
+    write(query_point_count);
+    write(_cell_count);
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::uniform_int_distribution<Grid::Index> index(0, (Grid::Index)std::max<std::size_t>(query_point_count, 1) - 1);
+    for (std::size_t i = 0; i < query_point_count; i++) {
+        write(glm::vec3(coord(rng), coord(rng), coord(rng)));
+        write(coord(rng) * 0.01f);
+    }
+    for (std::size_t i = 0; i < _cell_count; i++) {
+        for (uint32_t corner = 0; corner < 8; corner++) write(index(rng));
+    }
+}
+void MicroBenchmark::measure(std::string_view kernel, uint32_t thread_count, std::size_t bytes, std::size_t records, const std::function<void()>& fn) {
+    std::vector<double> times_ms;
+    for (uint32_t i = 0; i < _repeats; i++) {
+        auto begin = Clock::now();
+        fn();
+        times_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+    }
+    std::sort(times_ms.begin(), times_ms.end());
+    Result& result = _results.emplace_back(std::string(kernel), thread_count, bytes, records, times_ms.front(), times_ms[times_ms.size() / 2]);
+    double seconds = result.best_ms / 1000.0;
+    std::println("{:<18} {:>3} threads: {:>9.3f} ms, {:>9.1f} MB/s, {:>12.0f} records/s",
+        kernel, thread_count, result.best_ms, (double)bytes / 1e6 / seconds, (double)records / seconds);
+}
+void MicroBenchmark::write_csv() {
+    std::ofstream file(_output_path);
+    if (!file.is_open()) {
+        std::println("Failed to write results to {}", _output_path);
+        return;
+    }
+    file << "kernel,threads,bytes,records,best_ms,median_ms,mb_per_s,records_per_s\n";
+    for (auto& result: _results) {
+        double seconds = result.best_ms / 1000.0;
+        file << std::format("{},{},{},{},{},{},{},{}\n", result.kernel, result.thread_count, result.bytes, result.records,
+            result.best_ms, result.median_ms, (double)result.bytes / 1e6 / seconds, (double)result.records / seconds);
+    }
+    std::println("Results written to {}", _output_path);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+export module bench.micro;
+import std;
+
+// CPU-only loader and BVH benchmarks on synthetic inputs, no Vulkan device involved
+// every kernel runs at each thread count, throughput is taken from the fastest repeat
+export struct MicroBenchmark {
+    struct Result {
+        std::string kernel;
+        uint32_t thread_count;
+        std::size_t bytes; // input bytes consumed per run
+        std::size_t records; // vertices, faces, query points, cells, triangles or queries per run
+        double best_ms;
+        double median_ms;
+    };
+
+    void parse_arguments(int argc, char** argv);
+    auto run() -> int;
+
+    std::size_t _vertex_count = 4'000'000; // ply faces are twice as many
+    std::size_t _cell_count = 2'000'000; // grid query points match the cell count
+    std::size_t _bvh_triangle_count = 2'000'000;
+    uint32_t _bvh_query_count = 100'000; // rays and closest point queries per run
+    std::vector<uint32_t> _thread_counts;
+    uint32_t _repeats = 5;
+    std::string _output_path = "microbench.csv";
+
+private:
+    void generate_ply(std::vector<uint8_t>& data);
+    void generate_grid(std::vector<std::byte>& data);
+    // time fn over all repeats and append the result
+    void measure(std::string_view kernel, uint32_t thread_count, std::size_t bytes, std::size_t records, const std::function<void()>& fn);
+    void write_csv();
+
+    std::vector<Result> _results;
+};
\ No newline at end of file
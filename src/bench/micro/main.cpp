@@ -0,0 +1,7 @@
+import bench.micro;
+
+int main(int argc, char** argv) {
+    MicroBenchmark benchmark;
+    benchmark.parse_arguments(argc, argv);
+    return benchmark.run();
+}
\ No newline at end of file
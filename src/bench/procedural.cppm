@@ -0,0 +1,75 @@
+module;
+#include <glm/glm.hpp>
+export module bench.procedural;
+import std;
+import scene.plymesh;
+
+// deterministic geometry of arbitrary size, centered at the origin within [-1, 1]
+export namespace Procedural {
+    using Vertex = Plymesh::Vertex;
+    using Index = Plymesh::Index;
+
+    // uv sphere with roughly the requested triangle count
+    void sphere(uint64_t triangle_count, std::vector<Vertex>& vertices, std::vector<Index>& indices) {
+        // stacks * slices * 2 triangles with twice as many slices as stacks
+        uint32_t stacks = std::max<uint32_t>(2, (uint32_t)std::round(std::sqrt((double)triangle_count / 4.0)));
+        uint32_t slices = stacks * 2;
+        vertices.clear();
+        indices.clear();
+        vertices.reserve((uint64_t)(stacks + 1) * (slices + 1));
+        indices.reserve((uint64_t)stacks * slices * 6);
+
+        for (uint32_t y = 0; y <= stacks; y++) {
+            float theta = std::numbers::pi_v<float> * (float)y / (float)stacks;
+            for (uint32_t x = 0; x <= slices; x++) {
+                float phi = 2.0f * std::numbers::pi_v<float> * (float)x / (float)slices;
+                glm::vec3 norm { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+                glm::vec3 color = norm * 0.5f + 0.5f;
+                vertices.push_back({ norm, norm, color });
+            }
+        }
+        for (uint32_t y = 0; y < stacks; y++) {
+            for (uint32_t x = 0; x < slices; x++) {
+                Index a = y * (slices + 1) + x;
+                Index b = a + slices + 1;
+                indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+    }
+
+    // regular grid of cells, each drawn as a shrunken cube of 12 triangles
+    void grid(uint64_t cell_count, std::vector<Vertex>& vertices, std::vector<Index>& indices) {
+        uint32_t n = std::max<uint32_t>(1, (uint32_t)std::round(std::cbrt((double)cell_count)));
+        float cell_size = 2.0f / (float)n;
+        float half_extent = cell_size * 0.4f;
+        vertices.clear();
+        indices.clear();
+        vertices.reserve((uint64_t)n * n * n * 8);
+        indices.reserve((uint64_t)n * n * n * 36);
+
+        constexpr std::array<Index, 36> cube_indices {
+            0, 2, 1, 1, 2, 3, // -z
+            4, 5, 6, 5, 7, 6, // +z
+            0, 1, 4, 1, 5, 4, // -y
+            2, 6, 3, 3, 6, 7, // +y
+            0, 4, 2, 2, 4, 6, // -x
+            1, 3, 5, 3, 7, 5, // +x
+        };
+        for (uint32_t z = 0; z < n; z++) {
+            for (uint32_t y = 0; y < n; y++) {
+                for (uint32_t x = 0; x < n; x++) {
+                    glm::vec3 cell { x, y, z };
+                    glm::vec3 center = (cell + 0.5f) * cell_size - 1.0f;
+                    glm::vec3 color = (cell + 0.5f) / (float)n;
+                    Index base = (Index)vertices.size();
+                    // corners ordered by their x, y and z bits, normals point away from the center
+                    for (uint32_t corner = 0; corner < 8; corner++) {
+                        glm::vec3 dir { corner & 1 ? 1 : -1, corner & 2 ? 1 : -1, corner & 4 ? 1 : -1 };
+                        vertices.push_back({ center + dir * half_extent, glm::normalize(dir), color });
+                    }
+                    for (Index index: cube_indices) indices.push_back(base + index);
+                }
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -43,13 +43,14 @@ export struct DeviceBuffer {
 		vmalloc.destroyBuffer(_data, _allocation);
 	}
 
-	void read(vma::Allocator vmalloc, void* data_p, vk::DeviceSize data_size) {
+	// partial transfers start at a byte offset into the buffer
+	void read(vma::Allocator vmalloc, void* data_p, vk::DeviceSize data_size, vk::DeviceSize offset = 0) {
 		if (requires_staging()) std::println("ReBAR required, staging buffer not yet implemented");
-		vmalloc.copyAllocationToMemory(_allocation, 0, data_p, data_size);
+		vmalloc.copyAllocationToMemory(_allocation, offset, data_p, data_size);
 	}
-	void write(vma::Allocator vmalloc, void* data_p, vk::DeviceSize data_size) {
+	void write(vma::Allocator vmalloc, void* data_p, vk::DeviceSize data_size, vk::DeviceSize offset = 0) {
 		if (requires_staging()) std::println("ReBAR required, staging buffer not yet implemented");
-		vmalloc.copyMemoryToAllocation(data_p, _allocation, 0, data_size);
+		vmalloc.copyMemoryToAllocation(data_p, _allocation, offset, data_size);
 	}
 	template<typename T> void read(vma::Allocator vmalloc, T& data) {
 		read(vmalloc, &data, sizeof(T));
@@ -9,6 +9,8 @@ void Image::init(const CreateInfo& info) {
     _last_access = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite;
     _last_stage = vk::PipelineStageFlagBits2::eTopOfPipe;
     // create image
+    std::array<uint32_t, 2> queue_families { info.device._universal_i, info.device._compute_i };
+    bool concurrent = info.concurrent && queue_families[0] != queue_families[1];
     vk::ImageCreateInfo info_image {
         .imageType = vk::ImageType::e2D,
         .format = _format,
@@ -17,7 +19,10 @@ void Image::init(const CreateInfo& info) {
         .arrayLayers = 1,
         .samples = vk::SampleCountFlagBits::e1,
         .tiling = vk::ImageTiling::eOptimal,
-        .usage = info.usage
+        .usage = info.usage,
+        .sharingMode = concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive,
+        .queueFamilyIndexCount = concurrent ? (uint32_t)queue_families.size() : 0,
+        .pQueueFamilyIndices = concurrent ? queue_families.data() : nullptr,
     };
     vma::AllocationCreateInfo info_alloc {
         .usage = vma::MemoryUsage::eAutoPreferDevice,
@@ -51,6 +56,7 @@ void Image::wrap(const WrapInfo& info) {
     _owning = false;
     _image = info.image;
     _view = info.image_view;
+    _format = info.format;
     _extent = info.extent;
     _aspects = info.aspects;
     _last_layout = vk::ImageLayout::eUndefined;
@@ -63,7 +69,7 @@ void Image::destroy(Device& device) {
         device._logical.destroyImageView(_view);
     }
 }
-void Image::load_texture(Device& device, std::span<const std::byte> tex_data) {
+auto Image::load_texture(Device& device, std::span<const std::byte> tex_data) -> GpuTask {
     // create image data buffer
     vk::BufferCreateInfo info_buffer {
         .size = tex_data.size(),
@@ -91,7 +97,7 @@ void Image::load_texture(Device& device, std::span<const std::byte> tex_data) {
     std::memcpy(mapped_data_p, tex_data.data(), tex_data.size());
     device._vmalloc.unmapMemory(staging_alloc);
 
-    vk::CommandBuffer cmd = device.oneshot_begin(QueueType::eUniversal);
+    vk::CommandBuffer cmd = device.command_begin(QueueType::eUniversal);
     // transition image for transfer
     TransitionInfo info_transition {
         .cmd = cmd,
@@ -122,19 +128,90 @@ void Image::load_texture(Device& device, std::span<const std::byte> tex_data) {
         .pRegions = &region,
     };
     cmd.copyBufferToImage2(info_copy);
-    device.oneshot_end(QueueType::eUniversal, cmd);
+    co_await device.submit(QueueType::eUniversal, cmd);
     
     // clean up staging buffer
     device._vmalloc.destroyBuffer(staging_buffer, staging_alloc);
 }
+auto Image::read_texture(Device& device) -> std::vector<std::byte> {
+    // create host readable buffer
+    vk::DeviceSize size = (vk::DeviceSize)_extent.width * _extent.height * _extent.depth * vk::blockSize(_format);
+    vk::BufferCreateInfo info_buffer {
+        .size = size,
+        .usage = vk::BufferUsageFlagBits::eTransferDst,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .queueFamilyIndexCount = 1,
+        .pQueueFamilyIndices = &device._universal_i,
+    };
+    vma::AllocationCreateInfo info_allocation {
+        .flags = vma::AllocationCreateFlagBits::eHostAccessRandom,
+        .usage = vma::MemoryUsage::eAuto,
+        .preferredFlags = vk::MemoryPropertyFlagBits::eHostCached,
+    };
+    auto [readback_buffer, readback_alloc] = device._vmalloc.createBuffer(info_buffer, info_allocation);
+
+    vk::CommandBuffer cmd = device.command_begin(QueueType::eUniversal);
+    transition_layout({
+        .cmd = cmd,
+        .new_layout = vk::ImageLayout::eTransferSrcOptimal,
+        .dst_stage = vk::PipelineStageFlagBits2::eCopy,
+        .dst_access = vk::AccessFlagBits2::eTransferRead,
+    });
+    vk::BufferImageCopy2 region {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource {
+            .aspectMask = _aspects,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        },
+        .imageOffset = vk::Offset3D(0, 0, 0),
+        .imageExtent = _extent,
+    };
+    cmd.copyImageToBuffer2({
+        .srcImage = _image,
+        .srcImageLayout = vk::ImageLayout::eTransferSrcOptimal,
+        .dstBuffer = readback_buffer,
+        .regionCount = 1,
+        .pRegions = &region,
+    });
+    // make the copy visible to the host
+    vk::MemoryBarrier2 barrier_host {
+        .srcStageMask = vk::PipelineStageFlagBits2::eCopy,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eHost,
+        .dstAccessMask = vk::AccessFlagBits2::eHostRead,
+    };
+    cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_host });
+    device.submit(QueueType::eUniversal, cmd).wait();
+
+    // download data
+    std::vector<std::byte> tex_data(size);
+    device._vmalloc.invalidateAllocation(readback_alloc, 0, vk::WholeSize);
+    void* mapped_data_p = device._vmalloc.mapMemory(readback_alloc);
+    std::memcpy(tex_data.data(), mapped_data_p, size);
+    device._vmalloc.unmapMemory(readback_alloc);
+    device._vmalloc.destroyBuffer(readback_buffer, readback_alloc);
+    return tex_data;
+}
 void Image::transition_layout(const TransitionInfo& info) {
+    vk::ImageMemoryBarrier2 image_barrier = barrier(info.new_layout, info.dst_stage, info.dst_access);
+    vk::DependencyInfo info_dep {
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &image_barrier,
+    };
+    info.cmd.pipelineBarrier2(info_dep);
+}
+auto Image::barrier(vk::ImageLayout new_layout, vk::PipelineStageFlags2 dst_stage, vk::AccessFlags2 dst_access) -> vk::ImageMemoryBarrier2 {
     vk::ImageMemoryBarrier2 image_barrier {
         .srcStageMask = _last_stage,
         .srcAccessMask = _last_access,
-        .dstStageMask = info.dst_stage,
-        .dstAccessMask = info.dst_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
         .oldLayout = _last_layout,
-        .newLayout = info.new_layout,
+        .newLayout = new_layout,
         .image = _image,
         .subresourceRange {
             .aspectMask = _aspects,
@@ -144,14 +221,10 @@ void Image::transition_layout(const TransitionInfo& info) {
             .layerCount = vk::RemainingArrayLayers,
         }
     };
-    vk::DependencyInfo info_dep {
-        .imageMemoryBarrierCount = 1,
-        .pImageMemoryBarriers = &image_barrier,
-    };
-    info.cmd.pipelineBarrier2(info_dep);
-    _last_layout = info.new_layout;
-    _last_access = info.dst_access;
-    _last_stage = info.dst_stage;
+    _last_layout = new_layout;
+    _last_access = dst_access;
+    _last_stage = dst_stage;
+    return image_barrier;
 }
 void Image::blit(vk::CommandBuffer cmd, Image& src_image) {
     vk::ImageBlit2 region {
@@ -279,4 +352,70 @@ void DepthStencil::init(Device& device, vk::Extent3D extent) {
         }
     };
     _view = device._logical.createImageView(info_depth_view);
+    // sampling a combined format requires a view of a single aspect
+    info_depth_view.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eDepth;
+    _depth_view = device._logical.createImageView(info_depth_view);
+}
+void DepthStencil::destroy(Device& device) {
+    device._logical.destroyImageView(_depth_view);
+    Image::destroy(device);
+}
+void DepthPyramid::init(Device& device, vk::Extent2D extent) {
+    _owning = true;
+    _extent = vk::Extent3D { std::bit_floor(extent.width), std::bit_floor(extent.height), 1 };
+    _format = vk::Format::eR32Sfloat;
+    _aspects = vk::ImageAspectFlagBits::eColor;
+    _levels = std::bit_width(std::max(_extent.width, _extent.height));
+    _last_layout = vk::ImageLayout::eUndefined;
+    _last_access = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite;
+    _last_stage = vk::PipelineStageFlagBits2::eTopOfPipe;
+    // create image
+    vk::ImageCreateInfo info_image {
+        .imageType = vk::ImageType::e2D,
+        .format = _format,
+        .extent = _extent,
+        .mipLevels = _levels,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled
+    };
+    vma::AllocationCreateInfo info_alloc {
+        .usage = vma::MemoryUsage::eAutoPreferDevice,
+        .requiredFlags = vk::MemoryPropertyFlagBits::eDeviceLocal,
+        .priority = 1.0f,
+    };
+    std::tie(_image, _allocation) = device._vmalloc.createImage(info_image, info_alloc);
+
+    // sampled view over all levels, and one view per level for storage writes
+    vk::ImageViewCreateInfo info_view {
+        .image = _image,
+        .viewType = vk::ImageViewType::e2D,
+        .format = _format,
+        .components {
+            .r = vk::ComponentSwizzle::eIdentity,
+            .g = vk::ComponentSwizzle::eIdentity,
+            .b = vk::ComponentSwizzle::eIdentity,
+            .a = vk::ComponentSwizzle::eIdentity,
+        },
+        .subresourceRange {
+            .aspectMask = _aspects,
+            .baseMipLevel = 0,
+            .levelCount = vk::RemainingMipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = vk::RemainingArrayLayers,
+        }
+    };
+    _view = device._logical.createImageView(info_view);
+    _mip_views.resize(_levels);
+    for (uint32_t level = 0; level < _levels; level++) {
+        info_view.subresourceRange.baseMipLevel = level;
+        info_view.subresourceRange.levelCount = 1;
+        _mip_views[level] = device._logical.createImageView(info_view);
+    }
+}
+void DepthPyramid::destroy(Device& device) {
+    for (auto view: _mip_views) device._logical.destroyImageView(view);
+    _mip_views.clear();
+    Image::destroy(device);
 }
\ No newline at end of file
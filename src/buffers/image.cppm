@@ -1,7 +1,9 @@
 export module buffers.image;
+import std;
 import vulkan_hpp;
 import vulkan.allocator;
 import core.device;
+import core.task;
 
 export struct Image {
     struct CreateInfo;
@@ -13,8 +15,14 @@ export struct Image {
     void wrap(const WrapInfo& info);
     // destroy device-side resources if owning
     void destroy(Device& device);
-    void load_texture(Device& device, std::span<const std::byte> tex_data);
+    // upload through a staging buffer, which is freed once the task resumes after the copy completed
+    // tex_data is only read before the first suspension
+    [[nodiscard]] auto load_texture(Device& device, std::span<const std::byte> tex_data) -> GpuTask;
+    // copy the image contents back to the host, waits for completion
+    auto read_texture(Device& device) -> std::vector<std::byte>;
     void transition_layout(const TransitionInfo& info);
+    // build barrier from the last tracked state without recording it, for batching
+    auto barrier(vk::ImageLayout new_layout, vk::PipelineStageFlags2 dst_stage, vk::AccessFlags2 dst_access) -> vk::ImageMemoryBarrier2;
     void blit(vk::CommandBuffer cmd, Image& src_image);
     
     vma::Allocation _allocation;
@@ -74,6 +82,17 @@ export struct DepthStencil: public Image {
         }
     }
     void init(Device& device, vk::Extent3D extent);
+    void destroy(Device& device);
+
+    vk::ImageView _depth_view; // depth aspect only, for sampling
+};
+// mip chain of the farthest depth within each texel's footprint, level 0 at the power of two below the depth extent
+export struct DepthPyramid: public Image {
+    void init(Device& device, vk::Extent2D extent);
+    void destroy(Device& device);
+
+    std::vector<vk::ImageView> _mip_views; // single level views for storage writes
+    uint32_t _levels;
 };
 
 struct Image::CreateInfo {
@@ -83,10 +102,13 @@ struct Image::CreateInfo {
     vk::ImageUsageFlags usage;
     vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor;
     float priority = 0.5f;
+    // readable from the universal and compute queue families without ownership transfers, meant for immutable data
+    bool concurrent = false;
 };
 struct Image::WrapInfo {
     vk::Image image;
     vk::ImageView image_view;
+    vk::Format format;
     vk::Extent3D extent;
     vk::ImageAspectFlags aspects;
 };
@@ -1,21 +1,30 @@
 export module buffers.mesh;
+import std;
 import vulkan_hpp;
 import vulkan.allocator;
 import buffers.device;
 
 export template<typename Index> struct Indices {
-    void init(vma::Allocator vmalloc, std::span<Index> index_data) {
+    // capacity reserves room for later partial writes, the buffer holds at least the initial data
+    void init(vma::Allocator vmalloc, std::span<Index> index_data, uint32_t capacity = 0) {
         // create index buffer and copy indices to it
+        _capacity = std::max((uint32_t)index_data.size(), capacity);
 		DeviceBuffer::CreateInfo info {
 			.vmalloc = vmalloc,
-			.size = sizeof(Index) * index_data.size(),
-			.usage = vk::BufferUsageFlagBits::eIndexBuffer,
+			.size = sizeof(Index) * _capacity,
+			// storage usage lets compute passes fetch triangles directly, transfers let it be copied when grown
+			.usage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
 			.dedicated_memory = true,
 		};
 		_buffer.init(info);
-		_buffer.write(vmalloc, index_data.data(), info.size);
+		if (!index_data.empty()) _buffer.write(vmalloc, index_data.data(), sizeof(Index) * index_data.size());
         _count = (uint32_t)index_data.size();
     }
+    // overwrite indices starting at the given one, which frames in flight may not be reading
+    void write(vma::Allocator vmalloc, std::span<const Index> index_data, uint32_t first) {
+		_buffer.write(vmalloc, (void*)index_data.data(), sizeof(Index) * index_data.size(), sizeof(Index) * first);
+    }
     void destroy(vma::Allocator vmalloc) {
 		_buffer.destroy(vmalloc);
     }
@@ -25,40 +34,47 @@ export template<typename Index> struct Indices {
 
 	DeviceBuffer _buffer;
 	uint32_t _count;
+	uint32_t _capacity = 0;
 };
 
 export template<typename Vertex> struct Vertices {
-    void init(vma::Allocator vmalloc, std::span<Vertex> vertex_data) {
+    void init(vma::Allocator vmalloc, std::span<Vertex> vertex_data, uint32_t capacity = 0) {
         // create vertex buffer and copy vertices to it
+        _capacity = std::max((uint32_t)vertex_data.size(), capacity);
 		DeviceBuffer::CreateInfo info {
 			.vmalloc = vmalloc,
-			.size = sizeof(Vertex) * vertex_data.size(),
-			.usage = vk::BufferUsageFlagBits::eVertexBuffer,
+			.size = sizeof(Vertex) * _capacity,
+			.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+				vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst,
 			.dedicated_memory = true,
 		};
 		_buffer.init(info);
-		_buffer.write(vmalloc, vertex_data.data(), info.size);
+		if (!vertex_data.empty()) _buffer.write(vmalloc, vertex_data.data(), sizeof(Vertex) * vertex_data.size());
 		_count = (uint32_t)vertex_data.size();
     }
+    void write(vma::Allocator vmalloc, std::span<const Vertex> vertex_data, uint32_t first) {
+		_buffer.write(vmalloc, (void*)vertex_data.data(), sizeof(Vertex) * vertex_data.size(), sizeof(Vertex) * first);
+    }
     void destroy(vma::Allocator vmalloc) {
 		_buffer.destroy(vmalloc);
     }
 
 	DeviceBuffer _buffer;
 	uint32_t _count;
+	uint32_t _capacity = 0;
 };
 
 export template<typename Vertex, typename Index = uint16_t> struct Mesh {
-    void init(vma::Allocator vmalloc, std::span<Vertex> vertices, std::span<Index> indices) {
-        _vertices.init(vmalloc, vertices);
-        _indices.init(vmalloc, indices);
+    void init(vma::Allocator vmalloc, std::span<Vertex> vertices, std::span<Index> indices, uint32_t vertex_capacity = 0, uint32_t index_capacity = 0) {
+        _vertices.init(vmalloc, vertices, vertex_capacity);
+        _indices.init(vmalloc, indices, index_capacity);
     }
     void init(vma::Allocator vmalloc, std::span<Vertex> vertices) {
         _vertices.init(vmalloc, vertices);
     }
     void destroy(vma::Allocator vmalloc) {
         _vertices.destroy(vmalloc);
-        if (_indices._count > 0) _indices.destroy(vmalloc);
+        if (_indices._capacity > 0) _indices.destroy(vmalloc);
     }
 
     Vertices<Vertex> _vertices;
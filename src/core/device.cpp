@@ -151,7 +151,19 @@ auto create_physical(const Device::CreateInfo& info) -> vk::PhysicalDevice {
     std::println("Picked device: {}", (const char*)phys_device.getProperties().deviceName);
     return phys_device;
 }
-auto create_logical(const Device::CreateInfo& info, vk::PhysicalDevice physical_device, std::vector<uint32_t>& queue_families) -> vk::Device {
+// feature structs are arrays of VkBool32 after their header, enable each optional one the device supports
+template<typename T>
+void enable_supported(T& enabled, const T& optional, const T& supported, const vk::Bool32& first) {
+    std::size_t offset = reinterpret_cast<const std::byte*>(&first) - reinterpret_cast<const std::byte*>(&enabled);
+    std::size_t count = (sizeof(T) - offset) / sizeof(vk::Bool32);
+    auto* enabled_p = reinterpret_cast<vk::Bool32*>(reinterpret_cast<std::byte*>(&enabled) + offset);
+    auto* optional_p = reinterpret_cast<const vk::Bool32*>(reinterpret_cast<const std::byte*>(&optional) + offset);
+    auto* supported_p = reinterpret_cast<const vk::Bool32*>(reinterpret_cast<const std::byte*>(&supported) + offset);
+    for (std::size_t i = 0; i < count; i++) {
+        if (optional_p[i] && supported_p[i]) enabled_p[i] = vk::True;
+    }
+}
+auto create_logical(const Device::CreateInfo& info, vk::PhysicalDevice physical_device, std::vector<uint32_t>& queue_families, Device& device) -> vk::Device {
     // set up features
     vk::PhysicalDeviceFeatures2 required_features {
         .features = info._required_features,
@@ -160,6 +172,16 @@ auto create_logical(const Device::CreateInfo& info, vk::PhysicalDevice physical_
     vk::PhysicalDeviceVulkan12Features features_vk12 = info._required_vk12_features;
     vk::PhysicalDeviceVulkan13Features features_vk13 = info._required_vk13_features;
 
+    // add optional core features the device supports
+    vk::PhysicalDeviceVulkan12Features supported_vk12;
+    vk::PhysicalDeviceFeatures2 supported { .pNext = info._required_minor >= 2 ? &supported_vk12 : nullptr };
+    physical_device.getFeatures2(&supported);
+    enable_supported(required_features.features, info._optional_core_features, supported.features, required_features.features.robustBufferAccess);
+    if (info._required_minor >= 2) enable_supported(features_vk12, info._optional_vk12_features, supported_vk12, features_vk12.samplerMirrorClampToEdge);
+    device._features = required_features.features;
+    device._vk12_features = features_vk12;
+    device._vk12_features.pNext = nullptr;
+
     // chain main features
     void** tail_pp = &required_features.pNext;
     if (info._required_minor >= 1) {
@@ -198,20 +220,22 @@ auto create_logical(const Device::CreateInfo& info, vk::PhysicalDevice physical_
     std::vector<const char*> extensions;
     extensions.insert(extensions.end(), info._required_extensions.cbegin(), info._required_extensions.cend());
     extensions.insert(extensions.end(), extension_set.cbegin(), extension_set.cend());
+    device._extensions = { extensions.cbegin(), extensions.cend() };
     
     // tally unique queues
     std::map<uint32_t, uint32_t> queue_counts;
     for (auto& queue_family: queue_families) {
         queue_counts[queue_family]++;
     }
-    // create queue family infos
+    // one queue per role sharing a family, as far as the family exposes them
+    auto queue_family_props = physical_device.getQueueFamilyProperties();
     std::vector<vk::DeviceQueueCreateInfo> info_queues;
-    float queue_priority = 1.0f;
+    std::vector<float> queue_priorities(queue_families.size(), 1.0f);
     for (auto& [queue_family, count]: queue_counts) {
         info_queues.push_back({
             .queueFamilyIndex = queue_family,
-            .queueCount = 1, // just hardcore to single queue of each type for now
-            .pQueuePriorities = &queue_priority,
+            .queueCount = std::min(count, queue_family_props[queue_family].queueCount),
+            .pQueuePriorities = queue_priorities.data(),
         });
     }
 
@@ -232,7 +256,7 @@ void Device::init(const Device::CreateInfo& info) {
 
     // create logical device from physical
     auto queue_families = get_queue_families(_physical);
-    _logical = create_logical(info, _physical, queue_families);
+    _logical = create_logical(info, _physical, queue_families, *this);
 
     // dynamic dispatcher init 3/3
     vk::detail::defaultDispatchLoaderDynamic.init(_logical);
@@ -243,32 +267,43 @@ void Device::init(const Device::CreateInfo& info) {
     _compute_i = queue_families[2];
     _transfer_i = queue_families[3];
 
-    // get queues
-    _universal_queue = _logical.getQueue(_universal_i, 0);
-    _graphics_queue = _logical.getQueue(_graphics_i, 0);
-    _compute_queue = _logical.getQueue(_compute_i, 0);
-    _transfer_queue = _logical.getQueue(_transfer_i, 0);
+    // get queues, roles sharing a family take its queues in order and only share once they ran out
+    auto queue_family_props = _physical.getQueueFamilyProperties();
+    std::map<uint32_t, uint32_t> queues_taken;
+    auto get_queue = [&](uint32_t queue_family) {
+        uint32_t queue_index = queues_taken[queue_family]++ % queue_family_props[queue_family].queueCount;
+        return _logical.getQueue(queue_family, queue_index);
+    };
+    _universal_queue = get_queue(_universal_i);
+    _graphics_queue = get_queue(_graphics_i);
+    _compute_queue = get_queue(_compute_i);
+    _transfer_queue = get_queue(_transfer_i);
 
     // create command pools
     _universal_pool = _logical.createCommandPool({
-        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = _universal_i,
     });
     _graphics_pool = _logical.createCommandPool({
-        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = _graphics_i,
     });
     _compute_pool = _logical.createCommandPool({
-        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = _compute_i,
     });
     _transfer_pool = _logical.createCommandPool({
-        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
         .queueFamilyIndex = _transfer_i,
     });
 
-    // create fences
-    _oneshot_fence = _logical.createFence({});
+    // create one timeline per queue for submissions outside the renderer
+    for (auto& timeline: _timelines) {
+        vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> chain_timeline {
+            {}, { .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0 }
+        };
+        timeline.semaphore = _logical.createSemaphore(chain_timeline.get());
+    }
 
     // create vulkan memory allocator
     vma::VulkanFunctions vk_funcs {
@@ -293,55 +328,116 @@ void Device::init(const Device::CreateInfo& info) {
 }
 void Device::destroy() {
     _vmalloc.destroy();
-    _logical.destroyFence(_oneshot_fence);
+    for (auto& timeline: _timelines) _logical.destroySemaphore(timeline.semaphore);
     _logical.destroyCommandPool(_universal_pool);
     _logical.destroyCommandPool(_graphics_pool);
     _logical.destroyCommandPool(_compute_pool);
     _logical.destroyCommandPool(_transfer_pool);
     _logical.destroy();
 }
-auto Device::oneshot_begin(QueueType queue) -> vk::CommandBuffer {
-    vk::CommandBufferAllocateInfo info {
-        .level = vk::CommandBufferLevel::ePrimary,
-        .commandBufferCount = 1,
-    };
-    switch (queue) {
-        case QueueType::eUniversal: info.commandPool = _universal_pool; break;
-        case QueueType::eGraphics: info.commandPool = _graphics_pool; break;
-        case QueueType::eCompute: info.commandPool = _compute_pool; break;
-        case QueueType::eTransfer: info.commandPool = _transfer_pool; break;
+auto Device::command_begin(QueueType queue) -> vk::CommandBuffer {
+    Timeline& timeline = _timelines[(std::size_t)queue];
+    vk::CommandBuffer cmd;
+    if (timeline.free.empty()) {
+        vk::CommandBufferAllocateInfo info {
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        };
+        switch (queue) {
+            case QueueType::eUniversal: info.commandPool = _universal_pool; break;
+            case QueueType::eGraphics: info.commandPool = _graphics_pool; break;
+            case QueueType::eCompute: info.commandPool = _compute_pool; break;
+            case QueueType::eTransfer: info.commandPool = _transfer_pool; break;
+        }
+        cmd = _logical.allocateCommandBuffers(info)[0];
+    }
+    else {
+        cmd = timeline.free.back();
+        timeline.free.pop_back();
     }
-    vk::CommandBuffer cmd = _logical.allocateCommandBuffers(info)[0];
+    // pools allow resetting individual command buffers, beginning implicitly resets recycled ones
     cmd.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
     return cmd;
 }
-void Device::oneshot_end(QueueType queue, vk::CommandBuffer cmd,
+auto Device::submit(QueueType queue, vk::CommandBuffer cmd,
         const vk::ArrayProxy<vk::Semaphore>& wait_semaphores,
-        const vk::ArrayProxy<vk::Semaphore>& sign_semaphores) {
+        const vk::ArrayProxy<vk::Semaphore>& sign_semaphores) -> Submission {
     cmd.end();
-    vk::SubmitInfo info_submit {
-        .waitSemaphoreCount = (uint32_t)wait_semaphores.size(),
-        .pWaitSemaphores = wait_semaphores.data(),
-        .commandBufferCount = 1,
-        .pCommandBuffers = &cmd,
-        .signalSemaphoreCount = (uint32_t)sign_semaphores.size(),
-        .pSignalSemaphores = sign_semaphores.data(),
+    Timeline& timeline = _timelines[(std::size_t)queue];
+    uint64_t value = ++timeline.submitted;
+    std::vector<vk::SemaphoreSubmitInfo> waits, signals;
+    for (auto semaphore: wait_semaphores) waits.push_back({ .semaphore = semaphore, .stageMask = vk::PipelineStageFlagBits2::eAllCommands });
+    for (auto semaphore: sign_semaphores) signals.push_back({ .semaphore = semaphore, .stageMask = vk::PipelineStageFlagBits2::eAllCommands });
+    signals.push_back({ .semaphore = timeline.semaphore, .value = value, .stageMask = vk::PipelineStageFlagBits2::eAllCommands });
+    vk::CommandBufferSubmitInfo info_cmd { .commandBuffer = cmd };
+    vk::SubmitInfo2 info_submit {
+        .waitSemaphoreInfoCount = (uint32_t)waits.size(),
+        .pWaitSemaphoreInfos = waits.data(),
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &info_cmd,
+        .signalSemaphoreInfoCount = (uint32_t)signals.size(),
+        .pSignalSemaphoreInfos = signals.data(),
     };
     switch (queue) {
-        case QueueType::eUniversal: _universal_queue.submit(info_submit, _oneshot_fence); break;
-        case QueueType::eGraphics: _graphics_queue.submit(info_submit, _oneshot_fence); break;
-        case QueueType::eCompute: _compute_queue.submit(info_submit, _oneshot_fence); break;
-        case QueueType::eTransfer: _transfer_queue.submit(info_submit, _oneshot_fence); break;
+        case QueueType::eUniversal: _universal_queue.submit2(info_submit); break;
+        case QueueType::eGraphics: _graphics_queue.submit2(info_submit); break;
+        case QueueType::eCompute: _compute_queue.submit2(info_submit); break;
+        case QueueType::eTransfer: _transfer_queue.submit2(info_submit); break;
     }
-    // wait for fence to be signaled, then reset it
-    while (vk::Result::eTimeout == _logical.waitForFences(_oneshot_fence, vk::True, UINT64_MAX));
-    _logical.resetFences(_oneshot_fence);
-
-    // free the command buffer
-    switch (queue) {
-        case QueueType::eUniversal: _logical.freeCommandBuffers(_universal_pool, cmd); break;
-        case QueueType::eGraphics: _logical.freeCommandBuffers(_graphics_pool, cmd); break;
-        case QueueType::eCompute: _logical.freeCommandBuffers(_compute_pool, cmd); break;
-        case QueueType::eTransfer: _logical.freeCommandBuffers(_transfer_pool, cmd); break;
+    timeline.pending.emplace_back(value, cmd);
+    return { this, queue, value };
+}
+auto Device::reached(QueueType queue, uint64_t value) -> bool {
+    return _logical.getSemaphoreCounterValue(_timelines[(std::size_t)queue].semaphore) >= value;
+}
+void Device::wait(QueueType queue, uint64_t value) {
+    vk::Semaphore semaphore = _timelines[(std::size_t)queue].semaphore;
+    vk::SemaphoreWaitInfo info_wait {
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &value,
+    };
+    while (vk::Result::eTimeout == _logical.waitSemaphores({ info_wait }, UINT64_MAX)) {};
+    poll();
+}
+void Device::resume_after(QueueType queue, uint64_t value, std::coroutine_handle<> handle) {
+    _timelines[(std::size_t)queue].waiters.emplace_back(value, handle);
+}
+void Device::forget(QueueType queue, std::coroutine_handle<> handle) {
+    std::erase_if(_timelines[(std::size_t)queue].waiters, [&](auto& waiter) { return waiter.second == handle; });
+}
+void Device::poll() {
+    // collect first, resumed coroutines may submit and await again
+    std::vector<std::coroutine_handle<>> ready;
+    for (auto& timeline: _timelines) {
+        if (timeline.pending.empty() && timeline.waiters.empty()) continue;
+        uint64_t value = _logical.getSemaphoreCounterValue(timeline.semaphore);
+        std::erase_if(timeline.pending, [&](auto& pending) {
+            if (pending.first > value) return false;
+            timeline.free.push_back(pending.second);
+            return true;
+        });
+        std::erase_if(timeline.waiters, [&](auto& waiter) {
+            if (waiter.first > value) return false;
+            ready.push_back(waiter.second);
+            return true;
+        });
+    }
+    for (auto handle: ready) handle.resume();
+}
+void Device::run(GpuTask& task) {
+    while (!task.done()) {
+        // block on the earliest value any coroutine waits for
+        std::optional<std::pair<QueueType, uint64_t>> next;
+        for (std::size_t i = 0; i < _timelines.size(); i++) {
+            for (auto& waiter: _timelines[i].waiters) {
+                if (!next.has_value() || waiter.first < next->second) next = { (QueueType)i, waiter.first };
+            }
+        }
+        if (!next.has_value()) {
+            std::println("GPU task is not waiting on any submission");
+            return;
+        }
+        wait(next->first, next->second);
     }
 }
\ No newline at end of file
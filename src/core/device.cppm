@@ -2,19 +2,48 @@ export module core.device;
 import std;
 import vulkan_hpp;
 import vulkan.allocator;
+import core.task;
 
 export enum class QueueType { eUniversal, eGraphics, eCompute, eTransfer };
 export struct Device {
     struct CreateInfo;
     void init(const CreateInfo& info);
     void destroy();
-    // TODO: return oneshot structure with automatic cleanup (waiting on fence(s))
-    // start new command buffer on specified queue
-    auto oneshot_begin(QueueType queue) -> vk::CommandBuffer;
-    // end the command buffer and synchronize via semaphores
-    void oneshot_end(QueueType queue, vk::CommandBuffer cmd,
+    // timeline value of a submission, co_await it within a GpuTask or block on it with wait()
+    struct Submission {
+        auto await_ready() -> bool { return device_p->reached(queue, value); }
+        template<typename Promise>
+        void await_suspend(std::coroutine_handle<Promise> handle) {
+            device_p->resume_after(queue, value, handle);
+            if constexpr (std::is_same_v<Promise, GpuTask::promise_type>) {
+                handle.promise()._unregister = [device_p = device_p, queue = queue, handle]() { device_p->forget(queue, handle); };
+            }
+        }
+        void await_resume() {}
+        void wait() { device_p->wait(queue, value); }
+        Device* device_p;
+        QueueType queue;
+        uint64_t value;
+    };
+    // begin a command buffer of the queue's recycled pool
+    auto command_begin(QueueType queue) -> vk::CommandBuffer;
+    // end and submit the command buffer, which is recycled once the GPU finished it. binary semaphores may be waited on and signaled
+    auto submit(QueueType queue, vk::CommandBuffer cmd,
             const vk::ArrayProxy<vk::Semaphore>& wait_semaphores = {},
-            const vk::ArrayProxy<vk::Semaphore>& sign_semaphores = {});
+            const vk::ArrayProxy<vk::Semaphore>& sign_semaphores = {}) -> Submission;
+    auto reached(QueueType queue, uint64_t value) -> bool;
+    // block until the value was reached, resuming coroutines whose submissions completed meanwhile
+    void wait(QueueType queue, uint64_t value);
+    // resume the coroutine from poll() once the value was reached
+    void resume_after(QueueType queue, uint64_t value, std::coroutine_handle<> handle);
+    // stop resuming a coroutine that is about to be destroyed
+    void forget(QueueType queue, std::coroutine_handle<> handle);
+    // recycle finished command buffers and resume waiting coroutines, all on the calling thread
+    void poll();
+    // block until the task finished, polling submissions in the meantime
+    void run(GpuTask& task);
+    // whether a required or optional extension was enabled
+    auto has_extension(std::string_view name) -> bool { return _extensions.contains(std::string(name)); }
 
     vk::Device _logical;
     vk::PhysicalDevice _physical;
@@ -22,9 +51,22 @@ export struct Device {
     
     // TODO: std::map with QueueType
     uint32_t _universal_i, _graphics_i, _compute_i, _transfer_i;
+    // distinct queues where the families expose enough of them, roles only share a queue otherwise
     vk::Queue _universal_queue, _graphics_queue, _compute_queue, _transfer_queue;
     vk::CommandPool _universal_pool, _graphics_pool, _compute_pool, _transfer_pool;
-    vk::Fence _oneshot_fence;
+    // per queue timeline, signaled by each submit() with the next value
+    struct Timeline {
+        vk::Semaphore semaphore;
+        uint64_t submitted = 0;
+        std::vector<vk::CommandBuffer> free;
+        std::vector<std::pair<uint64_t, vk::CommandBuffer>> pending;
+        std::vector<std::pair<uint64_t, std::coroutine_handle<>>> waiters;
+    };
+    std::array<Timeline, 4> _timelines; // indexed by QueueType
+    std::set<std::string> _extensions;
+    // enabled core features, required ones plus the supported optional ones
+    vk::PhysicalDeviceFeatures _features;
+    vk::PhysicalDeviceVulkan12Features _vk12_features;
 };
 
 struct Device::CreateInfo {
@@ -37,6 +79,9 @@ struct Device::CreateInfo {
     vk::PhysicalDeviceVulkan11Features _required_vk11_features = {};
     vk::PhysicalDeviceVulkan12Features _required_vk12_features = {};
     vk::PhysicalDeviceVulkan13Features _required_vk13_features = {};
+    // core features enabled only where supported, check Device::_features and _vk12_features
+    vk::PhysicalDeviceFeatures _optional_core_features = {};
+    vk::PhysicalDeviceVulkan12Features _optional_vk12_features = {};
     std::vector<const char*> _required_extensions = {};
     std::vector<const char*> _optional_extensions = {};
     std::vector<std::pair<void*, const char*>> _optional_features = {};
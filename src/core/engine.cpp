@@ -1,30 +1,65 @@
+module;
+#include <glm/glm.hpp>
 module core.engine;
 import core.input;
+import core.trace;
 import buffers.image;
 import buffers.device;
+import scene.camera;
+import scene.instances;
 
-Engine::Engine() {
-    // create and open window
+Engine::Engine(int argc, char** argv) {
+    parse_arguments(argc, argv);
+
+    // create and open window, headless only creates the vulkan instance
     _window.init({
         .name { "CHAD Visualizer" },
-        .size { 1280, 720 },
+        .size = _size,
         .window_mode = Window::eWindowed,
         .fullscreen_mode = Window::eBorderless,
+        .headless = _headless,
     });
+    // presentation is only needed with a surface, software implementations may lack it
+    std::vector<const char*> required_extensions;
+    std::vector<const char*> optional_extensions { vk::EXTMemoryBudgetExtensionName };
+    if (_headless) optional_extensions.push_back(vk::KHRSwapchainExtensionName);
+    else required_extensions.push_back(vk::KHRSwapchainExtensionName);
     
     // select physical and create logical device
     vk::PhysicalDeviceMaintenance5FeaturesKHR maintenance5 { .maintenance5 = vk::True };
     vk::PhysicalDeviceMemoryPriorityFeaturesEXT memory_priority { .memoryPriority = vk::True };
     vk::PhysicalDevicePageableDeviceLocalMemoryFeaturesEXT pageable_memory { .pageableDeviceLocalMemory = vk::True };
+    vk::PhysicalDevicePresentIdFeaturesKHR present_id { .presentId = vk::True };
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait { .presentWait = vk::True };
+    std::vector<std::pair<void*, const char*>> optional_features {
+        {&maintenance5, vk::KHRMaintenance5ExtensionName},
+        {&memory_priority, vk::EXTMemoryPriorityExtensionName},
+        {&pageable_memory, vk::EXTPageableDeviceLocalMemoryExtensionName},
+    };
+    // present ids let the pacer observe when frames were actually shown
+    if (!_headless) {
+        optional_features.push_back({&present_id, vk::KHRPresentIdExtensionName});
+        optional_features.push_back({&present_wait, vk::KHRPresentWaitExtensionName});
+    }
     _device.init({
         ._instance = _window._instance,
         ._surface = _window._surface,
         ._required_major = 1,
         ._required_minor = 3,
         ._preferred_device_type = vk::PhysicalDeviceType::eIntegratedGpu,
-        ._required_features {},
+        ._required_features {
+            .multiDrawIndirect = true,
+            .drawIndirectFirstInstance = true,
+        },
         ._required_vk11_features {},
         ._required_vk12_features {
+            .drawIndirectCount = true,
+            .descriptorBindingSampledImageUpdateAfterBind = true,
+            .descriptorBindingStorageImageUpdateAfterBind = true,
+            .descriptorBindingStorageBufferUpdateAfterBind = true,
+            .descriptorBindingUpdateUnusedWhilePending = true,
+            .descriptorBindingPartiallyBound = true,
+            .runtimeDescriptorArray = true,
             .timelineSemaphore = true,
             .bufferDeviceAddress = true,
         },
@@ -33,17 +68,14 @@ Engine::Engine() {
             .dynamicRendering = true,
             .maintenance4 = true,
         },
-        ._required_extensions {
-            vk::KHRSwapchainExtensionName,
-        },
-        ._optional_extensions {
-            vk::EXTMemoryBudgetExtensionName,
-        },
-        ._optional_features {
-            {&maintenance5, vk::KHRMaintenance5ExtensionName},
-            {&memory_priority, vk::EXTMemoryPriorityExtensionName},
-            {&pageable_memory, vk::EXTPageableDeviceLocalMemoryExtensionName},
-        }
+        // point clouds are rasterized with 64-bit atomics, the visibility buffer needs primitive ids in fragment shaders
+        // the profiler falls back to timestamps without pipeline statistics
+        // profiling passes recorded into secondary command buffers keeps queries active across them
+        ._optional_core_features { .geometryShader = true, .pipelineStatisticsQuery = true, .shaderInt64 = true, .inheritedQueries = true },
+        ._optional_vk12_features { .shaderBufferInt64Atomics = true },
+        ._required_extensions = required_extensions,
+        ._optional_extensions = optional_extensions,
+        ._optional_features = optional_features,
     });
     
     // set global properties relying on current device capabilities
@@ -51,16 +83,37 @@ Engine::Engine() {
     DepthStencil::set_format(_device._physical);
     DeviceBuffer::set_staging_requirement(_device._vmalloc);
 
-    _swapchain.init(_device, _window);
+    if (_headless) _swapchain.init_headless(_device, _size, _frames_in_flight + 1);
+    else _swapchain.init(_device, _window);
     _swapchain.set_target_framerate(_fps_foreground);
-    _scene.init(_device._vmalloc);
+    // streamed mesh updates wake the render thread like input does
+    _scene._stream._on_record = [this]() {
+        _wake.fetch_add(1, std::memory_order_release);
+        _wake.notify_one();
+    };
+    _scene.init(_device._vmalloc, _frames_in_flight);
     _scene._camera.resize(_window._size);
-    _renderer.init(_device, _scene, _window._size, _swapchain._manual_srgb_required);
+    _renderer.init(_device, _scene, _swapchain, _frames_in_flight);
+    if (_visibility_buffer) _renderer.set_visibility_buffer(_device, _swapchain, true);
+    if (_async_compute) _renderer.set_async_compute(_device, _swapchain, true);
+
+    // window events keep being handled on this thread while another one renders
+    _window_size = _window._size;
+    if (!_headless) _render_thread = std::jthread([this](std::stop_token stop) { render_loop(stop); });
 }
 Engine::~Engine() {
-    // wait for current frame to finish
-    _renderer.wait(_device);
+    // wake the render thread in case it idles, it stops before its next frame
+    if (_render_thread.joinable()) {
+        _render_thread.request_stop();
+        _wake.fetch_add(1, std::memory_order_release);
+        _wake.notify_one();
+        _render_thread.join();
+    }
+    // wait for all frames in flight to finish
     _device._logical.waitIdle();
+    // trace buffers are only read once the threads recording into them are done
+    if constexpr (Trace::enabled) Trace::write_json("trace.json");
+    if (_headless && !_output_path.empty()) _swapchain.save_ppm(_device, _output_path);
 
     // shut down components
     _scene.destroy(_device._vmalloc);
@@ -70,28 +123,121 @@ Engine::~Engine() {
     _window.destroy();
 }
 
+void Engine::parse_arguments(int argc, char** argv) {
+    // --headless, --frames <n>, --size <width>x<height>, --output <file.ppm>, --points <dataset.ply>, --stream <file or pipe>, --visibility-buffer, --async-compute
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--headless") _headless = true;
+        else if (arg == "--frames" && has_value) _frame_limit = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--output" && has_value) _output_path = argv[++i];
+        else if (arg == "--points" && has_value) _scene._points_path = argv[++i];
+        else if (arg == "--stream" && has_value) _scene._stream_path = argv[++i];
+        else if (arg == "--visibility-buffer") _visibility_buffer = true;
+        else if (arg == "--async-compute") _async_compute = true;
+        else if (arg == "--size" && has_value) {
+            std::string_view size = argv[++i];
+            std::size_t x = size.find('x');
+            if (x == std::string_view::npos) std::println("Invalid size {}, expected <width>x<height>", size);
+            else {
+                std::from_chars(size.data(), size.data() + x, _size.width);
+                std::from_chars(size.data() + x + 1, size.data() + size.size(), _size.height);
+            }
+        }
+        else std::println("Unknown argument: {}", arg);
+    }
+    // headless runs need an end
+    if (_headless && _frame_limit == 0) _frame_limit = 1;
+}
 void Engine::handle_event(void* event_p) {
     bool resize_requested = _window.handle_event(event_p);
-    if (resize_requested) _swapchain._resize_requested = true;
+    if (resize_requested) _pending_update.resized = true;
+    _update_pending = true;
 }
-void Engine::handle_iteration() {
-    handle_shortcuts();
+auto Engine::handle_iteration() -> bool {
+    if (_headless) return render_iteration();
+    if (_render_done.load(std::memory_order_acquire)) return false;
+    handle_window_shortcuts();
+
+    // hand over everything gathered since the last iteration, held keys persist on the render thread without new events
+    if (_update_pending) {
+        // a full queue keeps the events accumulating here until the render thread caught up
+        Input::merge(_pending_update.input, Input::Data(Input::Data::get()));
+        _pending_update.size = _window._size;
+        _pending_update.focused = _window._focused;
+        if (_updates.push(std::move(_pending_update))) {
+            _pending_update = {};
+            _update_pending = false;
+            _wake.fetch_add(1, std::memory_order_release);
+            _wake.notify_one();
+        }
+    }
+    // the shortcuts above and the pending update saw this iteration's events once
+    Input::flush();
+    // sleep until the next event, frames are rendered independently of this thread
+    _window.wait_event(100);
+    return true;
+}
+void Engine::render_loop(std::stop_token stop) {
+    while (!stop.stop_requested()) {
+        receive_updates();
+        if (!render_iteration()) break;
+    }
+    _render_done.store(true, std::memory_order_release);
+}
+void Engine::receive_updates() {
+    // read the counter first, so hand-overs after the last pop still wake an idle wait
+    _wake_seen = _wake.load(std::memory_order_acquire);
+    Update update;
+    while (_updates.pop(update)) {
+        Input::merge(std::move(update.input));
+        if (update.resized) {
+            _window_size = update.size;
+            _swapchain._resize_requested = true;
+        }
+        _window_focused = update.focused;
+    }
+}
+auto Engine::render_iteration() -> bool {
+    Trace::Zone zone("Engine::render_iteration");
+    if (_frame_limit > 0 && _frame_count >= _frame_limit) return false;
+    if (!_headless) {
+        handle_shortcuts();
+        handle_picking();
+    }
 
     // handle window focus
-    if (_window._focused) _swapchain.set_target_framerate(_fps_foreground);
+    if (_window_focused) _swapchain.set_target_framerate(_fps_foreground);
     else _swapchain.set_target_framerate(_fps_background);
     if (_swapchain._resize_requested) {
         handle_resize();
-        return;
+        return true;
+    }
+
+    // the last presented image stays valid until input, the scene or the settings change
+    if (Input::active() || _scene._dirty || _scene._stream.pending()) _redraw = true;
+    if (_renderer._profiler._enabled || _renderer.dynamic_resolution()) _redraw = true;
+    if (_render_on_demand && !_headless && !_redraw) {
+        Input::flush();
+        // sleep until the event thread hands over new input
+        _wake.wait(_wake_seen, std::memory_order_acquire);
+        return true;
     }
+    _redraw = false;
     
-    _scene.update_safe();
+    _swapchain.pace(_device);
+    _scene.update_safe(_device);
     _renderer.wait(_device);
-    _scene.update_unsafe(_device._vmalloc);
+    _scene.update_unsafe(_device._vmalloc, _renderer.frame_index());
     _renderer.render(_device, _swapchain, _scene);
+    // keep going while the camera settles, e.g. after movement keys were released
+    if (_scene._camera._moved) _redraw = true;
+    _scene._dirty = false;
     Input::flush();
+    _frame_count++;
+    return true;
 }
-void Engine::handle_shortcuts() {
+void Engine::handle_window_shortcuts() {
     // handle fullscreen controls
     if (Keys::pressed(Keys::eF11)) {
         switch (_window._mode) {
@@ -101,7 +247,8 @@ void Engine::handle_shortcuts() {
         }
     }
 
-    // handle mouse grab
+    // handle mouse grab, the render thread sees the new state with the next hand-over
+    bool relative = Mouse::relative();
     if (Keys::pressed(Keys::eLeftAlt)) {
         _window.set_mouse_relative(true);
     }
@@ -110,13 +257,126 @@ void Engine::handle_shortcuts() {
         else if (!Mouse::relative() && !Keys::held(Keys::eLeftAlt) && Mouse::pressed(Mouse::eLeft)) _window.set_mouse_relative(false);
         else if (!Mouse::relative() && Keys::released(Keys::eLeftAlt)) _window.set_mouse_relative(false);
     }
+    if (relative != Mouse::relative()) _update_pending = true;
+}
+void Engine::handle_shortcuts() {
+    // cycle anti-aliasing modes and toggle compute SMAA
+    if (Keys::pressed(Keys::eF2) || Keys::pressed(Keys::eF3)) {
+        AntiAliasing antialiasing = _renderer.antialiasing();
+        bool smaa_compute = _renderer.smaa_compute();
+        if (Keys::pressed(Keys::eF2)) antialiasing = (AntiAliasing)(((uint32_t)antialiasing + 1) % ((uint32_t)AntiAliasing::eSMAAUltra + 1));
+        if (Keys::pressed(Keys::eF3)) smaa_compute = !smaa_compute;
+        _device._logical.waitIdle();
+        _renderer.set_antialiasing(_device, _swapchain, antialiasing, smaa_compute);
+    }
+
+    // toggle dynamic resolution
+    if (Keys::pressed(Keys::eF4)) {
+        _device._logical.waitIdle();
+        _renderer.set_dynamic_resolution(_device, _swapchain, !_renderer.dynamic_resolution());
+    }
+
+    // toggle GPU profiling, dumping the collected stats when stopped
+    if (Keys::pressed(Keys::eF5)) {
+        _renderer._profiler._enabled = !_renderer._profiler._enabled;
+        if (!_renderer._profiler._enabled) {
+            _renderer._profiler.print_summary();
+            _renderer._profiler.write_csv("profile.csv");
+        }
+    }
+
+    // cycle present mode preference, applied by recreating the swapchain
+    if (Keys::pressed(Keys::eF7)) {
+        _swapchain.set_present_mode((PresentMode)(((uint32_t)_swapchain._present_mode + 1) % ((uint32_t)PresentMode::eImmediate + 1)));
+    }
+
+    // print frame pacing stability
+    if (Keys::pressed(Keys::eF8)) _swapchain._pacer.print_summary();
+
+    // toggle render on demand
+    if (Keys::pressed(Keys::eF9)) {
+        _render_on_demand = !_render_on_demand;
+        std::println("Render on demand: {}", _render_on_demand ? "on" : "off");
+    }
+
+    // toggle occlusion culling, frustum culling stays active
+    if (Keys::pressed(Keys::eF10)) {
+        _device._logical.waitIdle();
+        _renderer.set_occlusion_culling(_device, _swapchain, !_renderer.occlusion_culling());
+        std::println("Occlusion culling: {}", _renderer.occlusion_culling() ? "on" : "off");
+        _redraw = true;
+    }
+
+    // toggle between shading every fragment and shading once per pixel from the visibility buffer
+    if (Keys::pressed('V')) {
+        _device._logical.waitIdle();
+        _renderer.set_visibility_buffer(_device, _swapchain, !_renderer.visibility_buffer());
+        std::println("Visibility buffer: {}", _renderer.visibility_buffer() ? "on" : "off");
+        _redraw = true;
+    }
+
+    // toggle running compute post-processing on the async compute queue
+    if (Keys::pressed('C')) {
+        _device._logical.waitIdle();
+        _renderer.set_async_compute(_device, _swapchain, !_renderer.async_compute());
+        std::println("Async compute: {}", _renderer.async_compute() ? "on" : "off");
+        _redraw = true;
+    }
+
+    // toggle recording graph passes on the job system's workers
+    if (Keys::pressed('R')) {
+        _renderer.set_parallel_recording(!_renderer.parallel_recording());
+        std::println("Parallel recording: {}", _renderer.parallel_recording() ? "on" : "off");
+    }
+
+    // toggle filling gaps between rasterized points
+    if (Keys::pressed(Keys::eF12)) {
+        _device._logical.waitIdle();
+        _renderer.set_point_hole_filling(_device, _swapchain, !_renderer.point_hole_filling());
+        std::println("Point hole filling: {}", _renderer.point_hole_filling() ? "on" : "off");
+        _redraw = true;
+    }
+}
+void Engine::handle_picking() {
+    // right click picks the surface under the cursor, or under the view center while the mouse is captured
+    // middle click finds the surface nearest to the camera
+    bool pick = Mouse::pressed(Mouse::eRight);
+    bool nearest = Mouse::pressed(Mouse::eMiddle);
+    if (!pick && !nearest) return;
+    Camera& camera = _scene._camera;
+    auto begin = std::chrono::steady_clock::now();
+    std::optional<MeshInstances::SurfaceHit> hit;
+    if (pick) {
+        glm::vec2 position = Mouse::relative() ?
+            glm::vec2(camera._extent.width, camera._extent.height) * 0.5f :
+            glm::vec2(Mouse::position().x, Mouse::position().y);
+        glm::vec3 near = camera.unproject(position, 0.0f);
+        glm::vec3 far = camera.unproject(position, 1.0f);
+        hit = _scene._instances.raycast(near, glm::normalize(far - near), glm::distance(near, far));
+    }
+    else hit = _scene._instances.closest_point(glm::vec3(camera._pos));
+    double query_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    if (!hit.has_value()) {
+        std::println("No surface found ({:.1f} us)", query_us);
+        return;
+    }
+
+    glm::vec3 position = hit->position;
+    float distance = glm::distance(position, glm::vec3(camera._pos));
+    std::println("{} instance {} face {} at ({:.3f}, {:.3f}, {:.3f}), {:.3f} from the camera ({:.1f} us)",
+        pick ? "Picked" : "Nearest surface:", hit->instance_i, hit->face, position.x, position.y, position.z, distance, query_us);
+    // consecutive picks measure the distance between them
+    if (pick) {
+        if (_pick.has_value()) std::println("Distance to previous pick: {:.3f}", glm::distance(*_pick, position));
+        _pick = position;
+    }
 }
 void Engine::handle_resize() {
-    // wait for current frame to finish
-    _renderer.wait(_device);
+    // wait for all frames in flight to finish
     _device._logical.waitIdle();
 
-    _scene._camera.resize(_window._size);
-    _swapchain.resize(_device, _window);
-    _renderer.resize(_device, _scene, _window._size, _swapchain._manual_srgb_required);
+    _scene._camera.resize(_window_size);
+    _swapchain.resize(_device, _window._surface, _window_size);
+    _renderer.resize(_device, _swapchain);
+    _redraw = true;
 }
\ No newline at end of file
@@ -1,18 +1,36 @@
+module;
+#include <glm/glm.hpp>
 export module core.engine;
+import std;
 import vulkan_hpp;
 import core.window;
 import core.device;
+import core.input;
+import core.queue;
 import renderer.swapchain;
 import renderer.renderer;
 import scene.scene;
 
 export struct Engine {
-    Engine();
+    Engine(int argc, char** argv);
     ~Engine();
     
+    void parse_arguments(int argc, char** argv);
+    // event thread, records input and window changes for the next hand-over
     void handle_event(void* event_p);
-    void handle_iteration();
+    // event thread, hands input to the render thread or renders inline when headless. returns false once the application should quit
+    auto handle_iteration() -> bool;
+    // render thread, runs until stopped or the frame limit was reached
+    void render_loop(std::stop_token stop);
+    // one frame, returns false once the application should quit
+    auto render_iteration() -> bool;
+    // render thread, fold all pending hand-overs into this thread's state
+    void receive_updates();
+    // event thread, shortcuts that call into SDL's windowing
+    void handle_window_shortcuts();
     void handle_shortcuts();
+    // report surfaces under the cursor and distances between them
+    void handle_picking();
     void handle_resize();
 
     Window _window;
@@ -21,6 +39,37 @@ export struct Engine {
     Renderer _renderer;
     Scene _scene;
     //
+    uint32_t _frames_in_flight = 2;
     uint32_t _fps_foreground = 0;
     uint32_t _fps_background = 5;
+    // headless mode renders a fixed number of frames offscreen, optionally saving the last one
+    bool _headless = false;
+    uint32_t _frame_limit = 0; // unlimited if zero
+    uint32_t _frame_count = 0;
+    vk::Extent2D _size = { 1280, 720 };
+    std::string _output_path;
+    bool _visibility_buffer = false; // initial scene rendering path
+    bool _async_compute = false; // initial post-processing queue
+    // render on demand skips frames while nothing that affects the image changed
+    bool _render_on_demand = true;
+    bool _redraw = true;
+    std::optional<glm::vec3> _pick; // previously picked surface point, for measurements
+    // input and window state handed from the event thread to the render thread
+    struct Update {
+        Input::Data input;
+        vk::Extent2D size;
+        bool resized;
+        bool focused;
+    };
+    SpscQueue<Update, 64> _updates;
+    std::atomic<uint32_t> _wake = 0; // bumped with every hand-over, an idle render thread waits on it
+    std::atomic<bool> _render_done = false;
+    std::jthread _render_thread; // not started when headless, frames are rendered inline instead
+    // event thread
+    bool _update_pending = true; // events arrived since the last hand-over
+    Update _pending_update {}; // gathered while the queue is full
+    // render thread copies of the window state
+    vk::Extent2D _window_size;
+    bool _window_focused = true;
+    uint32_t _wake_seen = 0;
 };
\ No newline at end of file
@@ -6,9 +6,10 @@ import std;
 export namespace Input {
 	struct MouseVec2 { double x, y; };
 	// data storage for internal use only
+	// every thread sees its own state, the event thread hands snapshots to the render thread via merge()
 	struct Data {
 		auto static get() noexcept -> Data& { 
-            static Data instance;
+            thread_local Data instance;
             return instance;
         }
 		std::set<int> keys_pressed, keys_held, keys_released;
@@ -22,7 +23,17 @@ export namespace Input {
 		enum: int {
 			eSpacebar = SDLK_SPACE,
 			eEscape = SDLK_ESCAPE,
+			eF2 = SDLK_F2,
+			eF3 = SDLK_F3,
+			eF4 = SDLK_F4,
+			eF5 = SDLK_F5,
+			eF6 = SDLK_F6,
+			eF7 = SDLK_F7,
+			eF8 = SDLK_F8,
+			eF9 = SDLK_F9,
+			eF10 = SDLK_F10,
 			eF11 = SDLK_F11,
+			eF12 = SDLK_F12,
 			eLeftShift = SDLK_LSHIFT,
 			eLeftCtrl = SDLK_LCTRL,
 			eLeftAlt = SDLK_LALT,
@@ -60,6 +71,14 @@ export namespace Input {
 		bool static inline relative() noexcept { return Data::get().mouse_relative; }
 	};
 	
+	// check for any input that could change what is shown this frame
+	bool inline active() noexcept {
+		Data& data = Data::get();
+		bool mouse_moved = data.mouse_relative && (data.mouse_delta.x != 0 || data.mouse_delta.y != 0);
+		return mouse_moved ||
+			!data.keys_pressed.empty() || !data.keys_held.empty() || !data.keys_released.empty() ||
+			!data.buttons_pressed.empty() || !data.buttons_held.empty() || !data.buttons_released.empty();
+	}
 	// clear single-frame events
     void inline flush() noexcept {
 		Data::get().keys_pressed.clear();
@@ -75,6 +94,24 @@ export namespace Input {
 		Data::get().buttons_held.clear();
 	}
 
+	// fold a later snapshot of events into an earlier one
+	void merge(Data& data, Data&& snapshot) {
+		data.keys_pressed.merge(snapshot.keys_pressed);
+		data.keys_released.merge(snapshot.keys_released);
+		data.buttons_pressed.merge(snapshot.buttons_pressed);
+		data.buttons_released.merge(snapshot.buttons_released);
+		data.keys_held = std::move(snapshot.keys_held);
+		data.buttons_held = std::move(snapshot.buttons_held);
+		data.mouse_delta.x += snapshot.mouse_delta.x;
+		data.mouse_delta.y += snapshot.mouse_delta.y;
+		data.mouse_position = snapshot.mouse_position;
+		data.mouse_relative = snapshot.mouse_relative;
+	}
+	// fold a snapshot of another thread's events into this thread's state
+	void merge(Data&& snapshot) {
+		merge(Data::get(), std::move(snapshot));
+	}
+
 	void register_key_press(int key) {
 		Data::get().keys_pressed.insert(key);
 		Data::get().keys_held.insert(key);
@@ -0,0 +1,252 @@
+export module core.jobs;
+import std;
+import vulkan_hpp;
+
+// work-stealing scheduler shared by the whole engine
+// every worker owns a deque, pushing and popping its own tasks at the back while idle workers steal from the front
+// tasks may depend on other tasks and on timeline semaphore values signaled by the GPU
+export struct Jobs {
+    struct Task;
+    using Handle = std::shared_ptr<Task>;
+
+    // pool used by all systems, started on first use with one worker per hardware thread besides the caller
+    static auto get() -> Jobs& {
+        static Jobs instance(std::max(1u, std::thread::hardware_concurrency()) - 1);
+        return instance;
+    }
+    explicit Jobs(uint32_t worker_count);
+    ~Jobs();
+
+    // run fn once all dependencies completed
+    auto submit(std::function<void()>&& fn, std::span<const Handle> dependencies = {}) -> Handle;
+    // run fn once the timeline semaphore reached the value as well, the semaphore needs to outlive the task
+    auto submit_after(vk::Device device, vk::Semaphore semaphore, uint64_t value,
+        std::function<void()>&& fn, std::span<const Handle> dependencies = {}) -> Handle;
+    // block until the task completed, executing queued tasks in the meantime
+    void wait(const Handle& task);
+    // split [0, count) into at most max_chunks ranges of at least min_chunk and invoke fn(begin, end) on each
+    // the calling thread processes the first range and helps with the others until all completed
+    template<typename Fn>
+    void for_range(std::size_t count, std::size_t max_chunks, Fn&& fn, std::size_t min_chunk = 4096) {
+        if (count == 0) return;
+        std::size_t chunks = std::clamp<std::size_t>(max_chunks, 1, (count + min_chunk - 1) / min_chunk);
+        std::size_t chunk = (count + chunks - 1) / chunks;
+        std::vector<Handle> tasks;
+        tasks.reserve(chunks - 1);
+        for (std::size_t begin = chunk; begin < count; begin += chunk) {
+            std::size_t end = std::min(count, begin + chunk);
+            tasks.push_back(submit([&fn, begin, end]() { fn(begin, end); }));
+        }
+        fn(0, std::min(count, chunk));
+        for (auto& task: tasks) wait(task);
+    }
+    auto worker_count() -> uint32_t { return (uint32_t)_workers.size(); }
+
+    struct Task {
+        std::function<void()> fn;
+        std::atomic<uint32_t> blockers = 1; // unfinished dependencies, plus one held until submission finished
+        std::atomic<bool> done = false;
+        std::mutex mutex; // guards dependents against completing concurrently with their registration
+        std::vector<Handle> dependents;
+    };
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Handle> tasks;
+    };
+    struct GpuWait {
+        vk::Device device;
+        vk::Semaphore semaphore;
+        uint64_t value;
+        Handle task;
+    };
+    auto create(std::function<void()>&& fn, std::span<const Handle> dependencies) -> Handle;
+    // drop one blocker, queues the task once none are left
+    void release(const Handle& task);
+    void schedule(Handle&& task);
+    // pop from the own deque, then the shared queue, then steal. false if no task was found
+    auto run_one() -> bool;
+    void run_worker(uint32_t worker_i, std::stop_token stop);
+    void run_gpu_waits(std::stop_token stop);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::jthread> _threads;
+    // tasks submitted from threads outside the pool
+    std::mutex _shared_mutex;
+    std::deque<Handle> _shared;
+    // bumped whenever a task was queued or completed, idle threads wait on it
+    std::atomic<uint32_t> _epoch = 0;
+    // tasks waiting on the GPU, polled by a dedicated thread started by the first submit_after()
+    std::mutex _gpu_mutex;
+    std::condition_variable_any _gpu_condition;
+    std::vector<GpuWait> _gpu_waits;
+    std::jthread _gpu_thread;
+};
+
+module: private;
+// index of the worker owned by this thread, none outside the pool
+thread_local uint32_t worker_index = std::numeric_limits<uint32_t>::max();
+thread_local Jobs* worker_pool_p = nullptr;
+
+Jobs::Jobs(uint32_t worker_count) {
+    for (uint32_t i = 0; i < worker_count; i++) _workers.push_back(std::make_unique<Worker>());
+    for (uint32_t i = 0; i < worker_count; i++) {
+        _threads.emplace_back([this, i](std::stop_token stop) { run_worker(i, stop); });
+    }
+}
+Jobs::~Jobs() {
+    for (auto& thread: _threads) thread.request_stop();
+    _epoch.fetch_add(1, std::memory_order_release);
+    _epoch.notify_all();
+    _threads.clear();
+    _gpu_thread.request_stop();
+    _gpu_condition.notify_all();
+    if (_gpu_thread.joinable()) _gpu_thread.join();
+}
+auto Jobs::submit(std::function<void()>&& fn, std::span<const Handle> dependencies) -> Handle {
+    Handle task = create(std::move(fn), dependencies);
+    release(task);
+    return task;
+}
+auto Jobs::submit_after(vk::Device device, vk::Semaphore semaphore, uint64_t value,
+    std::function<void()>&& fn, std::span<const Handle> dependencies) -> Handle {
+    Handle task = create(std::move(fn), dependencies);
+    // the GPU wait is one more blocker, released by the polling thread
+    task->blockers.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::scoped_lock lock(_gpu_mutex);
+        // most processes never wait on the GPU through the pool, the polling thread starts with the first wait
+        if (!_gpu_thread.joinable()) _gpu_thread = std::jthread([this](std::stop_token stop) { run_gpu_waits(stop); });
+        _gpu_waits.push_back({ device, semaphore, value, task });
+    }
+    _gpu_condition.notify_one();
+    release(task);
+    return task;
+}
+void Jobs::wait(const Handle& task) {
+    while (!task->done.load(std::memory_order_acquire)) {
+        // read the epoch before looking for work, so a task queued in between still wakes the wait below
+        uint32_t epoch = _epoch.load(std::memory_order_acquire);
+        if (task->done.load(std::memory_order_acquire)) break;
+        if (run_one()) continue;
+        _epoch.wait(epoch, std::memory_order_acquire);
+    }
+}
+auto Jobs::create(std::function<void()>&& fn, std::span<const Handle> dependencies) -> Handle {
+    Handle task = std::make_shared<Task>();
+    task->fn = std::move(fn);
+    for (auto& dependency: dependencies) {
+        std::scoped_lock lock(dependency->mutex);
+        if (dependency->done.load(std::memory_order_relaxed)) continue;
+        task->blockers.fetch_add(1, std::memory_order_relaxed);
+        dependency->dependents.push_back(task);
+    }
+    return task;
+}
+void Jobs::release(const Handle& task) {
+    if (task->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1) schedule(Handle(task));
+}
+void Jobs::schedule(Handle&& task) {
+    // workers keep their own tasks, which are likely to share data with the one that queued them
+    if (worker_pool_p == this) {
+        Worker& worker = *_workers[worker_index];
+        std::scoped_lock lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    else {
+        std::scoped_lock lock(_shared_mutex);
+        _shared.push_back(std::move(task));
+    }
+    _epoch.fetch_add(1, std::memory_order_release);
+    _epoch.notify_all();
+}
+auto Jobs::run_one() -> bool {
+    Handle task;
+    auto pop = [&task](std::mutex& mutex, std::deque<Handle>& tasks, bool back) {
+        std::scoped_lock lock(mutex);
+        if (tasks.empty()) return false;
+        if (back) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        }
+        else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        return true;
+    };
+    bool own = worker_pool_p == this;
+    bool found = own && pop(_workers[worker_index]->mutex, _workers[worker_index]->tasks, true);
+    if (!found) found = pop(_shared_mutex, _shared, false);
+    // steal the oldest task of another worker, starting after the own index to spread thieves
+    uint32_t start = own ? worker_index + 1 : 0;
+    for (uint32_t i = 0; !found && i < _workers.size(); i++) {
+        Worker& victim = *_workers[(start + i) % _workers.size()];
+        found = pop(victim.mutex, victim.tasks, false);
+    }
+    if (!found) return false;
+
+    task->fn();
+    task->fn = nullptr;
+    std::vector<Handle> dependents;
+    {
+        std::scoped_lock lock(task->mutex);
+        task->done.store(true, std::memory_order_release);
+        dependents.swap(task->dependents);
+    }
+    for (auto& dependent: dependents) release(dependent);
+    // waiters on this task are woken through the epoch as well
+    _epoch.fetch_add(1, std::memory_order_release);
+    _epoch.notify_all();
+    return true;
+}
+void Jobs::run_worker(uint32_t worker_i, std::stop_token stop) {
+    worker_index = worker_i;
+    worker_pool_p = this;
+    while (!stop.stop_requested()) {
+        uint32_t epoch = _epoch.load(std::memory_order_acquire);
+        if (run_one()) continue;
+        if (stop.stop_requested()) break;
+        _epoch.wait(epoch, std::memory_order_acquire);
+    }
+}
+void Jobs::run_gpu_waits(std::stop_token stop) {
+    std::vector<GpuWait> waits;
+    std::vector<vk::Semaphore> semaphores;
+    std::vector<uint64_t> values;
+    while (true) {
+        {
+            std::unique_lock lock(_gpu_mutex);
+            _gpu_condition.wait(lock, stop, [this]() { return !_gpu_waits.empty(); });
+            if (stop.stop_requested()) return;
+            waits = _gpu_waits;
+        }
+        // sleep until any semaphore of the first device progressed, bounded so newly added waits are picked up
+        semaphores.clear();
+        values.clear();
+        for (auto& wait: waits) {
+            if (wait.device != waits.front().device) continue;
+            semaphores.push_back(wait.semaphore);
+            values.push_back(wait.value);
+        }
+        std::ignore = waits.front().device.waitSemaphores({
+            .flags = vk::SemaphoreWaitFlagBits::eAny,
+            .semaphoreCount = (uint32_t)semaphores.size(),
+            .pSemaphores = semaphores.data(),
+            .pValues = values.data(),
+        }, 1'000'000);
+
+        // release every task whose value was reached
+        std::vector<Handle> ready;
+        {
+            std::scoped_lock lock(_gpu_mutex);
+            std::erase_if(_gpu_waits, [&ready](GpuWait& wait) {
+                if (wait.device.getSemaphoreCounterValue(wait.semaphore) < wait.value) return false;
+                ready.push_back(std::move(wait.task));
+                return true;
+            });
+        }
+        for (auto& task: ready) release(task);
+    }
+}
\ No newline at end of file
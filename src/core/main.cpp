@@ -2,13 +2,13 @@ import core.engine;
 #define SDL_MAIN_USE_CALLBACKS
 #include <SDL3/SDL_main.h>
 
-SDL_AppResult SDL_AppInit(void **appstate_pp, int, char **) {
-    *appstate_pp = new Engine();
+SDL_AppResult SDL_AppInit(void **appstate_pp, int argc, char **argv) {
+    *appstate_pp = new Engine(argc, argv);
     return SDL_AppResult::SDL_APP_CONTINUE;
 }
 SDL_AppResult SDL_AppIterate(void *appstate_p) {
-    static_cast<Engine*>(appstate_p)->handle_iteration();
-    return SDL_AppResult::SDL_APP_CONTINUE;
+    bool running = static_cast<Engine*>(appstate_p)->handle_iteration();
+    return running ? SDL_AppResult::SDL_APP_CONTINUE : SDL_AppResult::SDL_APP_SUCCESS;
 }
 SDL_AppResult SDL_AppEvent(void *appstate_p, SDL_Event *event_p) {
     if (event_p->type == SDL_EventType::SDL_EVENT_QUIT) return SDL_AppResult::SDL_APP_SUCCESS;
@@ -0,0 +1,17 @@
+export module core.parallel;
+import std;
+import core.jobs;
+
+export namespace Parallel {
+    // threads used when no explicit count is given
+    auto default_thread_count() -> uint32_t {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    // split [0, count) into one contiguous range per thread and invoke fn(begin, end) on each
+    // the calling thread processes the first range, ranges smaller than min_chunk are merged
+    // ranges run as tasks of the shared job system, so nested and concurrent calls do not oversubscribe
+    template<typename Fn>
+    void for_range(std::size_t count, uint32_t thread_count, Fn&& fn, std::size_t min_chunk = 4096) {
+        Jobs::get().for_range(count, thread_count, std::forward<Fn>(fn), min_chunk);
+    }
+}
\ No newline at end of file
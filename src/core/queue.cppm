@@ -0,0 +1,39 @@
+export module core.queue;
+import std;
+
+// bounded lock-free queue for exactly one producer and one consumer thread
+// each index is only written by one side, slots are handed over through acquire/release on them
+export template<typename T, std::size_t Capacity> struct SpscQueue {
+    static_assert(std::has_single_bit(Capacity), "capacity must be a power of two");
+
+    // producer only, false if the queue is full and the value was not moved from
+    auto push(T&& value) -> bool {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head_cached == Capacity) {
+            _head_cached = _head.load(std::memory_order_acquire);
+            if (tail - _head_cached == Capacity) return false;
+        }
+        _slots[tail & (Capacity - 1)] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer only, false if the queue is empty
+    auto pop(T& value) -> bool {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cached) {
+            _tail_cached = _tail.load(std::memory_order_acquire);
+            if (head == _tail_cached) return false;
+        }
+        value = std::move(_slots[head & (Capacity - 1)]);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> _slots;
+    // separate cache lines keep both sides from invalidating each other on every operation
+    alignas(64) std::atomic<std::size_t> _head = 0;
+    std::size_t _tail_cached = 0; // consumer's view of _tail
+    alignas(64) std::atomic<std::size_t> _tail = 0;
+    std::size_t _head_cached = 0; // producer's view of _head
+};
\ No newline at end of file
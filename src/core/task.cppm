@@ -0,0 +1,57 @@
+export module core.task;
+import std;
+
+// eagerly started coroutine without a result, e.g. an upload awaiting its GPU submission
+// it runs until its first co_await that is not ready and is resumed by whoever completes that, see Device::poll()
+// other tasks may co_await it, Device::run() blocks until it finished
+export struct [[nodiscard]] GpuTask {
+    struct promise_type {
+        auto get_return_object() -> GpuTask { return GpuTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        auto initial_suspend() noexcept -> std::suspend_never { return {}; }
+        // stay suspended at the end so done() can be queried, continue with the awaiting task if any
+        auto final_suspend() noexcept {
+            struct Final {
+                auto await_ready() noexcept -> bool { return false; }
+                auto await_suspend(std::coroutine_handle<promise_type> handle) noexcept -> std::coroutine_handle<> {
+                    std::coroutine_handle<> continuation = handle.promise()._continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+                void await_resume() noexcept {}
+            };
+            return Final {};
+        }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+        std::coroutine_handle<> _continuation;
+        // set by the awaited submission, removes the handle from its waiters should the task be destroyed before completion
+        std::function<void()> _unregister;
+    };
+
+    GpuTask() = default;
+    explicit GpuTask(std::coroutine_handle<promise_type> handle): _handle(handle) {}
+    GpuTask(GpuTask&& other) noexcept: _handle(std::exchange(other._handle, nullptr)) {}
+    auto operator=(GpuTask&& other) noexcept -> GpuTask& {
+        if (this != &other) {
+            release();
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    // the coroutine frame is destroyed with the task, it should have finished by then
+    ~GpuTask() { release(); }
+
+    auto done() const -> bool { return !_handle || _handle.done(); }
+    // awaiting from another task continues it once this one finished
+    auto await_ready() const -> bool { return done(); }
+    void await_suspend(std::coroutine_handle<> awaiting) { _handle.promise()._continuation = awaiting; }
+    void await_resume() {}
+
+private:
+    void release() {
+        if (!_handle) return;
+        // an unfinished task must not be resumed once its frame is gone
+        if (!_handle.done() && _handle.promise()._unregister) _handle.promise()._unregister();
+        _handle.destroy();
+    }
+    std::coroutine_handle<promise_type> _handle;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+export module core.trace;
+import std;
+
+#ifdef CHAD_TRACING
+constexpr bool tracing = true;
+#else
+constexpr bool tracing = false;
+#endif
+
+// scoped CPU instrumentation zones, exported as Chrome/Perfetto trace JSON
+// zones compile to nothing unless built with USE_TRACING
+export struct Trace {
+    static constexpr bool enabled = tracing;
+    struct Zone {
+        // name needs static storage duration, e.g. a string literal
+        Zone(const char* name) {
+            if constexpr (enabled) {
+                _name = name;
+                _beg = now();
+            }
+        }
+        ~Zone() {
+            if constexpr (enabled) record(_name, _beg, now());
+        }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+        const char* _name;
+        uint64_t _beg;
+    };
+
+    // write zones of all threads, should be called while no other thread records
+    static void write_json(const std::filesystem::path& path);
+
+private:
+    static auto now() -> uint64_t {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static void record(const char* name, uint64_t beg, uint64_t end);
+};
+
+module: private;
+struct Event {
+    const char* name;
+    uint64_t beg, end;
+};
+// ring of the most recent events, only ever written by its owning thread
+struct ThreadBuffer {
+    static constexpr uint64_t capacity = 1 << 16;
+    std::vector<Event> events = std::vector<Event>(capacity);
+    std::atomic<uint64_t> count = 0;
+    uint32_t thread_i;
+};
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+thread_local ThreadBuffer* buffer_p = nullptr;
+
+void Trace::record(const char* name, uint64_t beg, uint64_t end) {
+    // registration locks once per thread, recording itself is lock-free
+    if (buffer_p == nullptr) {
+        std::scoped_lock lock(buffers_mutex);
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer_p = buffers.back().get();
+        buffer_p->thread_i = (uint32_t)buffers.size() - 1;
+    }
+    uint64_t count = buffer_p->count.load(std::memory_order_relaxed);
+    buffer_p->events[count % ThreadBuffer::capacity] = { name, beg, end };
+    buffer_p->count.store(count + 1, std::memory_order_release);
+}
+void Trace::write_json(const std::filesystem::path& path) {
+    if constexpr (!enabled) {
+        std::println("Tracing is disabled, rebuild with USE_TRACING");
+        return;
+    }
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::println("Failed to write trace to {}", path.string());
+        return;
+    }
+    std::scoped_lock lock(buffers_mutex);
+    // timestamps relative to the earliest recorded zone, in microseconds
+    uint64_t origin = std::numeric_limits<uint64_t>::max();
+    for (auto& buffer: buffers) {
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint64_t i = count - std::min(count, ThreadBuffer::capacity); i < count; i++) {
+            origin = std::min(origin, buffer->events[i % ThreadBuffer::capacity].beg);
+        }
+    }
+    file << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (auto& buffer: buffers) {
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        for (uint64_t i = count - std::min(count, ThreadBuffer::capacity); i < count; i++) {
+            const Event& event = buffer->events[i % ThreadBuffer::capacity];
+            file << std::format("{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                first ? "" : ",\n", event.name, buffer->thread_i,
+                (double)(event.beg - origin) / 1000.0, (double)(event.end - event.beg) / 1000.0);
+            first = false;
+        }
+    }
+    file << "\n]}\n";
+    std::println("Trace written to {}", path.string());
+}
\ No newline at end of file
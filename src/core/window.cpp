@@ -5,20 +5,31 @@ module core.window;
 import vulkan_hpp;
 
 void Window::init(const CreateInfo& info) {
-    // force wayland driver for now
-    #ifdef __unix__
-        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "wayland");
-    #endif
-    // init only the video subsystem
-    if (!SDL_InitSubSystem(SDL_INIT_VIDEO)) std::println("{}", SDL_GetError());
+    _size = info.size;
+    _focused = true;
+    _mode = info.window_mode;
+    _fullscreen_mode = info.fullscreen_mode;
+    _surface = nullptr;
+    _sdl_window_p = nullptr;
+    if (!info.headless) {
+        // force wayland driver for now
+        #ifdef __unix__
+            SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "wayland");
+        #endif
+        // init only the video subsystem
+        if (!SDL_InitSubSystem(SDL_INIT_VIDEO)) std::println("{}", SDL_GetError());
+    }
 
     // dynamic dispatcher init 1/3
     vk::detail::defaultDispatchLoaderDynamic.init();
 
-    // get required extensions for vulkan instance
-    Uint32 extension_count;
-    const char* const* extensions_required = SDL_Vulkan_GetInstanceExtensions(&extension_count);
-    if (extensions_required == nullptr) std::println("{}", SDL_GetError());
+    // get required extensions for vulkan instance, none without a surface
+    Uint32 extension_count = 0;
+    const char* const* extensions_required = nullptr;
+    if (!info.headless) {
+        extensions_required = SDL_Vulkan_GetInstanceExtensions(&extension_count);
+        if (extensions_required == nullptr) std::println("{}", SDL_GetError());
+    }
     // check availability of extensions
     auto extensions_available = vk::enumerateInstanceExtensionProperties();
     for (uint32_t i = 0; i < extension_count; i++) {
@@ -67,6 +78,7 @@ void Window::init(const CreateInfo& info) {
 
     // dynamic dispatcher init 2/3
     vk::detail::defaultDispatchLoaderDynamic.init(_instance);
+    if (info.headless) return;
 
     // create SDL window and a corresponding Vulkan surface
     _sdl_window_p = SDL_CreateWindow(info.name.c_str(), info.size.width, info.size.height,
@@ -77,11 +89,6 @@ void Window::init(const CreateInfo& info) {
     if (_sdl_window_p == nullptr) std::println("{}", SDL_GetError());
     if (!SDL_Vulkan_CreateSurface(_sdl_window_p, _instance, nullptr, (VkSurfaceKHR*)&_surface)) std::println("{}", SDL_GetError());
 
-    _size = info.size;
-    _focused = true;
-    _mode = info.window_mode;
-    _fullscreen_mode = info.fullscreen_mode;
-
     // pick the first display mode for the current display
     SDL_DisplayID display_id = SDL_GetDisplayForWindow(_sdl_window_p);
     if (display_id == 0) std::println("{}", SDL_GetError());
@@ -92,9 +99,9 @@ void Window::init(const CreateInfo& info) {
     if (_mode == Mode::eFullscreen) SDL_SetWindowFullscreenMode(_sdl_window_p, &_fullscreen_display_mode);
 }
 void Window::destroy() {
-    _instance.destroySurfaceKHR(_surface);
+    if (_surface) _instance.destroySurfaceKHR(_surface);
     _instance.destroy();
-    SDL_DestroyWindow(_sdl_window_p);
+    if (_sdl_window_p != nullptr) SDL_DestroyWindow(_sdl_window_p);
 }
 bool Window::handle_event(void* event_p) {
     SDL_Event& event = *static_cast<SDL_Event*>(event_p);
@@ -120,6 +127,9 @@ bool Window::handle_event(void* event_p) {
 void Window::delay(uint32_t ms) {
     SDL_Delay(ms);
 }
+void Window::wait_event(uint32_t timeout_ms) {
+    SDL_WaitEventTimeout(nullptr, (Sint32)timeout_ms);
+}
 void Window::set_window_mode(Mode window_mode) {
     switch (window_mode) {
         case Mode::eFullscreen: {
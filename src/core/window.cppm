@@ -13,6 +13,8 @@ export struct Window {
     bool handle_event(void* event);
 
     void delay(uint32_t ms);
+    // block until an event is queued or the timeout passed, the event stays queued
+    void wait_event(uint32_t timeout_ms);
     void set_window_mode(Mode window_mode);
     void set_mouse_relative(bool relative);
     
@@ -31,4 +33,5 @@ struct Window::CreateInfo {
     vk::Extent2D size = { 1280, 720 };
     Window::Mode window_mode = Window::eWindowed;
     Window::Mode fullscreen_mode = Window::eBorderless;
+    bool headless = false; // only create the vulkan instance, without window or surface
 };
\ No newline at end of file
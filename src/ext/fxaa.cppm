@@ -0,0 +1,73 @@
+export module ext.fxaa;
+import std;
+import vulkan_hpp;
+import core.device;
+import buffers.image;
+import renderer.pipeline;
+import renderer.bindless;
+import renderer.specialization;
+import renderer.graph;
+
+// single compute pass anti-aliasing, much cheaper than SMAA at lower quality
+export struct FXAA {
+    void init_pipelines(Device& device, Bindless& bindless, PipelineCache& pipelines, vk::Extent2D extent);
+    // declare transient output and the pass reading color, returns the anti-aliased image
+    auto add_passes(FrameGraph& graph, vk::Extent2D extent, FrameGraph::Resource color) -> FrameGraph::Resource;
+    // register input and output once the graph was compiled
+    void register_targets(Bindless& bindless, FrameGraph& graph);
+    void release_targets(Bindless& bindless);
+    // region of the color image holding the current frame, the pass skips the rest
+    void set_render_extent(vk::Extent2D extent) { _render_extent = extent; }
+
+private:
+    FrameGraph::Resource _res_color;
+    FrameGraph::Resource _res_output;
+    uint32_t _color_i = Bindless::invalid_index;
+    uint32_t _output_i = Bindless::invalid_index;
+    Compute* _pipe_fxaa;
+    vk::Extent2D _render_extent;
+};
+
+module: private;
+void FXAA::init_pipelines(Device& device, Bindless& bindless, PipelineCache& pipelines, vk::Extent2D extent) {
+    struct FxaaSpec { uint32_t image_size_x, image_size_y; };
+    Specialization<FxaaSpec> fxaa_spec {{ .image_size_x = extent.width, .image_size_y = extent.height }};
+    _pipe_fxaa = &pipelines.get(Compute::CreateInfo {
+        .device = device,
+        .bindless = bindless,
+        .cs_path = "fxaa/fxaa.comp",
+        .spec_info = fxaa_spec.info(),
+    });
+}
+auto FXAA::add_passes(FrameGraph& graph, vk::Extent2D extent, FrameGraph::Resource color) -> FrameGraph::Resource {
+    _res_color = color;
+    _res_output = graph.add_transient({
+        .format = vk::Format::eR16G16B16A16Sfloat,
+        .extent = extent,
+        .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+    });
+    graph.add_pass({
+        .name = "fxaa",
+        .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+        .async = true,
+        .accesses = {
+            { color, FrameGraph::eSampled },
+            { _res_output, FrameGraph::eStorageWrite },
+        },
+        .record = [this](vk::CommandBuffer cmd) {
+            uint32_t nx = (_render_extent.width + 7) / 8;
+            uint32_t ny = (_render_extent.height + 7) / 8;
+            _pipe_fxaa->push(cmd, std::array<uint32_t, 2>{ _color_i, _output_i });
+            _pipe_fxaa->execute(cmd, nx, ny, 1);
+        },
+    });
+    return _res_output;
+}
+void FXAA::register_targets(Bindless& bindless, FrameGraph& graph) {
+    _color_i = bindless.register_sampled(graph.get(_res_color));
+    _output_i = bindless.register_storage(graph.get(_res_output));
+}
+void FXAA::release_targets(Bindless& bindless) {
+    bindless.release(Bindless::eSampledImage, _color_i);
+    bindless.release(Bindless::eStorageImage, _output_i);
+}
\ No newline at end of file
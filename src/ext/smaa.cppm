@@ -2,154 +2,215 @@ module;
 #include "AreaTex.h"
 #include "SearchTex.h"
 export module ext.smaa;
+import std;
 import vulkan_hpp;
 import vulkan.allocator;
 import core.device;
+import core.task;
 import buffers.image;
 import renderer.pipeline;
+import renderer.bindless;
+import renderer.specialization;
+import renderer.graph;
 
 export struct SMAA {
-    void init(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil);
-    void destroy(Device& device);
-    void resize(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil);
-    void execute(vk::CommandBuffer cmd, Image& color, DepthStencil& depth_stencil);
-    auto get_output() -> Image&;
+    // presets of the reference implementation
+    enum class Quality: uint32_t { eLow, eMedium, eHigh, eUltra };
+    static constexpr vk::Format edges_format = vk::Format::eR8G8Unorm;
+    static constexpr vk::Format weights_format = vk::Format::eR8G8B8A8Unorm;
+
+    void init(Device& device, Bindless& bindless);
+    void destroy(Device& device, Bindless& bindless);
+    // pick pipeline variants, the blending pass writes into an image of output_format, converting to sRGB if requested
+    // compute runs edge detection and weight calculation as compute passes instead of stencil masked fullscreen passes
+    void init_pipelines(Device& device, Bindless& bindless, PipelineCache& pipelines, vk::Extent2D extent, vk::Format depth_stencil_format, vk::Format output_format, bool srgb_output, Quality quality, bool compute);
+    // declare transient render targets and the three passes reading color and writing output
+    void add_passes(FrameGraph& graph, vk::Extent2D extent, FrameGraph::Resource color, FrameGraph::Resource depth_stencil, FrameGraph::Resource output);
+    // register sampled inputs once the graph was compiled
+    void register_targets(Bindless& bindless, FrameGraph& graph);
+    void release_targets(Bindless& bindless);
+    // region of the targets holding the current frame, passes skip the rest
+    void set_render_extent(vk::Extent2D extent) { _render_extent = extent; }
 
 private:
-    void init_render_targets(Device& device, vk::Extent2D extent, vk::Format color_format);
-    void init_lookup_textures(Device& device);
-    void init_pipelines(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil);
+    void init_lookup_textures(Device& device, Bindless& bindless);
     
     // static images
     Image _img_area;
     Image _img_search;
-    // render targets
-    Image _img_edges;
-    Image _img_weights;
-    Image _img_output;
-    // pipelines
-    Graphics _pipe_edges;
-    Graphics _pipe_weights;
-    Graphics _pipe_blending;
+    // transient render targets and input within the frame graph
+    FrameGraph::Resource _res_edges;
+    FrameGraph::Resource _res_weights;
+    FrameGraph::Resource _res_color;
+    // bindless indices of sampled images
+    uint32_t _area_i = Bindless::invalid_index;
+    uint32_t _search_i = Bindless::invalid_index;
+    uint32_t _edges_i = Bindless::invalid_index;
+    uint32_t _weights_i = Bindless::invalid_index;
+    uint32_t _color_i = Bindless::invalid_index;
+    uint32_t _edges_storage_i = Bindless::invalid_index;
+    uint32_t _weights_storage_i = Bindless::invalid_index;
+    // pipelines, owned by the variant cache
+    Graphics* _pipe_edges;
+    Graphics* _pipe_weights;
+    Graphics* _pipe_blending;
+    Compute* _comp_edges;
+    Compute* _comp_weights;
+    bool _compute = false;
+    vk::Extent2D _render_extent;
 };
 
 module: private;
-void SMAA::init(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil) {
-    init_lookup_textures(device);
-    init_render_targets(device, extent, color._format);
-    init_pipelines(device, extent, color, depth_stencil);
+void SMAA::init(Device& device, Bindless& bindless) {
+    init_lookup_textures(device, bindless);
 }
-void SMAA::destroy(Device& device) {
+void SMAA::destroy(Device& device, Bindless& bindless) {
     // destroy images
-    _img_output.destroy(device);
-    _img_weights.destroy(device);
-    _img_edges.destroy(device);
+    release_targets(bindless);
+    bindless.release(Bindless::eSampledImage, _area_i);
+    bindless.release(Bindless::eSampledImage, _search_i);
     _img_area.destroy(device);
     _img_search.destroy(device);
-    // destroy pipelines
-    _pipe_blending.destroy(device);
-    _pipe_weights.destroy(device);
-    _pipe_edges.destroy(device);
-}
-void SMAA::resize(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil) {
-    // destroy images
-    _img_output.destroy(device);
-    _img_weights.destroy(device);
-    _img_edges.destroy(device);
-    // destroy pipelines
-    _pipe_blending.destroy(device);
-    _pipe_weights.destroy(device);
-    _pipe_edges.destroy(device);
-
-    // recreate them
-    init_render_targets(device, extent, color._format);
-    init_pipelines(device, extent, color, depth_stencil);
 }
-void SMAA::execute(vk::CommandBuffer cmd, Image& color, DepthStencil& depth_stencil) {
-    Image::TransitionInfo info_transition_read {
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eFragmentShader,
-        .dst_access = vk::AccessFlagBits2::eShaderSampledRead
-    };
-    Image::TransitionInfo info_transition_write {
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eColorAttachmentOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-        .dst_access = vk::AccessFlagBits2::eColorAttachmentWrite
-    };
-    // transition depth stencil for stencil tests
-    depth_stencil.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eEarlyFragmentTests,
-        .dst_access = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite
+void SMAA::add_passes(FrameGraph& graph, vk::Extent2D extent, FrameGraph::Resource color, FrameGraph::Resource depth_stencil, FrameGraph::Resource output) {
+    _res_color = color;
+    if (_compute) {
+        // storage images need a format with guaranteed storage support
+        _res_edges = graph.add_transient({
+            .format = weights_format,
+            .extent = extent,
+            .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+        });
+        _res_weights = graph.add_transient({
+            .format = weights_format,
+            .extent = extent,
+            .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+        });
+        // SMAA edge detection on color tiles cached in shared memory
+        graph.add_pass({
+            .name = "smaa_edges",
+            .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+            .async = true,
+            .accesses = {
+                { color, FrameGraph::eSampled },
+                { _res_edges, FrameGraph::eStorageWrite },
+            },
+            .record = [this](vk::CommandBuffer cmd) {
+                uint32_t nx = (_render_extent.width + 7) / 8;
+                uint32_t ny = (_render_extent.height + 7) / 8;
+                _comp_edges->push(cmd, std::array<uint32_t, 2>{ _color_i, _edges_storage_i });
+                _comp_edges->execute(cmd, nx, ny, 1);
+            },
+        });
+        // SMAA blending weight calculation on edge pixels compacted in shared memory
+        graph.add_pass({
+            .name = "smaa_weights",
+            .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+            .async = true,
+            .accesses = {
+                { _res_edges, FrameGraph::eSampled },
+                { _res_weights, FrameGraph::eStorageWrite },
+            },
+            .record = [this](vk::CommandBuffer cmd) {
+                uint32_t nx = (_render_extent.width + 7) / 8;
+                uint32_t ny = (_render_extent.height + 7) / 8;
+                _comp_weights->push(cmd, std::array<uint32_t, 4>{ _area_i, _search_i, _edges_i, _weights_storage_i });
+                _comp_weights->execute(cmd, nx, ny, 1);
+            },
+        });
+    }
+    else {
+        _res_edges = graph.add_transient({
+            .format = edges_format,
+            .extent = extent,
+            .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+        });
+        _res_weights = graph.add_transient({
+            .format = weights_format,
+            .extent = extent,
+            .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+        });
+        // SMAA edge detection, marks edges in the stencil buffer
+        graph.add_pass({
+            .name = "smaa_edges",
+            .accesses = {
+                { color, FrameGraph::eSampled },
+                { depth_stencil, FrameGraph::eDepthStencilAttachment },
+                { _res_edges, FrameGraph::eColorAttachment },
+            },
+            .record = [this, &graph, depth_stencil](vk::CommandBuffer cmd) {
+                _pipe_edges->set_render_area(_render_extent);
+                _pipe_edges->push(cmd, _color_i);
+                _pipe_edges->execute(cmd, graph.get(_res_edges), vk::AttachmentLoadOp::eClear, graph.get(depth_stencil), vk::AttachmentLoadOp::eLoad);
+            },
+        });
+        // SMAA blending weight calculation, only on marked edges
+        graph.add_pass({
+            .name = "smaa_weights",
+            .accesses = {
+                { _res_edges, FrameGraph::eSampled },
+                { depth_stencil, FrameGraph::eDepthStencilAttachment },
+                { _res_weights, FrameGraph::eColorAttachment },
+            },
+            .record = [this, &graph, depth_stencil](vk::CommandBuffer cmd) {
+                _pipe_weights->set_render_area(_render_extent);
+                _pipe_weights->push(cmd, std::array<uint32_t, 3>{ _area_i, _search_i, _edges_i });
+                _pipe_weights->execute(cmd, graph.get(_res_weights), vk::AttachmentLoadOp::eClear, graph.get(depth_stencil), vk::AttachmentLoadOp::eLoad);
+            },
+        });
+    }
+    // SMAA neighborhood blending with fused tone mapping, every pixel is overwritten
+    graph.add_pass({
+        .name = "smaa_blending",
+        .accesses = {
+            { _res_weights, FrameGraph::eSampled },
+            { color, FrameGraph::eSampled },
+            { output, FrameGraph::eColorAttachment },
+        },
+        .record = [this, &graph, output](vk::CommandBuffer cmd) {
+            _pipe_blending->set_render_area(_render_extent);
+            _pipe_blending->push(cmd, std::array<uint32_t, 2>{ _weights_i, _color_i });
+            _pipe_blending->execute(cmd, graph.get(output), vk::AttachmentLoadOp::eDontCare);
+        },
     });
-    // SMAA edge detection
-    color.transition_layout(info_transition_read);
-    _img_edges.transition_layout(info_transition_write);
-    _pipe_edges.execute(cmd, _img_edges, vk::AttachmentLoadOp::eClear, depth_stencil, vk::AttachmentLoadOp::eLoad);
-
-    // SMAA blending weight calculation
-    _img_edges.transition_layout(info_transition_read);
-    _img_weights.transition_layout(info_transition_write);
-    _pipe_weights.execute(cmd, _img_weights, vk::AttachmentLoadOp::eClear, depth_stencil, vk::AttachmentLoadOp::eLoad);
-
-    // SMAA neighborhood blending
-    _img_weights.transition_layout(info_transition_read);
-    _img_output.transition_layout(info_transition_write);
-    _pipe_blending.execute(cmd, _img_output, vk::AttachmentLoadOp::eClear);
 }
-auto SMAA::get_output() -> Image& {
-    return _img_output;
+void SMAA::register_targets(Bindless& bindless, FrameGraph& graph) {
+    _edges_i = bindless.register_sampled(graph.get(_res_edges));
+    _weights_i = bindless.register_sampled(graph.get(_res_weights));
+    _color_i = bindless.register_sampled(graph.get(_res_color));
+    if (_compute) {
+        _edges_storage_i = bindless.register_storage(graph.get(_res_edges));
+        _weights_storage_i = bindless.register_storage(graph.get(_res_weights));
+    }
 }
-void SMAA::init_render_targets(Device& device, vk::Extent2D extent, vk::Format color_format) {
-    // create SMAA render targets
-    _img_edges.init({
-        .device = device,
-        .format = vk::Format::eR8G8Unorm,
-        .extent { extent.width, extent.height, 1 },
-        .usage = 
-            vk::ImageUsageFlagBits::eColorAttachment | 
-            vk::ImageUsageFlagBits::eSampled,
-    });
-    _img_weights.init({
-        .device = device, 
-        .format = vk::Format::eR8G8B8A8Unorm,
-        .extent { extent.width, extent.height, 1 },
-        .usage = 
-            vk::ImageUsageFlagBits::eColorAttachment | 
-            vk::ImageUsageFlagBits::eSampled,
-    });
-    _img_output.init({
-        .device = device,
-        .format = color_format,
-        .extent { extent.width, extent.height, 1 },
-        .usage = 
-            vk::ImageUsageFlagBits::eColorAttachment |
-            vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eSampled
-    });
+void SMAA::release_targets(Bindless& bindless) {
+    bindless.release(Bindless::eSampledImage, _edges_i);
+    bindless.release(Bindless::eSampledImage, _weights_i);
+    bindless.release(Bindless::eSampledImage, _color_i);
+    bindless.release(Bindless::eStorageImage, _edges_storage_i);
+    bindless.release(Bindless::eStorageImage, _weights_storage_i);
 }
-void SMAA::init_lookup_textures(Device& device) {
+void SMAA::init_lookup_textures(Device& device, Bindless& bindless) {
     _img_search.init({
         .device = device,
         .format = vk::Format::eR8Unorm,
         .extent = { SEARCHTEX_WIDTH, SEARCHTEX_HEIGHT, 1 },
         .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+        .concurrent = true, // sampled by the weights pass on the async compute queue
     });
     auto search_tex = std::span(reinterpret_cast<const std::byte*>(searchTexBytes), sizeof(searchTexBytes));
-    _img_search.load_texture(device, search_tex);
+    GpuTask upload_search = _img_search.load_texture(device, search_tex);
     _img_area.init({
         .device = device,
         .format = vk::Format::eR8G8Unorm,
         .extent = { AREATEX_WIDTH, AREATEX_HEIGHT, 1 },
         .usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+        .concurrent = true,
     });
     auto area_tex = std::span(reinterpret_cast<const std::byte*>(areaTexBytes), sizeof(areaTexBytes));
-    _img_area.load_texture(device, area_tex);
-    // transition smaa textures to their permanent layouts
-    vk::CommandBuffer cmd = device.oneshot_begin(QueueType::eUniversal);
+    GpuTask upload_area = _img_area.load_texture(device, area_tex);
+    // transition smaa textures to their permanent layouts, ordered after both uploads on the same queue
+    vk::CommandBuffer cmd = device.command_begin(QueueType::eUniversal);
     Image::TransitionInfo info_transition {
         .cmd = cmd,
         .new_layout = vk::ImageLayout::eShaderReadOnlyOptimal,
@@ -158,38 +219,103 @@ void SMAA::init_lookup_textures(Device& device) {
     };
     _img_search.transition_layout(info_transition);
     _img_area.transition_layout(info_transition);
-    device.oneshot_end(QueueType::eUniversal, cmd);
+    device.submit(QueueType::eUniversal, cmd).wait();
+    device.run(upload_search);
+    device.run(upload_area);
+    _search_i = bindless.register_sampled(_img_search);
+    _area_i = bindless.register_sampled(_img_area);
 }
-void SMAA::init_pipelines(Device& device, vk::Extent2D extent, Image& color, DepthStencil& depth_stencil) {
-    // create SMAA pipelines
-    std::array<float, 4> SMAA_RT_METRICS = {
-        1.0f / (float)extent.width,
-        1.0f / (float)extent.height,
-        (float)extent.width,
-        (float)extent.height
+void SMAA::init_pipelines(Device& device, Bindless& bindless, PipelineCache& pipelines, vk::Extent2D extent, vk::Format depth_stencil_format, vk::Format output_format, bool srgb_output, Quality quality, bool compute) {
+    // quality presets, low and medium disable diagonal and corner detection
+    struct Preset {
+        float threshold;
+        int32_t max_search_steps;
+        int32_t max_search_steps_diag;
+        int32_t corner_rounding;
     };
-    std::array<vk::SpecializationMapEntry, 4> smaa_spec_entries {
-        vk::SpecializationMapEntry { .constantID = 0, .offset =  0, .size = 4 },
-        vk::SpecializationMapEntry { .constantID = 1, .offset =  4, .size = 4 },
-        vk::SpecializationMapEntry { .constantID = 2, .offset =  8, .size = 4 },
-        vk::SpecializationMapEntry { .constantID = 3, .offset = 12, .size = 4 }
+    constexpr std::array<Preset, 4> presets {{
+        { .threshold = 0.15f, .max_search_steps = 4,  .max_search_steps_diag = 0,  .corner_rounding = 100 },
+        { .threshold = 0.10f, .max_search_steps = 8,  .max_search_steps_diag = 0,  .corner_rounding = 100 },
+        { .threshold = 0.10f, .max_search_steps = 16, .max_search_steps_diag = 8,  .corner_rounding = 25 },
+        { .threshold = 0.05f, .max_search_steps = 32, .max_search_steps_diag = 16, .corner_rounding = 25 },
+    }};
+    const Preset& preset = presets[(uint32_t)quality];
+    _compute = compute;
+
+    // create SMAA pipelines
+    struct SmaaSpec {
+        float rt_metrics_x, rt_metrics_y, rt_metrics_z, rt_metrics_w;
+        float threshold;
+        int32_t max_search_steps, max_search_steps_diag, corner_rounding;
     };
-    vk::SpecializationInfo smaa_spec_info = {
-        .mapEntryCount = (uint32_t)smaa_spec_entries.size(),
-        .pMapEntries = smaa_spec_entries.data(),
-        .dataSize = sizeof(SMAA_RT_METRICS),
-        .pData = &SMAA_RT_METRICS
+    Specialization<SmaaSpec> smaa_spec {{
+        .rt_metrics_x = 1.0f / (float)extent.width,
+        .rt_metrics_y = 1.0f / (float)extent.height,
+        .rt_metrics_z = (float)extent.width,
+        .rt_metrics_w = (float)extent.height,
+        .threshold = preset.threshold,
+        .max_search_steps = preset.max_search_steps,
+        .max_search_steps_diag = preset.max_search_steps_diag,
+        .corner_rounding = preset.corner_rounding,
+    }};
+    vk::SpecializationInfo smaa_spec_info = smaa_spec.info();
+    // blending additionally toggles the fused sRGB conversion
+    struct BlendingSpec {
+        float rt_metrics_x, rt_metrics_y, rt_metrics_z, rt_metrics_w;
+        float threshold;
+        int32_t max_search_steps, max_search_steps_diag, corner_rounding;
+        vk::Bool32 srgb;
     };
-    _pipe_edges.init({
+    Specialization<BlendingSpec> blending_spec {{
+        .rt_metrics_x = smaa_spec._data.rt_metrics_x,
+        .rt_metrics_y = smaa_spec._data.rt_metrics_y,
+        .rt_metrics_z = smaa_spec._data.rt_metrics_z,
+        .rt_metrics_w = smaa_spec._data.rt_metrics_w,
+        .threshold = preset.threshold,
+        .max_search_steps = preset.max_search_steps,
+        .max_search_steps_diag = preset.max_search_steps_diag,
+        .corner_rounding = preset.corner_rounding,
+        .srgb = srgb_output,
+    }};
+    _pipe_blending = &pipelines.get(Graphics::CreateInfo {
+        .device = device,
+        .bindless = bindless,
+        .extent = extent,
+        .vs_path = "smaa/blending.vert", .vs_spec = smaa_spec_info,
+        .fs_path = "smaa/blending.frag", .fs_spec = blending_spec.info(),
+        .color {
+            .formats = output_format,
+        },
+        .dynamic_states = {
+            vk::DynamicState::eScissor,
+        },
+    });
+    if (compute) {
+        _comp_edges = &pipelines.get(Compute::CreateInfo {
+            .device = device,
+            .bindless = bindless,
+            .cs_path = "smaa/edges.comp",
+            .spec_info = smaa_spec_info,
+        });
+        _comp_weights = &pipelines.get(Compute::CreateInfo {
+            .device = device,
+            .bindless = bindless,
+            .cs_path = "smaa/weights.comp",
+            .spec_info = smaa_spec_info,
+        });
+        return;
+    }
+    _pipe_edges = &pipelines.get(Graphics::CreateInfo {
         .device = device,
+        .bindless = bindless,
         .extent = extent,
         .vs_path = "smaa/edges.vert", .vs_spec = smaa_spec_info,
         .fs_path = "smaa/edges.frag", .fs_spec = smaa_spec_info,
         .color {
-            .formats = _img_edges._format,
+            .formats = edges_format,
         },
         .stencil {
-            .format = depth_stencil._format,
+            .format = depth_stencil_format,
             .test = vk::True,
             .front = {
                 .failOp = vk::StencilOp::eKeep,
@@ -200,17 +326,21 @@ void SMAA::init_pipelines(Device& device, vk::Extent2D extent, Image& color, Dep
                 .reference = 1,
             }
         },
+        .dynamic_states = {
+            vk::DynamicState::eScissor,
+        },
     });
-    _pipe_weights.init({
+    _pipe_weights = &pipelines.get(Graphics::CreateInfo {
         .device = device,
+        .bindless = bindless,
         .extent = extent,
         .vs_path = "smaa/weights.vert", .vs_spec = smaa_spec_info,
         .fs_path = "smaa/weights.frag", .fs_spec = smaa_spec_info,
         .color {
-            .formats = _img_weights._format,
+            .formats = weights_format,
         },
         .stencil {
-            .format = depth_stencil._format,
+            .format = depth_stencil_format,
             .test = vk::True,
             .front = {
                 .failOp = vk::StencilOp::eKeep,
@@ -221,23 +351,8 @@ void SMAA::init_pipelines(Device& device, vk::Extent2D extent, Image& color, Dep
                 .reference = 1,
             },
         },
-    });
-    _pipe_blending.init({
-        .device = device,
-        .extent = extent,
-        .vs_path = "smaa/blending.vert", .vs_spec = smaa_spec_info,
-        .fs_path = "smaa/blending.frag", .fs_spec = smaa_spec_info,
-        .color {
-            .formats = color._format,
+        .dynamic_states = {
+            vk::DynamicState::eScissor,
         },
     });
-    // update SMAA input texture descriptors
-    _pipe_edges.write_descriptor(device, 0, 0, color, vk::DescriptorType::eCombinedImageSampler);
-    //
-    _pipe_weights.write_descriptor(device, 0, 0, _img_area, vk::DescriptorType::eCombinedImageSampler);
-    _pipe_weights.write_descriptor(device, 0, 1, _img_search, vk::DescriptorType::eCombinedImageSampler);
-    _pipe_weights.write_descriptor(device, 0, 2, _img_edges, vk::DescriptorType::eCombinedImageSampler);
-    //
-    _pipe_blending.write_descriptor(device, 0, 0, _img_weights, vk::DescriptorType::eCombinedImageSampler);
-    _pipe_blending.write_descriptor(device, 0, 1, color, vk::DescriptorType::eCombinedImageSampler);
 }
\ No newline at end of file
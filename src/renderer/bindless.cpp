@@ -0,0 +1,186 @@
+module renderer.bindless;
+
+void Bindless::init(Device& device) {
+    // size each array by the device limits, capped to sensible defaults
+    auto props = device._physical.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    auto& props_vk12 = props.get<vk::PhysicalDeviceVulkan12Properties>();
+    _slots[eSampledImage] = { ._capacity = std::min<uint32_t>(4096, props_vk12.maxPerStageDescriptorUpdateAfterBindSampledImages), ._next = 0 };
+    _slots[eStorageImage] = { ._capacity = std::min<uint32_t>(1024, props_vk12.maxPerStageDescriptorUpdateAfterBindStorageImages), ._next = 0 };
+    _slots[eStorageBuffer] = { ._capacity = std::min<uint32_t>(4096, props_vk12.maxPerStageDescriptorUpdateAfterBindStorageBuffers), ._next = 0 };
+
+    // create set layout with partially bound arrays that may be updated while in use
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings {{
+        { .binding = eSampledImage, .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = _slots[eSampledImage]._capacity, .stageFlags = vk::ShaderStageFlagBits::eAll },
+        { .binding = eStorageImage, .descriptorType = vk::DescriptorType::eStorageImage,
+            .descriptorCount = _slots[eStorageImage]._capacity, .stageFlags = vk::ShaderStageFlagBits::eAll },
+        { .binding = eStorageBuffer, .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = _slots[eStorageBuffer]._capacity, .stageFlags = vk::ShaderStageFlagBits::eAll },
+    }};
+    vk::DescriptorBindingFlags flags =
+        vk::DescriptorBindingFlagBits::ePartiallyBound |
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+        vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending;
+    std::array<vk::DescriptorBindingFlags, 3> binding_flags { flags, flags, flags };
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo info_flags {
+        .bindingCount = (uint32_t)binding_flags.size(),
+        .pBindingFlags = binding_flags.data(),
+    };
+    _set_layout = device._logical.createDescriptorSetLayout({
+        .pNext = &info_flags,
+        .flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+        .bindingCount = (uint32_t)bindings.size(),
+        .pBindings = bindings.data(),
+    });
+
+    // create pool holding exactly the one global set
+    std::array<vk::DescriptorPoolSize, 3> pool_sizes {{
+        { .type = vk::DescriptorType::eCombinedImageSampler, .descriptorCount = _slots[eSampledImage]._capacity },
+        { .type = vk::DescriptorType::eStorageImage, .descriptorCount = _slots[eStorageImage]._capacity },
+        { .type = vk::DescriptorType::eStorageBuffer, .descriptorCount = _slots[eStorageBuffer]._capacity },
+    }};
+    _pool = device._logical.createDescriptorPool({
+        .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+        .maxSets = 1,
+        .poolSizeCount = (uint32_t)pool_sizes.size(),
+        .pPoolSizes = pool_sizes.data(),
+    });
+    _set = device._logical.allocateDescriptorSets({
+        .descriptorPool = _pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &_set_layout,
+    }).front();
+
+    // every pipeline shares this layout, which keeps the set bound across pipeline switches
+    vk::PushConstantRange push_range {
+        .stageFlags = vk::ShaderStageFlagBits::eAll,
+        .offset = 0,
+        .size = push_constant_size,
+    };
+    _pipeline_layout = device._logical.createPipelineLayout({
+        .setLayoutCount = 1,
+        .pSetLayouts = &_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    });
+
+    // default sampler for all sampled images
+    _sampler = device._logical.createSampler({
+        .magFilter = vk::Filter::eLinear,
+        .minFilter = vk::Filter::eLinear,
+        .mipmapMode = vk::SamplerMipmapMode::eLinear,
+        .addressModeU = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeV = vk::SamplerAddressMode::eClampToEdge,
+        .addressModeW = vk::SamplerAddressMode::eClampToEdge,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = vk::False,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = vk::False,
+        .compareOp = vk::CompareOp::eAlways,
+        .minLod = 0.0f,
+        .maxLod = vk::LodClampNone,
+        .borderColor = vk::BorderColor::eIntOpaqueBlack,
+        .unnormalizedCoordinates = vk::False,
+    });
+}
+void Bindless::destroy(Device& device) {
+    device._logical.destroySampler(_sampler);
+    device._logical.destroyPipelineLayout(_pipeline_layout);
+    device._logical.destroyDescriptorPool(_pool);
+    device._logical.destroyDescriptorSetLayout(_set_layout);
+    for (auto& slots: _slots) slots._free.clear();
+    _pending.clear();
+}
+auto Bindless::register_sampled(vk::ImageView view) -> uint32_t {
+    uint32_t index = _slots[eSampledImage].acquire();
+    _pending.push_back({
+        .binding = eSampledImage,
+        .index = index,
+        .info_image {
+            .sampler = _sampler,
+            .imageView = view,
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+        },
+    });
+    return index;
+}
+auto Bindless::register_storage(vk::ImageView view) -> uint32_t {
+    uint32_t index = _slots[eStorageImage].acquire();
+    _pending.push_back({
+        .binding = eStorageImage,
+        .index = index,
+        .info_image {
+            .imageView = view,
+            .imageLayout = vk::ImageLayout::eGeneral,
+        },
+    });
+    return index;
+}
+auto Bindless::register_buffer(DeviceBuffer& buffer, vk::DeviceSize offset, vk::DeviceSize range) -> uint32_t {
+    uint32_t index = _slots[eStorageBuffer].acquire();
+    _pending.push_back({
+        .binding = eStorageBuffer,
+        .index = index,
+        .info_buffer {
+            .buffer = buffer._data,
+            .offset = offset,
+            .range = range,
+        },
+    });
+    return index;
+}
+void Bindless::release(Binding binding, uint32_t& index) {
+    if (index == invalid_index) return;
+    // drop pending writes to this slot in case it was never flushed
+    std::erase_if(_pending, [&](PendingWrite& write) {
+        return write.binding == binding && write.index == index;
+    });
+    _slots[binding]._free.push_back(index);
+    index = invalid_index;
+}
+void Bindless::flush(Device& device) {
+    if (_pending.empty()) return;
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(_pending.size());
+    for (auto& pending: _pending) {
+        vk::WriteDescriptorSet write {
+            .dstSet = _set,
+            .dstBinding = pending.binding,
+            .dstArrayElement = pending.index,
+            .descriptorCount = 1,
+        };
+        switch (pending.binding) {
+            case eSampledImage:
+                write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+                write.pImageInfo = &pending.info_image;
+                break;
+            case eStorageImage:
+                write.descriptorType = vk::DescriptorType::eStorageImage;
+                write.pImageInfo = &pending.info_image;
+                break;
+            case eStorageBuffer:
+                write.descriptorType = vk::DescriptorType::eStorageBuffer;
+                write.pBufferInfo = &pending.info_buffer;
+                break;
+        }
+        writes.push_back(write);
+    }
+    device._logical.updateDescriptorSets(writes, {});
+    _pending.clear();
+}
+void Bindless::bind(vk::CommandBuffer cmd, bool graphics) {
+    if (graphics) cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, _set, {});
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, _set, {});
+}
+
+auto Bindless::Slots::acquire() -> uint32_t {
+    // prefer recycled indices to keep arrays dense
+    if (!_free.empty()) {
+        uint32_t index = _free.back();
+        _free.pop_back();
+        return index;
+    }
+    // handing out an index in use would silently alias another resource
+    if (_next >= _capacity) throw std::runtime_error(std::format("bindless array exhausted at {} descriptors", _capacity));
+    return _next++;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+export module renderer.bindless;
+import std;
+import vulkan_hpp;
+import core.device;
+import buffers.image;
+import buffers.device;
+
+// single global descriptor set with resource arrays, indexed by shaders via push constants
+export struct Bindless {
+    enum Binding: uint32_t { eSampledImage = 0, eStorageImage = 1, eStorageBuffer = 2 };
+    static constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+    static constexpr uint32_t push_constant_size = 128; // guaranteed minimum of maxPushConstantsSize
+
+    void init(Device& device);
+    void destroy(Device& device);
+
+    // registrations throw std::runtime_error once the binding's array is exhausted
+    // register image for sampling in shader read-only layout, returns stable array index
+    auto register_sampled(Image& image) -> uint32_t { return register_sampled(image._view); }
+    auto register_sampled(vk::ImageView view) -> uint32_t;
+    // register image for load/store in general layout, returns stable array index
+    auto register_storage(Image& image) -> uint32_t { return register_storage(image._view); }
+    auto register_storage(vk::ImageView view) -> uint32_t;
+    // register (a range of) a storage buffer, returns stable array index
+    auto register_buffer(DeviceBuffer& buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = vk::WholeSize) -> uint32_t;
+    // return index to its array for later registrations
+    void release(Binding binding, uint32_t& index);
+    // write all pending descriptors with a single update call
+    void flush(Device& device);
+    // bind global descriptor set, persists across pipeline binds with the shared layout
+    // graphics is skipped for command buffers of compute-only queue families
+    void bind(vk::CommandBuffer cmd, bool graphics = true);
+
+    vk::DescriptorPool _pool;
+    vk::DescriptorSetLayout _set_layout;
+    vk::DescriptorSet _set;
+    vk::PipelineLayout _pipeline_layout;
+    vk::Sampler _sampler;
+
+private:
+    struct Slots {
+        auto acquire() -> uint32_t;
+        uint32_t _capacity;
+        uint32_t _next;
+        std::vector<uint32_t> _free;
+    };
+    struct PendingWrite {
+        Binding binding;
+        uint32_t index;
+        vk::DescriptorImageInfo info_image;
+        vk::DescriptorBufferInfo info_buffer;
+    };
+    std::array<Slots, 3> _slots;
+    std::vector<PendingWrite> _pending;
+};
\ No newline at end of file
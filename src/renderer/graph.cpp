@@ -0,0 +1,403 @@
+module renderer.graph;
+import core.jobs;
+
+struct State {
+    vk::ImageLayout layout;
+    vk::PipelineStageFlags2 stage;
+    vk::AccessFlags2 access;
+};
+auto get_state(FrameGraph::Usage usage, vk::PipelineStageFlags2 shader_stage) -> State {
+    switch (usage) {
+        case FrameGraph::eColorAttachment: return {
+            vk::ImageLayout::eColorAttachmentOptimal,
+            vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+            vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite };
+        case FrameGraph::eDepthStencilAttachment: return {
+            vk::ImageLayout::eDepthStencilAttachmentOptimal,
+            vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+            vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite };
+        case FrameGraph::eSampled: return {
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            shader_stage,
+            vk::AccessFlagBits2::eShaderSampledRead };
+        case FrameGraph::eStorageRead: return {
+            vk::ImageLayout::eGeneral,
+            shader_stage,
+            vk::AccessFlagBits2::eShaderStorageRead };
+        case FrameGraph::eStorageWrite: return {
+            vk::ImageLayout::eGeneral,
+            shader_stage,
+            vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite };
+    }
+    return {};
+}
+constexpr vk::AccessFlags2 write_mask =
+    vk::AccessFlagBits2::eShaderWrite |
+    vk::AccessFlagBits2::eShaderStorageWrite |
+    vk::AccessFlagBits2::eColorAttachmentWrite |
+    vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+    vk::AccessFlagBits2::eTransferWrite |
+    vk::AccessFlagBits2::eHostWrite |
+    vk::AccessFlagBits2::eMemoryWrite;
+
+auto FrameGraph::add_external(Image* image_p) -> Resource {
+    _entries.push_back({ .image_p = image_p, .transient = false });
+    return (Resource)_entries.size() - 1;
+}
+auto FrameGraph::add_transient(const TransientInfo& info) -> Resource {
+    _entries.push_back({ .image_p = nullptr, .transient = true, .info = info });
+    return (Resource)_entries.size() - 1;
+}
+void FrameGraph::add_pass(Pass&& pass) {
+    _passes.push_back(std::move(pass));
+}
+void FrameGraph::compile(Device& device, bool async) {
+    // split into segments by queue, the final one takes back ownership of images used on the async queue
+    _universal_family = device._universal_i;
+    _async_family = device._compute_i;
+    auto last_sync = std::find_if(_passes.crbegin(), _passes.crend(), [](const Pass& pass) { return !pass.async; });
+    std::size_t sync_end = last_sync == _passes.crend() ? 0 : _passes.crend() - last_sync;
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) {
+        bool pass_async = async && _passes[pass_i].async && pass_i < sync_end;
+        if (_segments.empty() || _segments.back().async != pass_async) _segments.push_back({ .async = pass_async });
+        _pass_segments.push_back((uint32_t)_segments.size() - 1);
+    }
+    _pass_barriers.resize(_passes.size());
+    _segment_releases.resize(_segments.size());
+
+    // lifetimes span from the first to the last pass using a resource
+    for (auto& entry: _entries) {
+        entry.first_pass = std::numeric_limits<uint32_t>::max();
+        entry.last_pass = 0;
+    }
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) {
+        for (auto& access: _passes[pass_i].accesses) {
+            Entry& entry = _entries[access.resource];
+            entry.first_pass = std::min(entry.first_pass, pass_i);
+            entry.last_pass = std::max(entry.last_pass, pass_i);
+        }
+    }
+
+    // memory types whose backing is only committed on demand, e.g. tile memory on mobile GPUs
+    auto mem_props = device._physical.getMemoryProperties();
+    uint32_t lazy_types = 0;
+    for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
+        if (mem_props.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated) lazy_types |= 1 << i;
+    }
+
+    // create transient images without memory to query their requirements
+    std::vector<Resource> order;
+    std::vector<vk::MemoryRequirements> requirements(_entries.size());
+    _transients.resize(std::count_if(_entries.cbegin(), _entries.cend(), [](const Entry& entry) { return entry.transient; }));
+    uint32_t transient_i = 0;
+    for (Resource res = 0; res < _entries.size(); res++) {
+        Entry& entry = _entries[res];
+        if (!entry.transient) continue;
+        if (entry.first_pass > entry.last_pass) {
+            std::println("Frame graph transient {} is never used", res);
+            entry.first_pass = entry.last_pass = 0;
+        }
+        // attachments that are never sampled or stored may live in lazily allocated memory
+        vk::ImageUsageFlags attachment_usage =
+            vk::ImageUsageFlagBits::eColorAttachment |
+            vk::ImageUsageFlagBits::eDepthStencilAttachment |
+            vk::ImageUsageFlagBits::eInputAttachment;
+        entry.lazy = lazy_types != 0 && !(entry.info.usage & ~attachment_usage);
+        vk::ImageUsageFlags usage = entry.info.usage;
+        if (entry.lazy) usage |= vk::ImageUsageFlagBits::eTransientAttachment;
+        vk::Image image = device._logical.createImage({
+            .imageType = vk::ImageType::e2D,
+            .format = entry.info.format,
+            .extent { entry.info.extent.width, entry.info.extent.height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = usage,
+        });
+        requirements[res] = device._logical.getImageMemoryRequirements(image);
+        if (!(requirements[res].memoryTypeBits & lazy_types)) entry.lazy = false;
+        _transients[transient_i].wrap({
+            .image = image,
+            .image_view = nullptr,
+            .format = entry.info.format,
+            .extent { entry.info.extent.width, entry.info.extent.height, 1 },
+            .aspects = entry.info.aspects,
+        });
+        entry.image_p = &_transients[transient_i++];
+        order.push_back(res);
+    }
+
+    // place largest images first, each into the first block whose occupants have disjoint lifetimes
+    std::sort(order.begin(), order.end(), [&](Resource a, Resource b) {
+        return requirements[a].size > requirements[b].size;
+    });
+    for (Resource res: order) {
+        Entry& entry = _entries[res];
+        vk::MemoryRequirements& reqs = requirements[res];
+        auto overlaps = [&](Resource other) {
+            return !(entry.last_pass < _entries[other].first_pass || _entries[other].last_pass < entry.first_pass);
+        };
+        entry.block = std::numeric_limits<uint32_t>::max();
+        // lazily allocated memory is committed per image, so it is never shared
+        for (uint32_t block_i = 0; block_i < _blocks.size() && !entry.lazy; block_i++) {
+            Block& block = _blocks[block_i];
+            if (block.lazy) continue;
+            if (!(block.requirements.memoryTypeBits & reqs.memoryTypeBits)) continue;
+            if (std::any_of(block.occupants.cbegin(), block.occupants.cend(), overlaps)) continue;
+            block.requirements.size = std::max(block.requirements.size, reqs.size);
+            block.requirements.alignment = std::max(block.requirements.alignment, reqs.alignment);
+            block.requirements.memoryTypeBits &= reqs.memoryTypeBits;
+            block.occupants.push_back(res);
+            entry.block = block_i;
+            break;
+        }
+        if (entry.block == std::numeric_limits<uint32_t>::max()) {
+            entry.block = (uint32_t)_blocks.size();
+            _blocks.push_back({ .requirements = reqs, .occupants = { res }, .current_p = nullptr, .lazy = entry.lazy, .segment = no_segment });
+        }
+    }
+
+    // allocate shared memory and bind every occupant to its start
+    for (auto& block: _blocks) {
+        if (block.lazy) block.requirements.memoryTypeBits &= lazy_types;
+        vma::AllocationCreateInfo info_alloc {
+            .usage = block.lazy ? vma::MemoryUsage::eGpuLazilyAllocated : vma::MemoryUsage::eUnknown,
+            .requiredFlags = block.lazy ? vk::MemoryPropertyFlagBits::eLazilyAllocated : vk::MemoryPropertyFlagBits::eDeviceLocal,
+            .priority = 1.0f,
+        };
+        block.allocation = device._vmalloc.allocateMemory(block.requirements, info_alloc);
+        for (Resource res: block.occupants) {
+            Image& image = *_entries[res].image_p;
+            device._vmalloc.bindImageMemory(block.allocation, image._image);
+            image._view = device._logical.createImageView({
+                .image = image._image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = image._format,
+                .subresourceRange {
+                    .aspectMask = image._aspects,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            });
+        }
+    }
+    // segments only have to wait for earlier work where they touch images used by other segments too, including through aliased memory
+    std::vector<uint64_t> segment_bits(_entries.size(), 0);
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) {
+        for (auto& access: _passes[pass_i].accesses) segment_bits[access.resource] |= uint64_t(1) << std::min(_pass_segments[pass_i], 63u);
+    }
+    for (auto& block: _blocks) {
+        uint64_t bits = 0;
+        for (Resource res: block.occupants) bits |= segment_bits[res];
+        for (Resource res: block.occupants) segment_bits[res] = bits;
+    }
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) {
+        Pass& pass = _passes[pass_i];
+        for (auto& access: pass.accesses) {
+            if (std::popcount(segment_bits[access.resource]) < 2) continue;
+            _segments[_pass_segments[pass_i]].wait_stages |= get_state(access.usage, pass.shader_stage).stage;
+        }
+    }
+}
+void FrameGraph::destroy(Device& device) {
+    for (auto& image: _transients) {
+        device._logical.destroyImageView(image._view);
+        device._logical.destroyImage(image._image);
+    }
+    for (auto& block: _blocks) device._vmalloc.freeMemory(block.allocation);
+    _transients.clear();
+    _blocks.clear();
+    _entries.clear();
+    _passes.clear();
+    _segments.clear();
+    _pass_segments.clear();
+    _pass_barriers.clear();
+    _segment_releases.clear();
+    _secondaries.clear();
+}
+void FrameGraph::set_external(Resource resource, Image& image) {
+    _entries[resource].image_p = &image;
+}
+auto FrameGraph::get(Resource resource) -> Image& {
+    return *_entries[resource].image_p;
+}
+void FrameGraph::execute(std::span<const vk::CommandBuffer> cmds, Profiler& profiler) {
+    resolve_barriers();
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) record_pass(cmds, profiler, pass_i);
+}
+void FrameGraph::execute(Device& device, std::span<const vk::CommandBuffer> cmds, Profiler& profiler, std::span<RecordPool> pools,
+    const std::function<void(vk::CommandBuffer cmd, bool async)>& prepare) {
+    // image states are only touched here, so the jobs below merely read the graph
+    resolve_barriers();
+    vk::QueryPipelineStatisticFlags statistics = profiler.active() ? Profiler::statistic_flags : vk::QueryPipelineStatisticFlags {};
+    auto record_range = [&](uint32_t pool_i, uint32_t begin, uint32_t end) {
+        RecordPool& pool = pools[pool_i];
+        for (uint32_t pass_i = begin; pass_i < end; pass_i++) {
+            // async passes are only timed, so their secondaries never run within a statistics query
+            bool async = _segments[_pass_segments[pass_i]].async;
+            vk::CommandBufferInheritanceInfo inheritance { .pipelineStatistics = async ? vk::QueryPipelineStatisticFlags {} : statistics };
+            vk::CommandBuffer cmd = pool.next(device, async, inheritance);
+            prepare(cmd, async);
+            _passes[pass_i].record(cmd);
+            cmd.end();
+            _secondaries[pass_i] = cmd;
+        }
+    };
+
+    // one job per pool, the calling thread takes the first range
+    Jobs& jobs = Jobs::get();
+    uint32_t pass_count = (uint32_t)_passes.size();
+    uint32_t job_count = std::min((uint32_t)pools.size(), pass_count);
+    _secondaries.assign(pass_count, nullptr);
+    std::vector<Jobs::Handle> tasks;
+    for (uint32_t job_i = 1; job_i < job_count; job_i++) {
+        tasks.push_back(jobs.submit([&record_range, job_i, job_count, pass_count]() {
+            record_range(job_i, job_i * pass_count / job_count, (job_i + 1) * pass_count / job_count);
+        }));
+    }
+    if (job_count > 0) record_range(0, 0, pass_count / job_count);
+    for (auto& task: tasks) jobs.wait(task);
+
+    // stitch in pass order, command pools are externally synchronized so only this thread touches the primaries
+    for (uint32_t pass_i = 0; pass_i < pass_count; pass_i++) record_pass(cmds, profiler, pass_i, _secondaries[pass_i]);
+}
+void FrameGraph::resolve_barriers() {
+    // with a single segment every access is ordered by barriers on the same queue
+    bool split = _segments.size() > 1;
+    bool transfers = split && _universal_family != _async_family;
+    auto family = [this](uint32_t segment_i) { return _segments[segment_i].async ? _async_family : _universal_family; };
+    // ownership moves through a release on the queue giving up the image and a matching acquire on the receiving one
+    auto transfer = [&](vk::ImageMemoryBarrier2 barrier, uint32_t src_segment, uint32_t dst_segment) {
+        barrier.srcQueueFamilyIndex = family(src_segment);
+        barrier.dstQueueFamilyIndex = family(dst_segment);
+        vk::ImageMemoryBarrier2 release = barrier;
+        release.dstStageMask = vk::PipelineStageFlagBits2::eNone;
+        release.dstAccessMask = vk::AccessFlagBits2::eNone;
+        _segment_releases[src_segment].push_back(release);
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+        return barrier;
+    };
+    for (auto& releases: _segment_releases) releases.clear();
+    _final_barriers.clear();
+    if (split) {
+        for (auto& entry: _entries) entry.segment = no_segment;
+        for (auto& block: _blocks) block.segment = no_segment;
+    }
+
+    for (uint32_t pass_i = 0; pass_i < _passes.size(); pass_i++) {
+        Pass& pass = _passes[pass_i];
+        uint32_t segment_i = _pass_segments[pass_i];
+        std::vector<vk::ImageMemoryBarrier2>& barriers = _pass_barriers[pass_i];
+        barriers.clear();
+        for (auto& access: pass.accesses) {
+            Entry& entry = _entries[access.resource];
+            Image& image = *entry.image_p;
+            uint32_t prev_segment = entry.segment;
+            bool discard = false;
+            // transient contents are discarded at first use, after whichever occupant used the memory before
+            if (entry.transient && entry.first_pass == pass_i) {
+                Block& block = _blocks[entry.block];
+                if (block.current_p != nullptr && block.current_p != &image) {
+                    image._last_stage = block.current_p->_last_stage;
+                    image._last_access = block.current_p->_last_access;
+                }
+                image._last_layout = vk::ImageLayout::eUndefined;
+                block.current_p = &image;
+                prev_segment = block.segment;
+                discard = true;
+            }
+            entry.segment = segment_i;
+            if (entry.transient) _blocks[entry.block].segment = segment_i;
+            // accesses from another segment are ordered by semaphores, only the layout still needs a barrier
+            bool crossing = split && prev_segment != segment_i;
+            bool owned = !transfers || discard || prev_segment == no_segment || family(prev_segment) == family(segment_i);
+
+            // reads following reads in the same layout only widen the tracked scope
+            State state = get_state(access.usage, pass.shader_stage);
+            bool write = static_cast<bool>(state.access & write_mask);
+            bool prev_write = static_cast<bool>(image._last_access & write_mask);
+            if (owned && !write && !prev_write && state.layout == image._last_layout) {
+                image._last_stage |= state.stage;
+                image._last_access |= state.access;
+                continue;
+            }
+            vk::ImageMemoryBarrier2 barrier = image.barrier(state.layout, state.stage, state.access);
+            if (!owned) barrier = transfer(barrier, prev_segment, segment_i);
+            else if (crossing && prev_segment != no_segment) {
+                barrier.srcStageMask = vk::PipelineStageFlagBits2::eAllCommands;
+                barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+            }
+            // the previous frame may have used it on this queue or on another one, which the segment's wait covers
+            else if (crossing) barrier.srcStageMask |= vk::PipelineStageFlagBits2::eAllCommands;
+            barriers.push_back(barrier);
+        }
+    }
+
+    // external images start every frame owned by the universal queue family, transients are discarded anyway
+    if (!transfers) return;
+    uint32_t last_segment = (uint32_t)_segments.size() - 1;
+    for (auto& entry: _entries) {
+        if (entry.transient || entry.segment == no_segment || !_segments[entry.segment].async) continue;
+        Image& image = *entry.image_p;
+        vk::ImageMemoryBarrier2 barrier = image.barrier(image._last_layout, image._last_stage, image._last_access);
+        _final_barriers.push_back(transfer(barrier, entry.segment, last_segment));
+        entry.segment = last_segment;
+    }
+}
+void FrameGraph::record_pass(std::span<const vk::CommandBuffer> cmds, Profiler& profiler, uint32_t pass_i, vk::CommandBuffer secondary) {
+    auto barrier = [](vk::CommandBuffer cmd, const std::vector<vk::ImageMemoryBarrier2>& barriers) {
+        if (barriers.empty()) return;
+        cmd.pipelineBarrier2({
+            .imageMemoryBarrierCount = (uint32_t)barriers.size(),
+            .pImageMemoryBarriers = barriers.data(),
+        });
+    };
+    Pass& pass = _passes[pass_i];
+    uint32_t segment_i = _pass_segments[pass_i];
+    vk::CommandBuffer cmd = cmds[segment_i];
+    // single barrier call per pass boundary
+    barrier(cmd, _pass_barriers[pass_i]);
+    profiler.begin_pass(cmd, pass.name, _segments[segment_i].async);
+    if (secondary) cmd.executeCommands(secondary);
+    else pass.record(cmd);
+    profiler.end_pass(cmd);
+
+    // the segment's images are handed to other queue families once all of its passes were recorded
+    bool last = pass_i + 1 == _passes.size();
+    if (last || _pass_segments[pass_i + 1] != segment_i) barrier(cmd, _segment_releases[segment_i]);
+    if (last) barrier(cmd, _final_barriers);
+}
+auto FrameGraph::RecordPool::next(Device& device, bool async, const vk::CommandBufferInheritanceInfo& inheritance) -> vk::CommandBuffer {
+    std::vector<vk::CommandBuffer>& buffers = async ? _compute_buffers : _universal_buffers;
+    uint32_t& n = async ? _compute_n : _universal_n;
+    if (n == buffers.size()) {
+        buffers.push_back(device._logical.allocateCommandBuffers({
+            .commandPool = async ? _compute_pool : _universal_pool,
+            .level = vk::CommandBufferLevel::eSecondary,
+            .commandBufferCount = 1,
+        }).front());
+    }
+    vk::CommandBuffer cmd = buffers[n++];
+    cmd.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit, .pInheritanceInfo = &inheritance });
+    return cmd;
+}
+void FrameGraph::RecordPool::init(Device& device) {
+    _universal_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._universal_i });
+    _compute_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._compute_i });
+}
+void FrameGraph::RecordPool::destroy(Device& device) {
+    device._logical.destroyCommandPool(_universal_pool);
+    device._logical.destroyCommandPool(_compute_pool);
+    _universal_buffers.clear();
+    _compute_buffers.clear();
+}
+void FrameGraph::RecordPool::reset(Device& device) {
+    device._logical.resetCommandPool(_universal_pool, {});
+    device._logical.resetCommandPool(_compute_pool, {});
+    _universal_n = 0;
+    _compute_n = 0;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+export module renderer.graph;
+import std;
+import vulkan_hpp;
+import vulkan.allocator;
+import core.device;
+import buffers.image;
+import renderer.profiler;
+
+// ordered list of passes declaring how they use images
+// barriers are derived from these declarations and batched per pass boundary,
+// transient images with disjoint lifetimes share memory
+// async passes may be split off into segments for the async compute queue, with ownership transfers between queue families
+export struct FrameGraph {
+    using Resource = uint32_t;
+    enum Usage: uint32_t {
+        eColorAttachment,        // write
+        eDepthStencilAttachment, // read/write
+        eSampled,                // read
+        eStorageRead,            // read
+        eStorageWrite,           // read/write
+    };
+    struct Access {
+        Resource resource;
+        Usage usage;
+    };
+    struct Pass {
+        std::string name;
+        // stage of shader reads/writes, attachments use their fixed function stages
+        vk::PipelineStageFlags2 shader_stage = vk::PipelineStageFlagBits2::eFragmentShader;
+        // compute pass touching graph images only, runs on the async compute queue if the graph was compiled with it
+        bool async = false;
+        std::vector<Access> accesses;
+        std::function<void(vk::CommandBuffer cmd)> record;
+    };
+    struct TransientInfo {
+        vk::Format format;
+        vk::Extent2D extent;
+        vk::ImageUsageFlags usage;
+        vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor;
+    };
+    // consecutive passes recorded into one command buffer and submitted to the same queue
+    struct Segment {
+        bool async;
+        vk::PipelineStageFlags2 wait_stages; // stages accessing images shared with other segments, where waits on their work have to block
+    };
+    // command pools of one recording job for one frame in flight, the job records a contiguous range of passes into secondaries
+    struct RecordPool {
+        void init(Device& device);
+        void destroy(Device& device);
+        // recycle all command buffers, the frame that used them has to be complete
+        void reset(Device& device);
+        // begun secondary command buffer from the pool of the universal or the async compute queue family
+        auto next(Device& device, bool async, const vk::CommandBufferInheritanceInfo& inheritance) -> vk::CommandBuffer;
+        vk::CommandPool _universal_pool;
+        vk::CommandPool _compute_pool;
+        std::vector<vk::CommandBuffer> _universal_buffers;
+        std::vector<vk::CommandBuffer> _compute_buffers;
+        uint32_t _universal_n = 0;
+        uint32_t _compute_n = 0;
+    };
+
+    // image owned elsewhere, may be (re)bound every frame via set_external()
+    auto add_external(Image* image_p = nullptr) -> Resource;
+    // image owned by the graph, contents do not persist across frames
+    auto add_transient(const TransientInfo& info) -> Resource;
+    void add_pass(Pass&& pass);
+    // create transient images, aliasing memory between those with disjoint lifetimes
+    // with async, runs of async passes form their own segments, trailing ones stay on the universal queue
+    void compile(Device& device, bool async = false);
+    // free transient images and clear all passes and resources
+    void destroy(Device& device);
+
+    void set_external(Resource resource, Image& image);
+    auto get(Resource resource) -> Image&;
+    // record all passes with their batched barriers into one command buffer per segment, which are begun but not ended
+    // the segments need to be submitted in order, each waiting for the previous one and the first for the previous frame
+    // passes are wrapped in profiler queries, except for async ones as compute queues lack graphics statistics
+    void execute(std::span<const vk::CommandBuffer> cmds, Profiler& profiler);
+    // same, but passes are recorded into secondary command buffers by jobs, one per pool with a contiguous range of passes each
+    // the primaries only receive barriers, queries and the secondaries in pass order. secondaries do not inherit bound state,
+    // prepare(cmd, async) is invoked on each before its pass to bind descriptors and the like
+    // with the profiler active, pipeline statistics queries span the secondaries, which needs the inheritedQueries feature
+    void execute(Device& device, std::span<const vk::CommandBuffer> cmds, Profiler& profiler, std::span<RecordPool> pools,
+        const std::function<void(vk::CommandBuffer cmd, bool async)>& prepare);
+    auto segments() -> const std::vector<Segment>& { return _segments; }
+
+private:
+    // derive every pass's barriers from the tracked image states, before any recording
+    // releases to other queue families are collected per giving segment, returns of external images into _final_barriers
+    void resolve_barriers();
+    // barriers, queries and either the pass itself or its secondary into the primary of the pass's segment
+    void record_pass(std::span<const vk::CommandBuffer> cmds, Profiler& profiler, uint32_t pass_i, vk::CommandBuffer secondary = nullptr);
+
+    struct Entry {
+        Image* image_p;
+        bool transient;
+        TransientInfo info;
+        uint32_t first_pass;
+        uint32_t last_pass;
+        uint32_t block;
+        bool lazy;
+        uint32_t segment; // of the latest access within the current frame
+    };
+    struct Block {
+        vma::Allocation allocation;
+        vk::MemoryRequirements requirements;
+        std::vector<Resource> occupants;
+        Image* current_p; // occupant that touched the memory last
+        bool lazy;
+        uint32_t segment; // of the latest access to any occupant within the current frame
+    };
+    static constexpr uint32_t no_segment = std::numeric_limits<uint32_t>::max();
+    std::vector<Entry> _entries;
+    std::vector<Pass> _passes;
+    std::vector<Image> _transients;
+    std::vector<Block> _blocks;
+    std::vector<std::vector<vk::ImageMemoryBarrier2>> _pass_barriers; // batched in front of each pass
+    std::vector<std::vector<vk::ImageMemoryBarrier2>> _segment_releases; // after the last pass of each segment
+    std::vector<vk::ImageMemoryBarrier2> _final_barriers;
+    std::vector<vk::CommandBuffer> _secondaries; // per pass while recording in parallel
+    std::vector<Segment> _segments;
+    std::vector<uint32_t> _pass_segments;
+    uint32_t _universal_family;
+    uint32_t _async_family;
+};
\ No newline at end of file
@@ -0,0 +1,67 @@
+module renderer.pacer;
+import core.trace;
+
+void FramePacer::set_target_framerate(uint32_t fps) {
+    Clock::duration period = Clock::duration::zero();
+    if (fps > 0) period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / (double)fps));
+    if (period == _period) return;
+    _period = period;
+    _deadline = Clock::now();
+}
+void FramePacer::wait() {
+    if (_period > Clock::duration::zero()) {
+        Trace::Zone zone("FramePacer::wait");
+        Clock::time_point now = Clock::now();
+        _deadline += _period;
+        // a late frame restarts the schedule instead of rushing the following ones
+        if (_deadline < now) _deadline = now;
+
+        // coarse sleep, then adapt the margin to how far the sleep overshot
+        if (_deadline - now > _spin_margin) {
+            Clock::time_point wake_target = _deadline - _spin_margin;
+            std::this_thread::sleep_until(wake_target);
+            Clock::duration overshoot = Clock::now() - wake_target;
+            Clock::duration margin = std::max(overshoot + overshoot / 2, _spin_margin - _spin_margin / 64);
+            _spin_margin = std::clamp<Clock::duration>(margin, std::chrono::microseconds(200), std::chrono::milliseconds(4));
+        }
+        while (Clock::now() < _deadline) std::this_thread::yield();
+    }
+    _frame_intervals.push(Clock::now());
+}
+void FramePacer::record_present(Clock::time_point time) {
+    _present_intervals.push(time);
+}
+void FramePacer::print_summary() {
+    auto print = [](std::string_view name, Stats stats) {
+        if (stats.samples == 0) return;
+        std::println("{}: {:.3f} ms mean, {:.3f} ms stddev, {:.3f}..{:.3f} ms over {} frames",
+            name, stats.mean_ms, stats.stddev_ms, stats.min_ms, stats.max_ms, stats.samples);
+    };
+    print("frame interval", frame_stats());
+    print("present interval (cpu observed)", present_stats());
+}
+void FramePacer::Intervals::push(Clock::time_point time) {
+    if (_last != Clock::time_point{}) {
+        double ms = std::chrono::duration<double, std::milli>(time - _last).count();
+        if (_samples_ms.size() < window) _samples_ms.push_back(ms);
+        else _samples_ms[_next] = ms;
+        _next = (_next + 1) % window;
+    }
+    _last = time;
+}
+auto FramePacer::get_stats(Intervals& intervals) -> Stats {
+    auto& samples = intervals._samples_ms;
+    if (samples.empty()) return {};
+    double mean = std::accumulate(samples.cbegin(), samples.cend(), 0.0) / (double)samples.size();
+    double variance = 0.0;
+    for (double sample: samples) variance += (sample - mean) * (sample - mean);
+    variance /= (double)samples.size();
+    auto [min, max] = std::minmax_element(samples.cbegin(), samples.cend());
+    return {
+        .mean_ms = mean,
+        .stddev_ms = std::sqrt(variance),
+        .min_ms = *min,
+        .max_ms = *max,
+        .samples = (uint32_t)samples.size(),
+    };
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+export module renderer.pacer;
+import std;
+
+// frames are scheduled against absolute deadlines, so timing errors do not accumulate
+// the bulk of the wait is slept, the remainder is spun to avoid scheduler overshoot
+export struct FramePacer {
+    using Clock = std::chrono::steady_clock;
+    static constexpr uint32_t window = 256; // intervals kept for rolling stats
+    struct Stats {
+        double mean_ms, stddev_ms, min_ms, max_ms;
+        uint32_t samples;
+    };
+
+    // zero disables pacing
+    void set_target_framerate(uint32_t fps);
+    // block until the next frame is due
+    void wait();
+    // CPU-side time at which a frame was observed to be shown, e.g. when a blocking present wait returned
+    void record_present(Clock::time_point time);
+    // a present could not be timed, the next one does not form an interval with the previous
+    void skip_present() { _present_intervals._last = {}; }
+    // intervals between paced frames and between observed presents, the latter include wake-up latency
+    auto frame_stats() -> Stats { return get_stats(_frame_intervals); }
+    auto present_stats() -> Stats { return get_stats(_present_intervals); }
+    void print_summary();
+
+private:
+    struct Intervals {
+        std::vector<double> _samples_ms; // ring buffer
+        uint32_t _next = 0;
+        Clock::time_point _last;
+        void push(Clock::time_point time);
+    };
+    static auto get_stats(Intervals& intervals) -> Stats;
+
+    Clock::duration _period = Clock::duration::zero();
+    Clock::time_point _deadline;
+    // margin left for spinning, follows the observed sleep overshoot
+    Clock::duration _spin_margin = std::chrono::microseconds(1500);
+    Intervals _frame_intervals;
+    Intervals _present_intervals;
+};
\ No newline at end of file
@@ -5,31 +5,33 @@ import core.device;
 import buffers.mesh;
 import buffers.image;
 import buffers.device;
+import renderer.bindless;
 
 export struct PipelineBase {
-    typedef std::vector<std::tuple<uint32_t /*set*/, uint32_t /*binding*/, vk::SamplerCreateInfo>> SamplerInfos;
     void destroy(Device& device);
-    void write_descriptor(Device& device, uint32_t set, uint32_t binding, Image& image, vk::DescriptorType type, vk::Sampler sampler = nullptr);
-    void write_descriptor(Device& device, uint32_t set, uint32_t binding, DeviceBuffer& buffer, vk::DescriptorType type, size_t offset = 0);
+    // push resource indices and other small parameters, shared across all stages
+    template<typename T>
+    void push(vk::CommandBuffer cmd, const T& data) {
+        static_assert(sizeof(T) <= Bindless::push_constant_size, "push constants exceed guaranteed size");
+        cmd.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eAll, 0, (uint32_t)sizeof(T), &data);
+    }
     
 protected:
-    auto reflect(vk::Device device, const vk::ArrayProxy<std::string_view>& shaderPaths, const SamplerInfos& sampler_infos)
+    // vertex input of the shaders, throws std::runtime_error if they bind anything outside of the bindless set
+    auto reflect(const vk::ArrayProxy<std::string_view>& shaderPaths)
     -> std::pair<vk::VertexInputBindingDescription, std::vector<vk::VertexInputAttributeDescription>>;
 
 protected:
     vk::Pipeline _pipeline;
-    vk::PipelineLayout _pipeline_layout;
-    vk::DescriptorPool _pool;
-    std::vector<vk::DescriptorSet> _desc_sets;
-    std::vector<vk::DescriptorSetLayout> _desc_set_layouts;
-    std::vector<vk::Sampler> _immutable_samplers;
+    vk::PipelineLayout _pipeline_layout; // owned by Bindless
 };
 
 export struct Compute: public PipelineBase {
 	struct CreateInfo {
 		const Device& device;
+		const Bindless& bindless;
 		std::string_view cs_path; vk::SpecializationInfo spec_info = {};
-		SamplerInfos sampler_infos = {};
+		vk::PipelineCache cache = nullptr;
 	};
 	void init(const CreateInfo& info);
 	void execute(vk::CommandBuffer cmd, uint32_t nx, uint32_t ny, uint32_t nz);
@@ -38,6 +40,7 @@ export struct Compute: public PipelineBase {
 export struct Graphics: public PipelineBase {
 	struct CreateInfo {
 		const Device& device;
+		const Bindless& bindless;
 		vk::Extent2D extent;
 		//
 		std::string_view vs_path; vk::SpecializationInfo vs_spec = {};
@@ -60,15 +63,17 @@ export struct Graphics: public PipelineBase {
 		} stencil = {};
 		//
 		vk::ArrayProxy<vk::DynamicState> dynamic_states = {};
-		// TODO: deprecate this one
-		SamplerInfos sampler_infos = {};
+		vk::PipelineCache cache = nullptr;
 	};
 
 	void init(const CreateInfo& info);
+	// restrict rendering to a sub-rectangle, applied through dynamic viewport/scissor if the pipeline declared them
+	void set_render_area(vk::Extent2D extent) { _render_area.extent = extent; }
+	// attachments are expected in their attachment optimal layouts, the frame graph transitions them before the pass is recorded
 	// draw fullscreen triangle with color and depth attachments
 	void execute(vk::CommandBuffer cmd,
 			Image& color, vk::AttachmentLoadOp color_load,
-			DepthStencil& depth_stencil, vk::AttachmentLoadOp depth_stencil_load);
+			Image& depth_stencil, vk::AttachmentLoadOp depth_stencil_load);
 	// draw fullscreen  triangle with only color attachment
 	void execute(vk::CommandBuffer cmd, Image& color_dst, vk::AttachmentLoadOp color_load);
 
@@ -76,11 +81,11 @@ export struct Graphics: public PipelineBase {
 	template<typename Vertex, typename Index>
 	void execute(vk::CommandBuffer cmd,
 			Image& color, vk::AttachmentLoadOp color_load,
-			DepthStencil& depth_stencil, vk::AttachmentLoadOp depth_stencil_load,
+			Image& depth_stencil, vk::AttachmentLoadOp depth_stencil_load,
 			Mesh<Vertex, Index>& mesh) {
 		vk::RenderingAttachmentInfo info_color {
 			.imageView = color._view,
-			.imageLayout = color._last_layout,
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 			.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 			.loadOp = color_load,
 			.storeOp = vk::AttachmentStoreOp::eStore,
@@ -88,7 +93,7 @@ export struct Graphics: public PipelineBase {
 		};
 		vk::RenderingAttachmentInfo info_depth_stencil {
 			.imageView = depth_stencil._view,
-			.imageLayout = depth_stencil._last_layout,
+			.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
 			.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 			.loadOp = depth_stencil_load,
 			.storeOp = vk::AttachmentStoreOp::eStore,
@@ -104,9 +109,7 @@ export struct Graphics: public PipelineBase {
 		};
 		cmd.beginRendering(info_render);
 		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
-		if (_desc_sets.size() > 0) {
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, _desc_sets, {});
-		}
+		set_dynamic_area(cmd);
 		// draw beg //
 		if (mesh._indices._count > 0) {
 			cmd.bindVertexBuffers(0, mesh._vertices._buffer._data, { 0 });
@@ -120,6 +123,48 @@ export struct Graphics: public PipelineBase {
 		// draw end //
 		cmd.endRendering();
 	}
+	// draw mesh with parameters written on the GPU, up to max_draw_count commands as given by the count buffer
+	template<typename Vertex, typename Index>
+	void execute(vk::CommandBuffer cmd,
+			Image& color, vk::AttachmentLoadOp color_load,
+			Image& depth_stencil, vk::AttachmentLoadOp depth_stencil_load,
+			Mesh<Vertex, Index>& mesh, DeviceBuffer& commands, DeviceBuffer& count, uint32_t max_draw_count) {
+		vk::RenderingAttachmentInfo info_color {
+			.imageView = color._view,
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+			.resolveMode = 	vk::ResolveModeFlagBits::eNone,
+			.loadOp = color_load,
+			.storeOp = vk::AttachmentStoreOp::eStore,
+			.clearValue { .color { std::array<float, 4>{ 0, 0, 0, 0 } } }
+		};
+		vk::RenderingAttachmentInfo info_depth_stencil {
+			.imageView = depth_stencil._view,
+			.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+			.resolveMode = 	vk::ResolveModeFlagBits::eNone,
+			.loadOp = depth_stencil_load,
+			.storeOp = vk::AttachmentStoreOp::eStore,
+			.clearValue = { .depthStencil { .depth = 1.0f, .stencil = 0 } },
+		};
+		vk::RenderingInfo info_render {
+			.renderArea = _render_area,
+			.layerCount = 1,
+			.colorAttachmentCount = 1,
+			.pColorAttachments = &info_color,
+			.pDepthAttachment = _depth_enabled ? &info_depth_stencil : nullptr,
+			.pStencilAttachment = _stencil_enabled ? &info_depth_stencil : nullptr,
+		};
+		cmd.beginRendering(info_render);
+		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
+		set_dynamic_area(cmd);
+		// draw beg //
+		if (max_draw_count > 0) {
+			cmd.bindVertexBuffers(0, mesh._vertices._buffer._data, { 0 });
+			cmd.bindIndexBuffer(mesh._indices._buffer._data, 0, mesh._indices.get_type());
+			cmd.drawIndexedIndirectCount(commands._data, 0, count._data, 0, max_draw_count, sizeof(vk::DrawIndexedIndirectCommand));
+		}
+		// draw end //
+		cmd.endRendering();
+	}
 	// draw mesh without depth attachment
 	template<typename Vertex, typename Index>
 	void execute(vk::CommandBuffer cmd,
@@ -127,7 +172,7 @@ export struct Graphics: public PipelineBase {
 			Mesh<Vertex, Index>& mesh) {
 		vk::RenderingAttachmentInfo info_color_attach {
 			.imageView = color_dst._view,
-			.imageLayout = color_dst._last_layout,
+			.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 			.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 			.loadOp = color_load,
 			.storeOp = vk::AttachmentStoreOp::eStore,
@@ -143,9 +188,7 @@ export struct Graphics: public PipelineBase {
 		};
 		cmd.beginRendering(info_render);
 		cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
-		if (_desc_sets.size() > 0) {
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, _desc_sets, {});
-		}
+		set_dynamic_area(cmd);
 		// draw beg //
 		if (mesh._indices._count > 0) {
 			cmd.bindVertexBuffers(0, mesh._vertices._buffer._data, { 0 });
@@ -160,8 +203,47 @@ export struct Graphics: public PipelineBase {
 		cmd.endRendering();
 	}
 
+private:
+	void set_dynamic_area(vk::CommandBuffer cmd) {
+		if (_dynamic_viewport) {
+			cmd.setViewport(0, vk::Viewport {
+				.x = 0, .y = 0,
+				.width = (float)_render_area.extent.width,
+				.height = (float)_render_area.extent.height,
+				.minDepth = 0.0,
+				.maxDepth = 1.0,
+			});
+		}
+		if (_dynamic_scissor) cmd.setScissor(0, _render_area);
+	}
+
 private:
 	vk::Rect2D _render_area;
 	bool _depth_enabled;
 	bool _stencil_enabled;
+	bool _dynamic_viewport;
+	bool _dynamic_scissor;
+};
+
+// pipeline variants keyed by their shaders, specialization constants and fixed state
+export struct PipelineCache {
+	void init(Device& device);
+	void destroy(Device& device);
+	// get existing variant or build it on first use
+	auto get(const Compute::CreateInfo& info) -> Compute&;
+	auto get(const Graphics::CreateInfo& info) -> Graphics&;
+	// variants requested after mark() survive the next evict()
+	void mark();
+	// destroy variants not requested since mark(), none of them may be in use by the gpu
+	void evict(Device& device);
+
+	vk::PipelineCache _cache;
+private:
+	template<typename T> struct Entry {
+		T pipeline;
+		uint64_t generation;
+	};
+	std::unordered_map<std::string, Entry<Compute>> _compute;
+	std::unordered_map<std::string, Entry<Graphics>> _graphics;
+	uint64_t _generation = 0;
 };
\ No newline at end of file
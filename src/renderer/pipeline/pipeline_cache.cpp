@@ -0,0 +1,77 @@
+module renderer.pipeline;
+import vulkan_hpp;
+import core.device;
+
+template<typename T>
+void append_bytes(std::string& key, const T& value) {
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+void append_spec(std::string& key, std::string_view path, const vk::SpecializationInfo& spec) {
+	key.append(path);
+	key.push_back('\0');
+	for (uint32_t i = 0; i < spec.mapEntryCount; i++) {
+		append_bytes(key, spec.pMapEntries[i].constantID);
+		auto* data_p = static_cast<const char*>(spec.pData) + spec.pMapEntries[i].offset;
+		key.append(data_p, spec.pMapEntries[i].size);
+	}
+}
+
+void PipelineCache::init(Device& device) {
+	// driver-side cache shares compiled state between otherwise distinct variants
+	_cache = device._logical.createPipelineCache({});
+}
+void PipelineCache::destroy(Device& device) {
+	for (auto& [_, entry]: _compute) entry.pipeline.destroy(device);
+	for (auto& [_, entry]: _graphics) entry.pipeline.destroy(device);
+	_compute.clear();
+	_graphics.clear();
+	device._logical.destroyPipelineCache(_cache);
+}
+auto PipelineCache::get(const Compute::CreateInfo& info) -> Compute& {
+	std::string key;
+	append_spec(key, info.cs_path, info.spec_info);
+	auto [it, inserted] = _compute.try_emplace(key);
+	if (inserted) {
+		Compute::CreateInfo info_cached = info;
+		info_cached.cache = _cache;
+		it->second.pipeline.init(info_cached);
+	}
+	it->second.generation = _generation;
+	return it->second.pipeline;
+}
+auto PipelineCache::get(const Graphics::CreateInfo& info) -> Graphics& {
+	std::string key;
+	append_spec(key, info.vs_path, info.vs_spec);
+	append_spec(key, info.fs_path, info.fs_spec);
+	// fixed function state baked into the pipeline
+	append_bytes(key, info.extent);
+	for (auto format: info.color.formats) append_bytes(key, format);
+	append_bytes(key, info.color.blend);
+	append_bytes(key, info.depth);
+	append_bytes(key, info.stencil);
+	for (auto state: info.dynamic_states) append_bytes(key, state);
+	auto [it, inserted] = _graphics.try_emplace(key);
+	if (inserted) {
+		Graphics::CreateInfo info_cached = info;
+		info_cached.cache = _cache;
+		it->second.pipeline.init(info_cached);
+	}
+	it->second.generation = _generation;
+	return it->second.pipeline;
+}
+void PipelineCache::mark() {
+	_generation++;
+}
+void PipelineCache::evict(Device& device) {
+	// extent-dependent variants of previous window sizes would otherwise pile up
+	std::erase_if(_compute, [&](auto& pair) {
+		if (pair.second.generation == _generation) return false;
+		pair.second.pipeline.destroy(device);
+		return true;
+	});
+	std::erase_if(_graphics, [&](auto& pair) {
+		if (pair.second.generation == _generation) return false;
+		pair.second.pipeline.destroy(device);
+		return true;
+	});
+}
\ No newline at end of file
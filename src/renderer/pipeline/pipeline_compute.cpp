@@ -4,13 +4,10 @@ module renderer.pipeline;
 
 void Compute::init(const CreateInfo& info) {
 	// reflect shader contents
-	reflect(info.device._logical, info.cs_path, info.sampler_infos);
+	reflect(info.cs_path);
 
-	// create pipeline layout
-	_pipeline_layout = info.device._logical.createPipelineLayout({
-		.setLayoutCount = (uint32_t)_desc_set_layouts.size(),
-		.pSetLayouts = _desc_set_layouts.data(),
-	});
+	// use the global bindless pipeline layout
+	_pipeline_layout = info.bindless._pipeline_layout;
 
 	// create pipeline
 	auto [cs_code, cs_size] = spvrc::load(info.cs_path);
@@ -29,16 +26,12 @@ void Compute::init(const CreateInfo& info) {
 		},
 		.layout = _pipeline_layout,
 	};
-	auto [result, pipeline] = info.device._logical.createComputePipeline(nullptr, info_compute_pipe);
+	auto [result, pipeline] = info.device._logical.createComputePipeline(info.cache, info_compute_pipe);
 	if (result != vk::Result::eSuccess) std::println("error creating compute pipeline");
 	_pipeline = pipeline;
 	info.device._logical.destroyShaderModule(cs_module);
-
-
-	// PFN_vkCreateInstance asd;
 }
 void Compute::execute(vk::CommandBuffer cmd, uint32_t nx, uint32_t ny, uint32_t nz) {
 	cmd.bindPipeline(vk::PipelineBindPoint::eCompute, _pipeline);
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, _pipeline_layout, 0, _desc_sets, {});
 	cmd.dispatch(nx, ny, nz);
 }
\ No newline at end of file
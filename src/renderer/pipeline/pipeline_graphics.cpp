@@ -4,14 +4,10 @@ module renderer.pipeline;
 
 void Graphics::init(const CreateInfo& info) {
 	// reflect shader contents
-	auto [bind_desc, attr_descs] = reflect(info.device._logical, { info.vs_path, info.fs_path }, info.sampler_infos);
+	auto [bind_desc, attr_descs] = reflect({ info.vs_path, info.fs_path });
 
-	// create pipeline layout
-	vk::PipelineLayoutCreateInfo layoutInfo {
-		.setLayoutCount = (uint32_t)_desc_set_layouts.size(),
-		.pSetLayouts = _desc_set_layouts.data()
-	};
-	_pipeline_layout = info.device._logical.createPipelineLayout(layoutInfo);
+	// use the global bindless pipeline layout
+	_pipeline_layout = info.bindless._pipeline_layout;
 
 	// create shader stages
 	auto [vs_code, vs_size] = spvrc::load(info.vs_path);
@@ -143,20 +139,25 @@ void Graphics::init(const CreateInfo& info) {
 		.layout = _pipeline_layout,
 	};
 
-	auto [result, pipeline] = info.device._logical.createGraphicsPipeline(nullptr, pipeInfo);
+	auto [result, pipeline] = info.device._logical.createGraphicsPipeline(info.cache, pipeInfo);
 	if (result != vk::Result::eSuccess) std::println("error creating graphics pipeline");
 	_pipeline = pipeline;
 	// set persistent options
 	_render_area = vk::Rect2D({ 0,0 }, info.extent);
 	_depth_enabled = info.depth.test || info.depth.write;
 	_stencil_enabled = info.stencil.test;
+	auto dynamic = [&](vk::DynamicState state) {
+		return std::find(info.dynamic_states.begin(), info.dynamic_states.end(), state) != info.dynamic_states.end();
+	};
+	_dynamic_viewport = dynamic(vk::DynamicState::eViewport);
+	_dynamic_scissor = dynamic(vk::DynamicState::eScissor);
 	info.device._logical.destroyShaderModule(vs_module);
 	info.device._logical.destroyShaderModule(fs_module);
 }
-void Graphics::execute(vk::CommandBuffer cmd, Image& color, vk::AttachmentLoadOp color_load, DepthStencil& depth_stencil, vk::AttachmentLoadOp depth_stencil_load) {
+void Graphics::execute(vk::CommandBuffer cmd, Image& color, vk::AttachmentLoadOp color_load, Image& depth_stencil, vk::AttachmentLoadOp depth_stencil_load) {
 	vk::RenderingAttachmentInfo info_color {
 		.imageView = color._view,
-		.imageLayout = color._last_layout,
+		.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 		.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 		.loadOp = color_load,
 		.storeOp = vk::AttachmentStoreOp::eStore,
@@ -164,7 +165,7 @@ void Graphics::execute(vk::CommandBuffer cmd, Image& color, vk::AttachmentLoadOp
 	};
 	vk::RenderingAttachmentInfo info_depth_stencil {
 		.imageView = depth_stencil._view,
-		.imageLayout = depth_stencil._last_layout,
+		.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
 		.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 		.loadOp = depth_stencil_load,
 		.storeOp = vk::AttachmentStoreOp::eStore,
@@ -177,19 +178,17 @@ void Graphics::execute(vk::CommandBuffer cmd, Image& color, vk::AttachmentLoadOp
 		.pColorAttachments = &info_color,
 		.pDepthAttachment = _depth_enabled ? &info_depth_stencil : nullptr,
 		.pStencilAttachment = _stencil_enabled ? &info_depth_stencil : nullptr,
-};
-cmd.beginRendering(info_render);
-cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
-if (_desc_sets.size() > 0) {
-	cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, _desc_sets, {});
-}
-cmd.draw(3, 1, 0, 0);
-cmd.endRendering();
+	};
+	cmd.beginRendering(info_render);
+	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
+	set_dynamic_area(cmd);
+	cmd.draw(3, 1, 0, 0);
+	cmd.endRendering();
 }
 void Graphics::execute(vk::CommandBuffer cmd, Image& color_dst, vk::AttachmentLoadOp color_load) {
 	vk::RenderingAttachmentInfo info_color_attach {
 		.imageView = color_dst._view,
-		.imageLayout = color_dst._last_layout,
+		.imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
 		.resolveMode = 	vk::ResolveModeFlagBits::eNone,
 		.loadOp = color_load,
 		.storeOp = vk::AttachmentStoreOp::eStore,
@@ -205,9 +204,7 @@ void Graphics::execute(vk::CommandBuffer cmd, Image& color_dst, vk::AttachmentLo
 	};
 	cmd.beginRendering(info_render);
 	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, _pipeline);
-	if (_desc_sets.size() > 0) {
-		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, _desc_sets, {});
-	}
+	set_dynamic_area(cmd);
 	cmd.draw(3, 1, 0, 0);
 	cmd.endRendering();
 }
\ No newline at end of file
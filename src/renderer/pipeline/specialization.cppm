@@ -0,0 +1,40 @@
+export module renderer.specialization;
+import std;
+import vulkan_hpp;
+
+// convertible to any scalar, used to probe the member count of aggregates
+struct AnyScalar {
+    template<typename T> constexpr operator T() const noexcept;
+};
+template<typename T, typename... Members>
+consteval auto member_count() -> uint32_t {
+    if constexpr (requires { T{ Members{}..., AnyScalar{} }; }) return member_count<T, Members..., AnyScalar>();
+    else return sizeof...(Members);
+}
+
+// specialization constants derived from a plain struct of 4 byte scalars
+// each member (or array element) maps to the constant_id matching its declaration order
+export template<typename T>
+struct Specialization {
+    static_assert(std::is_aggregate_v<T> && std::is_trivially_copyable_v<T>, "specialization data must be a plain struct");
+    static constexpr uint32_t count = member_count<T>();
+    static_assert(count * 4 == sizeof(T), "specialization members must be tightly packed 4 byte scalars (use vk::Bool32 over bool)");
+    static constexpr auto entries = []() {
+        std::array<vk::SpecializationMapEntry, count> entries;
+        for (uint32_t i = 0; i < count; i++) {
+            entries[i] = { .constantID = i, .offset = i * 4, .size = 4 };
+        }
+        return entries;
+    }();
+
+    // data needs to outlive the returned info
+    auto info() const -> vk::SpecializationInfo {
+        return {
+            .mapEntryCount = count,
+            .pMapEntries = entries.data(),
+            .dataSize = sizeof(T),
+            .pData = &_data,
+        };
+    }
+    T _data;
+};
\ No newline at end of file
@@ -0,0 +1,154 @@
+module renderer.profiler;
+
+void Profiler::init(Device& device, uint32_t frame_count) {
+    auto families = device._physical.getQueueFamilyProperties();
+    auto get_mask = [](uint32_t valid_bits) {
+        return valid_bits >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << valid_bits) - 1;
+    };
+    _supported = families[device._universal_i].timestampValidBits > 0;
+    _compute_supported = families[device._compute_i].timestampValidBits > 0;
+    _timestamp_mask = get_mask(families[device._universal_i].timestampValidBits);
+    _compute_timestamp_mask = get_mask(families[device._compute_i].timestampValidBits);
+    _timestamp_period = device._physical.getProperties().limits.timestampPeriod;
+    _statistics_supported = device._features.pipelineStatisticsQuery;
+    _slots.resize(frame_count);
+    for (auto& slot: _slots) {
+        slot._timestamps = device._logical.createQueryPool({
+            .queryType = vk::QueryType::eTimestamp,
+            .queryCount = 2 * max_passes,
+        });
+        if (_statistics_supported) slot._statistics = device._logical.createQueryPool({
+            .queryType = vk::QueryType::ePipelineStatistics,
+            .queryCount = max_passes,
+            .pipelineStatistics = statistic_flags,
+        });
+        slot._written = false;
+    }
+}
+void Profiler::destroy(Device& device) {
+    for (auto& slot: _slots) {
+        device._logical.destroyQueryPool(slot._timestamps);
+        if (slot._statistics) device._logical.destroyQueryPool(slot._statistics);
+    }
+    _slots.clear();
+}
+void Profiler::begin_frame(Device& device, vk::CommandBuffer cmd, uint32_t frame_i) {
+    Slot& slot = _slots[frame_i];
+    if (slot._written) read_back(device, slot);
+    slot._passes.clear();
+    slot._statistics_count = 0;
+    slot._written = _supported;
+    slot._profiled = _enabled && _supported;
+    slot._queried = active();
+    _slot_p = &slot;
+    if (!_supported) return;
+    cmd.resetQueryPool(slot._timestamps, 0, 2 * max_passes);
+    if (_statistics_supported) cmd.resetQueryPool(slot._statistics, 0, max_passes);
+}
+void Profiler::begin_pass(vk::CommandBuffer cmd, std::string_view name, bool async) {
+    _pass_open = _supported && (!async || _compute_supported) && _slot_p->_passes.size() < max_passes;
+    if (!_pass_open) return;
+    uint32_t pass_i = (uint32_t)_slot_p->_passes.size();
+    // statistics queries stay contiguous, so they are read back in one go
+    uint32_t statistics_i = _slot_p->_queried && !async ? _slot_p->_statistics_count++ : no_statistics;
+    _slot_p->_passes.push_back({ ._entry = get_entry(name), ._statistics_i = statistics_i, ._async = async });
+    cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, _slot_p->_timestamps, 2 * pass_i);
+    if (statistics_i != no_statistics) cmd.beginQuery(_slot_p->_statistics, statistics_i, {});
+}
+void Profiler::end_pass(vk::CommandBuffer cmd) {
+    // passes past max_passes were skipped by begin_pass, the last recorded one is closed already
+    if (!_pass_open) return;
+    _pass_open = false;
+    uint32_t pass_i = (uint32_t)_slot_p->_passes.size() - 1;
+    uint32_t statistics_i = _slot_p->_passes[pass_i]._statistics_i;
+    if (statistics_i != no_statistics) cmd.endQuery(_slot_p->_statistics, statistics_i);
+    cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, _slot_p->_timestamps, 2 * pass_i + 1);
+}
+auto Profiler::stats(std::string_view name) -> Stats {
+    Stats stats = {};
+    auto it = std::find_if(_entries.cbegin(), _entries.cend(), [&](const Entry& entry) { return entry._name == name; });
+    if (it == _entries.cend() || it->_samples_ms.empty()) return stats;
+
+    std::vector<double> sorted = it->_samples_ms;
+    std::sort(sorted.begin(), sorted.end());
+    stats.samples = (uint32_t)sorted.size();
+    stats.min_ms = sorted.front();
+    stats.avg_ms = std::accumulate(sorted.cbegin(), sorted.cend(), 0.0) / (double)sorted.size();
+    stats.p99_ms = sorted[std::min((size_t)((double)sorted.size() * 0.99), sorted.size() - 1)];
+    for (auto& sample: it->_samples_stats) {
+        for (uint32_t i = 0; i < statistic_count; i++) stats.statistics[i] += (double)sample[i];
+    }
+    for (auto& statistic: stats.statistics) statistic /= (double)it->_samples_stats.size();
+    return stats;
+}
+void Profiler::print_summary() {
+    std::println("{:<16} {:>9} {:>9} {:>9} {:>12} {:>12} {:>12}", "pass", "min ms", "avg ms", "p99 ms", "primitives", "vertices", "fragments");
+    for (auto& entry: _entries) {
+        Stats s = stats(entry._name);
+        std::println("{:<16} {:>9.3f} {:>9.3f} {:>9.3f} {:>12.0f} {:>12.0f} {:>12.0f}",
+            entry._name, s.min_ms, s.avg_ms, s.p99_ms, s.statistics[0], s.statistics[1], s.statistics[3]);
+    }
+    std::println("frame: {:.3f} ms", _frame_ms);
+}
+void Profiler::write_csv(const std::filesystem::path& path) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::println("Failed to write profile to {}", path.string());
+        return;
+    }
+    file << "pass,samples,min_ms,avg_ms,p99_ms,input_primitives,vertex_invocations,clipping_primitives,fragment_invocations,compute_invocations\n";
+    for (auto& entry: _entries) {
+        Stats s = stats(entry._name);
+        file << std::format("{},{},{},{},{},{},{},{},{},{}\n", entry._name, s.samples, s.min_ms, s.avg_ms, s.p99_ms,
+            s.statistics[0], s.statistics[1], s.statistics[2], s.statistics[3], s.statistics[4]);
+    }
+    std::println("Profile written to {}", path.string());
+}
+auto Profiler::get_entry(std::string_view name) -> uint32_t {
+    for (uint32_t i = 0; i < _entries.size(); i++) {
+        if (_entries[i]._name == name) return i;
+    }
+    _entries.push_back({ ._name = std::string(name) });
+    return (uint32_t)_entries.size() - 1;
+}
+void Profiler::read_back(Device& device, Slot& slot) {
+    // all pass timestamps in one go, the slot's frame has completed so nothing is waited on
+    if (slot._passes.empty()) return;
+    uint32_t timestamp_count = 2 * (uint32_t)slot._passes.size();
+    auto [result, stamps] = device._logical.getQueryPoolResults<uint64_t>(slot._timestamps,
+        0, timestamp_count, timestamp_count * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) return;
+    auto to_ms = [&](uint32_t pass_i) {
+        uint64_t mask = slot._passes[pass_i]._async ? _compute_timestamp_mask : _timestamp_mask;
+        return (double)((stamps[2 * pass_i + 1] - stamps[2 * pass_i]) & mask) * _timestamp_period / 1'000'000.0;
+    };
+    // a single begin/end pair around the frame would include the stall on the acquire semaphore before color output
+    // passes on the async compute queue are summed as well, even though they may overlap with others
+    _frame_ms = 0.0;
+    for (uint32_t pass_i = 0; pass_i < slot._passes.size(); pass_i++) _frame_ms += to_ms(pass_i);
+    if (!slot._profiled) return;
+
+    // without the pipelineStatisticsQuery feature only timings are collected
+    std::vector<std::array<uint64_t, statistic_count>> statistics(slot._statistics_count);
+    if (slot._statistics_count > 0) {
+        result = device._logical.getQueryPoolResults(slot._statistics, 0, slot._statistics_count,
+            statistics.size() * sizeof(statistics[0]), statistics.data(), sizeof(statistics[0]), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) return;
+    }
+    for (uint32_t pass_i = 0; pass_i < slot._passes.size(); pass_i++) {
+        const Record& record = slot._passes[pass_i];
+        Entry& entry = _entries[record._entry];
+        double ms = to_ms(pass_i);
+        std::array<uint64_t, statistic_count> pass_statistics {};
+        if (record._statistics_i != no_statistics) pass_statistics = statistics[record._statistics_i];
+        if (entry._samples_ms.size() < window) {
+            entry._samples_ms.push_back(ms);
+            entry._samples_stats.push_back(pass_statistics);
+        }
+        else {
+            entry._samples_ms[entry._next] = ms;
+            entry._samples_stats[entry._next] = pass_statistics;
+        }
+        entry._next = (entry._next + 1) % window;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+export module renderer.profiler;
+import std;
+import vulkan_hpp;
+import core.device;
+
+// GPU timestamps and pipeline statistics around named passes
+// every frame slot owns its query pools, results are read once the slot comes around again
+// pass timestamps are always written for the frame time, statistics and per-pass stats only while enabled
+export struct Profiler {
+    static constexpr uint32_t max_passes = 32;
+    static constexpr uint32_t window = 256; // samples kept per pass for rolling stats
+    static constexpr vk::QueryPipelineStatisticFlags statistic_flags =
+        vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+        vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+        vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+        vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+    static constexpr uint32_t statistic_count = 5;
+    struct Stats {
+        double min_ms, avg_ms, p99_ms;
+        std::array<double, statistic_count> statistics; // averaged over the window
+        uint32_t samples;
+    };
+
+    void init(Device& device, uint32_t frame_count);
+    void destroy(Device& device);
+    // read back results of the frame that last used this slot, it must have completed
+    // then reset the slot's queries
+    void begin_frame(Device& device, vk::CommandBuffer cmd, uint32_t frame_i);
+    // wrap a pass, statistics are only queried while enabled
+    // async passes on the compute queue are only timed, statistics queries need a graphics queue
+    void begin_pass(vk::CommandBuffer cmd, std::string_view name, bool async = false);
+    void end_pass(vk::CommandBuffer cmd);
+
+    // passes are actually wrapped in pipeline statistics queries
+    auto active() -> bool { return _enabled && _supported && _statistics_supported; }
+    // GPU time of the latest completed frame, summed over its passes
+    // idle time such as waiting on the acquired swapchain image is left out
+    auto frame_ms() -> double { return _frame_ms; }
+    auto stats(std::string_view name) -> Stats;
+    // print min/avg/p99 of all passes to the console
+    void print_summary();
+    void write_csv(const std::filesystem::path& path);
+
+    bool _enabled = false;
+
+private:
+    static constexpr uint32_t no_statistics = std::numeric_limits<uint32_t>::max();
+    struct Record {
+        uint32_t _entry;
+        uint32_t _statistics_i; // no_statistics unless the pass was queried
+        bool _async;
+    };
+    struct Slot {
+        vk::QueryPool _timestamps; // begin/end per pass
+        vk::QueryPool _statistics; // one per queried pass, null without the pipelineStatisticsQuery feature
+        std::vector<Record> _passes; // recorded in this slot, in order
+        uint32_t _statistics_count = 0; // queries begun, async passes have none
+        bool _written = false;
+        bool _profiled = false; // pass stats are collected
+        bool _queried = false; // pipeline statistics were queried
+    };
+    struct Entry {
+        std::string _name;
+        std::vector<double> _samples_ms; // ring buffer
+        std::vector<std::array<uint64_t, statistic_count>> _samples_stats;
+        uint32_t _next = 0;
+    };
+    auto get_entry(std::string_view name) -> uint32_t;
+    void read_back(Device& device, Slot& slot);
+
+    std::vector<Slot> _slots;
+    std::vector<Entry> _entries;
+    Slot* _slot_p = nullptr; // slot being recorded
+    double _timestamp_period; // nanoseconds per tick
+    uint64_t _timestamp_mask;
+    uint64_t _compute_timestamp_mask; // queue families may differ in valid bits
+    bool _supported;
+    bool _compute_supported; // the async compute queue writes timestamps
+    bool _statistics_supported;
+    bool _pass_open = false; // begin_pass wrote queries that end_pass has to close
+    double _frame_ms = 0.0;
+};
\ No newline at end of file
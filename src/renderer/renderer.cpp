@@ -1,70 +1,302 @@
 module renderer.renderer;
+import core.trace;
+import core.jobs;
+import scene.instances;
+import scene.pointcloud;
 
-void Renderer::init(Device& device, Scene& scene, vk::Extent2D extent, bool srgb_output) {
-    // allocate single command pool and buffer pair
-    _command_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._universal_i });
-    vk::CommandBufferAllocateInfo bufferInfo {
-        .commandPool = _command_pool,
-        .level = vk::CommandBufferLevel::ePrimary,
-        .commandBufferCount = 1,
-    };
-    _command_buffer = device._logical.allocateCommandBuffers(bufferInfo).front();
-
+void Renderer::init(Device& device, Scene& scene, Swapchain& swapchain, uint32_t frame_count) {
     // create timeline semaphore
     _synchronization.init(device);
+    _bindless.init(device);
+
+    // allocate command pools per frame, alongside the frame's descriptors
+    // recording jobs get pools of their own, as a pool may only be used by one thread at a time
+    _frames.resize(frame_count);
+    _frame_i = 0;
+    uint32_t record_jobs = std::min(Jobs::get().worker_count() + 1, max_record_jobs);
+    for (uint32_t i = 0; i < frame_count; i++) {
+        Frame& frame = _frames[i];
+        frame._command_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._universal_i });
+        frame._compute_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._compute_i });
+        frame._record_pools.resize(record_jobs);
+        for (auto& pool: frame._record_pools) pool.init(device);
+        frame._camera_i = _bindless.register_buffer(scene._camera._buffers[i]);
+        frame._timeline_value = 0;
+    }
+    _profiler.init(device, frame_count);
+    _pipelines.init(device);
+    _points_supported = device._features.shaderInt64 && device._vk12_features.shaderBufferInt64Atomics;
+    if (!_points_supported && scene._points._uploaded) std::println("Point cloud rendering requires 64-bit buffer atomics, skipping points");
+    _vbuffer_supported = device._features.geometryShader;
+    _inherited_queries = device._features.inheritedQueries;
+    _async_supported = device._compute_queue != device._universal_queue;
+    bool final_queue = device._graphics_i == device._universal_i && device._graphics_queue != device._universal_queue;
+    _final_queue = final_queue ? device._graphics_queue : device._universal_queue;
     
-    // create images and pipelines
-    init_images(device, extent);
-    init_pipelines(device, extent, scene, srgb_output);
-    _smaa.init(device, extent, _color, _depth_stencil);
+    // create images, pipelines and the frame graph, rendering at swapchain resolution as the final pass writes into it
+    _smaa.init(device, _bindless);
+    init_images(device, swapchain._extent);
+    init_pipelines(device, swapchain);
+    init_graph(device, swapchain._extent);
+    _bindless.flush(device);
 }
 void Renderer::destroy(Device& device) {
-    _smaa.destroy(device);
-    // destroy images
-    _color.destroy(device);
-    _storage.destroy(device);
-    _depth_stencil.destroy(device);
-    // destroy pipelines
-    _pipe_default.destroy(device);
-    _pipe_tone.destroy(device);
-    // destroy command pools
-    device._logical.destroyCommandPool(_command_pool);
+    _smaa.destroy(device, _bindless);
+    release_graph_targets();
+    _graph.destroy(device);
+    destroy_images(device);
+    _pipelines.destroy(device);
+    // destroy per-frame command pools, buffers and descriptors
+    for (auto& frame: _frames) {
+        _bindless.release(Bindless::eStorageBuffer, frame._camera_i);
+        if (frame._draw_capacity > 0) {
+            frame._draws_early.destroy(device, _bindless);
+            frame._draws_late.destroy(device, _bindless);
+        }
+        device._logical.destroyCommandPool(frame._command_pool);
+        device._logical.destroyCommandPool(frame._compute_pool);
+        for (auto& pool: frame._record_pools) pool.destroy(device);
+    }
+    _frames.clear();
+    _bindless.release(Bindless::eStorageBuffer, _instances_i);
+    _bindless.release(Bindless::eStorageBuffer, _meshes_i);
+    _bindless.release(Bindless::eStorageBuffer, _vertices_i);
+    _bindless.release(Bindless::eStorageBuffer, _indices_i);
+    if (_visibility_i != Bindless::invalid_index) {
+        _bindless.release(Bindless::eStorageBuffer, _visibility_i);
+        _visibility.destroy(device._vmalloc);
+    }
+    _instances_version = 0;
+    _bindless.release(Bindless::eStorageBuffer, _points_i);
+    _points_version = 0;
+    _profiler.destroy(device);
+    _bindless.destroy(device);
     // destroy synchronization objects
     _synchronization.destroy(device);
 }
-void Renderer::resize(Device& device, Scene& scene, vk::Extent2D extent, bool srgb_output) {
-    destroy(device);
-    init(device, scene, extent, srgb_output);
+void Renderer::resize(Device& device, Swapchain& swapchain) {
+    // only extent-dependent resources are recreated, descriptor set and its layout persist
+    release_graph_targets();
+    _graph.destroy(device);
+    destroy_images(device);
+    init_images(device, swapchain._extent);
+    // variants of the old extent are not requested again, the device is idle during resize
+    _pipelines.mark();
+    init_pipelines(device, swapchain);
+    _pipelines.evict(device);
+    init_graph(device, swapchain._extent);
+    _bindless.flush(device);
 }
 void Renderer::render(Device& device, Swapchain& swapchain, Scene& scene) {
-    // reset and record command buffer
-    device._logical.resetCommandPool(_command_pool, {});
-    vk::CommandBuffer cmd = _command_buffer;
-    cmd.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-    execute_pipes(cmd, scene);
-    cmd.end();
-    
-    // submit command buffer
-    _synchronization.prepare_for_write();
-    vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eTopOfPipe;
-    vk::TimelineSemaphoreSubmitInfo info_timeline {
-        .waitSemaphoreValueCount = 1, .pWaitSemaphoreValues = &_synchronization._val_ready_to_write,
-        .signalSemaphoreValueCount = 1, .pSignalSemaphoreValues = &_synchronization._val_ready_to_read,
-    };
-    device._universal_queue.submit(vk::SubmitInfo {
-        .pNext = &info_timeline,
-        .waitSemaphoreCount = 1, .pWaitSemaphores = &_synchronization._semaphore,
-        .pWaitDstStageMask = &wait_stage,
-        .commandBufferCount = 1, .pCommandBuffers = &cmd,
-        .signalSemaphoreCount = 1, .pSignalSemaphores = &_synchronization._semaphore,
-    });
-    
-    // present drawn image
-    swapchain.present(device, _storage, _synchronization);
+    Trace::Zone zone("Renderer::render");
+    // acquire first, the final pass writes into the swapchain image directly
+    Image* swap_image = swapchain.acquire(device, _synchronization);
+    if (swap_image == nullptr) return;
+
+    prepare_draws(device, scene);
+
+    // reset and begin one command buffer per graph segment, from the pool of the segment's queue family
+    Frame& frame = _frames[_frame_i];
+    device._logical.resetCommandPool(frame._command_pool, {});
+    device._logical.resetCommandPool(frame._compute_pool, {});
+    for (auto& pool: frame._record_pools) pool.reset(device);
+    const std::vector<FrameGraph::Segment>& segments = _graph.segments();
+    std::vector<vk::CommandBuffer> cmds;
+    uint32_t universal_n = 0, compute_n = 0;
+    for (auto& segment: segments) {
+        std::vector<vk::CommandBuffer>& buffers = segment.async ? frame._compute_buffers : frame._command_buffers;
+        uint32_t& n = segment.async ? compute_n : universal_n;
+        if (n == buffers.size()) {
+            buffers.push_back(device._logical.allocateCommandBuffers({
+                .commandPool = segment.async ? frame._compute_pool : frame._command_pool,
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1,
+            }).front());
+        }
+        vk::CommandBuffer cmd = buffers[n++];
+        cmd.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+        _bindless.bind(cmd, !segment.async);
+        cmds.push_back(cmd);
+    }
+    // the frame that last used this slot completed during wait(), its queries are read back first
+    _profiler.begin_frame(device, cmds.front(), _frame_i);
+
+    // adjust the render scale to the latest GPU frame time
+    if (_dynamic_resolution) _scaler.update(_profiler.frame_ms());
+    _render_extent = _dynamic_resolution ? _scaler.extent(swapchain._extent) : swapchain._extent;
+    _smaa.set_render_extent(_render_extent);
+    _fxaa.set_render_extent(_render_extent);
+    // early and late scene passes share these, so they are not touched while recording in parallel
+    _pipe_default->set_render_area(_render_extent);
+    if (_vbuffer_supported) _pipe_vbuffer->set_render_area(_render_extent);
+
+    {
+        Trace::Zone zone_record("record");
+        _scene_p = &scene;
+        _graph.set_external(_res_swap, *swap_image);
+        // without inherited queries the profiler's statistics can only span passes recorded into the primaries
+        bool parallel = _parallel_recording && (_inherited_queries || !_profiler.active());
+        if (parallel) {
+            _graph.execute(device, cmds, _profiler, frame._record_pools, [this](vk::CommandBuffer cmd, bool async) {
+                _bindless.bind(cmd, !async);
+            });
+        }
+        else _graph.execute(cmds, _profiler);
+        swapchain.prepare_present(cmds.back(), *swap_image);
+        for (auto cmd: cmds) cmd.end();
+    }
+
+    // hand each segment to the next through the timeline, a single segment is ordered against previous frames by barriers on its queue
+    // the first one waits for the previous frame only at stages touching images, which its post-processing may still read
+    uint64_t wait_value = 0;
+    if (segments.size() > 1) {
+        wait_value = _synchronization._value;
+        for (uint32_t i = 0; i + 1 < segments.size(); i++) {
+            vk::SemaphoreSubmitInfo info_wait {
+                .semaphore = _synchronization._semaphore,
+                .value = wait_value,
+                .stageMask = i == 0 ? segments[i].wait_stages : vk::PipelineStageFlagBits2::eAllCommands,
+            };
+            vk::SemaphoreSubmitInfo info_signal {
+                .semaphore = _synchronization._semaphore,
+                .value = _synchronization.next_value(),
+                .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+            };
+            vk::CommandBufferSubmitInfo info_cmd { .commandBuffer = cmds[i] };
+            vk::Queue queue = segments[i].async ? device._compute_queue : device._universal_queue;
+            queue.submit2(vk::SubmitInfo2 {
+                .waitSemaphoreInfoCount = 1, .pWaitSemaphoreInfos = &info_wait,
+                .commandBufferInfoCount = 1, .pCommandBufferInfos = &info_cmd,
+                .signalSemaphoreInfoCount = 1, .pSignalSemaphoreInfos = &info_signal,
+            });
+            wait_value = info_signal.value;
+        }
+    }
+    // the last segment renders into the swapchain image, its value covers every segment before it
+    swapchain.present(device, segments.size() > 1 ? _final_queue : device._universal_queue, cmds.back(), _synchronization, wait_value);
+    frame._timeline_value = _synchronization._value;
+    _frame_i = (_frame_i + 1) % _frames.size();
+}
+void Renderer::set_antialiasing(Device& device, Swapchain& swapchain, AntiAliasing antialiasing, bool smaa_compute) {
+    _antialiasing = antialiasing;
+    _smaa_compute = smaa_compute;
+    rebuild_graph(device, swapchain);
+}
+void Renderer::set_dynamic_resolution(Device& device, Swapchain& swapchain, bool enabled) {
+    _dynamic_resolution = enabled;
+    _scaler.reset();
+    rebuild_graph(device, swapchain);
+}
+void Renderer::set_occlusion_culling(Device& device, Swapchain& swapchain, bool enabled) {
+    _occlusion_culling = enabled;
+    _visibility_reset = true;
+    rebuild_graph(device, swapchain);
+}
+void Renderer::set_visibility_buffer(Device& device, Swapchain& swapchain, bool enabled) {
+    if (enabled && !_vbuffer_supported) {
+        std::println("Visibility buffer requires the geometry shader feature for primitive ids");
+        return;
+    }
+    _visibility_buffer = enabled;
+    rebuild_graph(device, swapchain);
+}
+void Renderer::set_async_compute(Device& device, Swapchain& swapchain, bool enabled) {
+    if (enabled && !_async_supported) {
+        std::println("Async compute requires a compute queue separate from the universal one");
+        return;
+    }
+    _async_compute = enabled;
+    rebuild_graph(device, swapchain);
+}
+void Renderer::set_point_hole_filling(Device& device, Swapchain& swapchain, bool enabled) {
+    _point_hole_filling = enabled;
+    rebuild_graph(device, swapchain);
+}
+void Renderer::rebuild_graph(Device& device, Swapchain& swapchain) {
+    // pipelines of the previous mode stay cached, only the graph is rebuilt
+    release_graph_targets();
+    _graph.destroy(device);
+    init_pipelines(device, swapchain);
+    init_graph(device, swapchain._extent);
+    _bindless.flush(device);
 }
 void Renderer::wait(Device& device) {
-    // wait until write is unblocked to make sure no work is left
-    _synchronization.wait_ready_to_write(device);
+    Trace::Zone zone("Renderer::wait");
+    // only wait for the frame that previously used the upcoming slot, later frames keep running
+    _synchronization.wait(device, _frames[_frame_i]._timeline_value);
+    // resume uploads and other GPU tasks whose submissions completed in the meantime
+    device.poll();
+}
+void Renderer::prepare_draws(Device& device, Scene& scene) {
+    // scene buffers are only replaced while the GPU is idle
+    MeshInstances& instances = scene._instances;
+    if (instances._version != _instances_version) {
+        _bindless.release(Bindless::eStorageBuffer, _instances_i);
+        _bindless.release(Bindless::eStorageBuffer, _meshes_i);
+        _bindless.release(Bindless::eStorageBuffer, _vertices_i);
+        _bindless.release(Bindless::eStorageBuffer, _indices_i);
+        if (instances._uploaded) {
+            _instances_i = _bindless.register_buffer(instances._instance_buffer);
+            _meshes_i = _bindless.register_buffer(instances._mesh_buffer);
+            // read by the visibility buffer's shading pass
+            _vertices_i = _bindless.register_buffer(instances._geometry._vertices._buffer);
+            _indices_i = _bindless.register_buffer(instances._geometry._indices._buffer);
+        }
+        // visibility of the previous instances is meaningless for the new ones
+        // sized to the instance buffer, as streamed instances are appended to it without a new upload
+        if (_visibility_i != Bindless::invalid_index) {
+            _bindless.release(Bindless::eStorageBuffer, _visibility_i);
+            _visibility.destroy(device._vmalloc);
+        }
+        _visibility.init({
+            .vmalloc = device._vmalloc,
+            .size = sizeof(uint32_t) * std::max(instances.instance_capacity(), 1u),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        });
+        _visibility_i = _bindless.register_buffer(_visibility);
+        _visibility_reset = true;
+        _instances_version = instances._version;
+    }
+    PointCloud& points = scene._points;
+    if (points._version != _points_version) {
+        _bindless.release(Bindless::eStorageBuffer, _points_i);
+        if (points._uploaded) _points_i = _bindless.register_buffer(points._buffer);
+        _points_version = points._version;
+    }
+
+    // one command per instance at most, the frame that used these buffers last has completed
+    Frame& frame = _frames[_frame_i];
+    uint32_t capacity = std::max(instances.instance_count(), 1u);
+    if (frame._draw_capacity < capacity) {
+        if (frame._draw_capacity > 0) {
+            frame._draws_early.destroy(device, _bindless);
+            frame._draws_late.destroy(device, _bindless);
+        }
+        frame._draws_early.init(device, _bindless, capacity);
+        frame._draws_late.init(device, _bindless, capacity);
+        frame._draw_capacity = capacity;
+    }
+    _bindless.flush(device);
+}
+void Renderer::DrawList::init(Device& device, Bindless& bindless, uint32_t capacity) {
+    _commands.init({
+        .vmalloc = device._vmalloc,
+        .size = sizeof(vk::DrawIndexedIndirectCommand) * capacity,
+        .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+    });
+    _count.init({
+        .vmalloc = device._vmalloc,
+        .size = sizeof(uint32_t),
+        .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+    });
+    _commands_i = bindless.register_buffer(_commands);
+    _count_i = bindless.register_buffer(_count);
+}
+void Renderer::DrawList::destroy(Device& device, Bindless& bindless) {
+    bindless.release(Bindless::eStorageBuffer, _commands_i);
+    bindless.release(Bindless::eStorageBuffer, _count_i);
+    _commands.destroy(device._vmalloc);
+    _count.destroy(device._vmalloc);
 }
 void Renderer::init_images(Device& device, vk::Extent2D extent) {
     // create image with 16 bits color depth
@@ -74,30 +306,38 @@ void Renderer::init_images(Device& device, vk::Extent2D extent) {
         .extent { extent.width, extent.height, 1 },
         .usage = 
             vk::ImageUsageFlagBits::eColorAttachment |
-            vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eTransferDst |
+            vk::ImageUsageFlagBits::eStorage |
             vk::ImageUsageFlagBits::eSampled,
         .priority = 1.0f,
     });
-    // create storage image with same format as _color
-    _storage.init({
-        .device = device,
-        .format = vk::Format::eR16G16B16A16Sfloat,
-        .extent { extent.width, extent.height, 1 },
-        .usage = 
-            vk::ImageUsageFlagBits::eTransferSrc |
-            vk::ImageUsageFlagBits::eTransferDst |
-            vk::ImageUsageFlagBits::eStorage,
-        .priority = 1.0f,
-    });
     // create depth stencil with depth/stencil format picked by driver
     _depth_stencil.init(device, { extent.width, extent.height, 1 });
+    // farthest depth per region, for occlusion tests against the early pass
+    _depth_pyramid.init(device, extent);
+
+    // register images within the global descriptor set
+    _color_i = _bindless.register_sampled(_color);
+    _color_storage_i = _bindless.register_storage(_color);
+    _depth_i = _bindless.register_sampled(_depth_stencil._depth_view);
+    _pyramid_i = _bindless.register_sampled(_depth_pyramid);
+    for (auto view: _depth_pyramid._mip_views) _pyramid_levels_i.push_back(_bindless.register_storage(view));
+
+    // points rasterize into a buffer, as images lack 64-bit atomics on most devices
+    if (_points_supported) {
+        _points_target.init({
+            .vmalloc = device._vmalloc,
+            .size = sizeof(uint64_t) * extent.width * extent.height,
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        });
+        _points_target_i = _bindless.register_buffer(_points_target);
+    }
 }
-void Renderer::init_pipelines(Device& device, vk::Extent2D extent, Scene& scene, bool srgb_output) {
+void Renderer::init_pipelines(Device& device, Swapchain& swapchain) {
     // create graphics pipelines
-    _pipe_default.init({
+    _pipe_default = &_pipelines.get(Graphics::CreateInfo {
         .device = device,
-        .extent = extent,
+        .bindless = _bindless,
+        .extent = swapchain._extent,
         .vs_path = "defaults/default.vert",
         .fs_path = "defaults/default.frag",
         .color = { .formats = _color._format },
@@ -108,68 +348,460 @@ void Renderer::init_pipelines(Device& device, vk::Extent2D extent, Scene& scene,
         },
         .dynamic_states = {
             vk::DynamicState::eCullMode,
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
         },
     });
-    _pipe_default.write_descriptor(device, 0, 0, scene._camera._buffer, vk::DescriptorType::eUniformBuffer);
     
-    // create sRGB conversion pipeline
-    uint32_t srgb = (uint32_t)srgb_output;
-    std::vector<vk::SpecializationMapEntry> image_spec_entries {
-        vk::SpecializationMapEntry { .constantID = 0, .offset = 0, .size = 4 },
-    };
-    _pipe_tone.init({
+    // ids of the visible triangles, shaded in a single compute pass afterwards
+    if (_vbuffer_supported) {
+        _pipe_vbuffer = &_pipelines.get(Graphics::CreateInfo {
+            .device = device,
+            .bindless = _bindless,
+            .extent = swapchain._extent,
+            .vs_path = "visibility/visibility.vert",
+            .fs_path = "visibility/visibility.frag",
+            .color = { .formats = vk::Format::eR32G32Uint },
+            .depth = {
+                .format = _depth_stencil._format,
+                .write = vk::True,
+                .test = vk::True,
+            },
+            .dynamic_states = {
+                vk::DynamicState::eCullMode,
+                vk::DynamicState::eViewport,
+                vk::DynamicState::eScissor,
+            },
+        });
+        _pipe_vbuffer_shade = &_pipelines.get(Compute::CreateInfo {
+            .device = device,
+            .bindless = _bindless,
+            .cs_path = "visibility/shade.comp",
+        });
+    }
+    
+    // per-instance culling emitting indirect draws for the scene passes, phase 0 tests the frustum only
+    // phase 1 keeps instances visible last frame, phase 2 tests against the depth pyramid
+    struct CullSpec { uint32_t phase; };
+    std::array<Specialization<CullSpec>, 3> cull_specs {{ {{ .phase = 0 }}, {{ .phase = 1 }}, {{ .phase = 2 }} }};
+    std::array<Compute**, 3> cull_pipes { &_pipe_cull, &_pipe_cull_early, &_pipe_cull_late };
+    for (uint32_t i = 0; i < cull_pipes.size(); i++) {
+        *cull_pipes[i] = &_pipelines.get(Compute::CreateInfo {
+            .device = device,
+            .bindless = _bindless,
+            .cs_path = "culling/instances.comp",
+            .spec_info = cull_specs[i].info(),
+        });
+    }
+    _pipe_depth_pyramid = &_pipelines.get(Compute::CreateInfo {
         .device = device,
-        .cs_path = "defaults/tone_mapping.comp",
-        .spec_info {
-            .mapEntryCount = (uint32_t)image_spec_entries.size(),
-            .pMapEntries = image_spec_entries.data(),
-            .dataSize = sizeof(srgb),
-            .pData = &srgb,
+        .bindless = _bindless,
+        .cs_path = "culling/hiz.comp",
+    });
+
+    // point clouds rasterized in compute and resolved into the scene's color and depth
+    if (_points_supported) {
+        _pipe_points_raster = &_pipelines.get(Compute::CreateInfo {
+            .device = device,
+            .bindless = _bindless,
+            .cs_path = "points/rasterize.comp",
+        });
+        struct ResolveSpec { vk::Bool32 fill_holes; };
+        Specialization<ResolveSpec> resolve_spec {{ .fill_holes = _point_hole_filling }};
+        _pipe_points_resolve = &_pipelines.get(Graphics::CreateInfo {
+            .device = device,
+            .bindless = _bindless,
+            .extent = swapchain._extent,
+            .vs_path = "defaults/oversized_triangle.vert",
+            .fs_path = "points/resolve.frag", .fs_spec = resolve_spec.info(),
+            .color = { .formats = _color._format },
+            .depth = {
+                .format = _depth_stencil._format,
+                .write = vk::True,
+                .test = vk::True,
+            },
+            .dynamic_states = {
+                vk::DynamicState::eViewport,
+                vk::DynamicState::eScissor,
+            },
+        });
+    }
+    
+    // create final pass writing into the swapchain, with optional sRGB conversion
+    struct PresentSpec { vk::Bool32 srgb; };
+    Specialization<PresentSpec> present_spec {{ .srgb = swapchain._manual_srgb_required }};
+    _pipe_present = &_pipelines.get(Graphics::CreateInfo {
+        .device = device,
+        .bindless = _bindless,
+        .extent = swapchain._extent,
+        .vs_path = "defaults/oversized_triangle.vert",
+        .fs_path = "defaults/present.frag", .fs_spec = present_spec.info(),
+        .color = { .formats = swapchain._format },
+    });
+    
+    // create pipelines of the selected anti-aliasing mode
+    switch (_antialiasing) {
+        case AntiAliasing::eOff: break;
+        case AntiAliasing::eFXAA: _fxaa.init_pipelines(device, _bindless, _pipelines, swapchain._extent); break;
+        default: {
+            auto quality = (SMAA::Quality)((uint32_t)_antialiasing - (uint32_t)AntiAliasing::eSMAALow);
+            // with dynamic resolution SMAA resolves into an intermediate image, which is upscaled by the present pass
+            vk::Format output_format = _dynamic_resolution ? _color._format : swapchain._format;
+            bool srgb_output = !_dynamic_resolution && swapchain._manual_srgb_required;
+            _smaa.init_pipelines(device, _bindless, _pipelines, swapchain._extent, _depth_stencil._format, output_format, srgb_output, quality, _smaa_compute);
+            break;
+        }
+    }
+}
+void Renderer::destroy_images(Device& device) {
+    _bindless.release(Bindless::eSampledImage, _color_i);
+    _bindless.release(Bindless::eStorageImage, _color_storage_i);
+    _bindless.release(Bindless::eSampledImage, _depth_i);
+    _bindless.release(Bindless::eSampledImage, _pyramid_i);
+    for (auto& index: _pyramid_levels_i) _bindless.release(Bindless::eStorageImage, index);
+    _pyramid_levels_i.clear();
+    if (_points_target_i != Bindless::invalid_index) {
+        _bindless.release(Bindless::eStorageBuffer, _points_target_i);
+        _points_target.destroy(device._vmalloc);
+    }
+    _color.destroy(device);
+    _depth_stencil.destroy(device);
+    _depth_pyramid.destroy(device);
+}
+void Renderer::init_graph(Device& device, vk::Extent2D extent) {
+    _res_color = _graph.add_external(&_color);
+    _res_depth_stencil = _graph.add_external(&_depth_stencil);
+    _res_swap = _graph.add_external(); // bound to the acquired image every frame
+
+    _res_depth_pyramid = _graph.add_external(&_depth_pyramid);
+    if (_visibility_buffer) {
+        _res_vbuffer = _graph.add_transient({
+            .format = vk::Format::eR32G32Uint,
+            .extent = extent,
+            .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eStorage,
+        });
+    }
+
+    if (_occlusion_culling) {
+        // draw what was visible last frame, its depth then decides which of the remaining instances are drawn
+        add_cull_pass("cull early", _pipe_cull_early, false);
+        add_scene_pass("scene early", false, vk::AttachmentLoadOp::eClear);
+        _graph.add_pass({
+            .name = "depth pyramid",
+            .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+            .accesses = {
+                { _res_depth_stencil, FrameGraph::eSampled },
+                { _res_depth_pyramid, FrameGraph::eStorageWrite },
+            },
+            .record = [this](vk::CommandBuffer cmd) {
+                struct PyramidPush {
+                    uint32_t src_i, dst_i;
+                    std::array<uint32_t, 2> src_size, dst_size;
+                    uint32_t level;
+                };
+                // the first level covers the rendered region of the depth image
+                std::array<uint32_t, 2> src_size { _render_extent.width, _render_extent.height };
+                for (uint32_t level = 0; level < _depth_pyramid._levels; level++) {
+                    if (level > 0) {
+                        vk::ImageMemoryBarrier2 barrier {
+                            .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                            .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                            .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                            .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+                            .oldLayout = vk::ImageLayout::eGeneral,
+                            .newLayout = vk::ImageLayout::eGeneral,
+                            .image = _depth_pyramid._image,
+                            .subresourceRange {
+                                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                                .baseMipLevel = level - 1,
+                                .levelCount = 1,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                            }
+                        };
+                        cmd.pipelineBarrier2({ .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier });
+                    }
+                    std::array<uint32_t, 2> dst_size {
+                        std::max(_depth_pyramid._extent.width >> level, 1u),
+                        std::max(_depth_pyramid._extent.height >> level, 1u),
+                    };
+                    _pipe_depth_pyramid->push(cmd, PyramidPush {
+                        .src_i = level == 0 ? _depth_i : _pyramid_levels_i[level - 1],
+                        .dst_i = _pyramid_levels_i[level],
+                        .src_size = src_size,
+                        .dst_size = dst_size,
+                        .level = level,
+                    });
+                    _pipe_depth_pyramid->execute(cmd, (dst_size[0] + 7) / 8, (dst_size[1] + 7) / 8, 1);
+                    src_size = dst_size;
+                }
+            },
+        });
+        add_cull_pass("cull late", _pipe_cull_late, true);
+        add_scene_pass("scene late", true, vk::AttachmentLoadOp::eLoad);
+    }
+    else {
+        add_cull_pass("cull", _pipe_cull, false);
+        add_scene_pass("scene", false, vk::AttachmentLoadOp::eClear);
+    }
+    if (_visibility_buffer) {
+        _graph.add_pass({
+            .name = "shade",
+            .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+            .accesses = {
+                { _res_vbuffer, FrameGraph::eStorageRead },
+                { _res_color, FrameGraph::eStorageWrite },
+            },
+            .record = [this](vk::CommandBuffer cmd) {
+                struct ShadePush {
+                    uint32_t camera_i, instances_i, meshes_i;
+                    uint32_t vertices_i, indices_i;
+                    uint32_t ids_i, color_i;
+                    uint32_t _padding; // uvec2 is 8-byte aligned in the push constant block
+                    std::array<uint32_t, 2> render_size;
+                };
+                _pipe_vbuffer_shade->push(cmd, ShadePush {
+                    .camera_i = _frames[_frame_i]._camera_i,
+                    .instances_i = _instances_i,
+                    .meshes_i = _meshes_i,
+                    .vertices_i = _vertices_i,
+                    .indices_i = _indices_i,
+                    .ids_i = _vbuffer_i,
+                    .color_i = _color_storage_i,
+                    .render_size = { _render_extent.width, _render_extent.height },
+                });
+                _pipe_vbuffer_shade->execute(cmd, (_render_extent.width + 7) / 8, (_render_extent.height + 7) / 8, 1);
+            },
+        });
+    }
+    if (_points_supported) add_point_passes();
+
+    // SMAA blending doubles as the final pass, otherwise tone map into the swapchain image directly
+    // the present pass is also needed to upscale from the dynamic resolution
+    bool smaa = _antialiasing >= AntiAliasing::eSMAALow;
+    bool present = !smaa || _dynamic_resolution;
+    _res_present = _res_color;
+    if (smaa) {
+        FrameGraph::Resource output = _res_swap;
+        if (_dynamic_resolution) {
+            _res_present = output = _graph.add_transient({
+                .format = _color._format,
+                .extent = extent,
+                .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+            });
         }
+        _smaa.add_passes(_graph, extent, _res_color, _res_depth_stencil, output);
+    }
+    else if (_antialiasing == AntiAliasing::eFXAA) {
+        _res_present = _fxaa.add_passes(_graph, extent, _res_color);
+    }
+    if (present) {
+        _graph.add_pass({
+            .name = "present",
+            .accesses = {
+                { _res_present, FrameGraph::eSampled },
+                { _res_swap, FrameGraph::eColorAttachment },
+            },
+            .record = [this, extent](vk::CommandBuffer cmd) {
+                struct PresentPush {
+                    std::array<float, 2> uv_scale;
+                    std::array<float, 2> uv_max;
+                    uint32_t color_i;
+                };
+                float width = (float)extent.width;
+                float height = (float)extent.height;
+                _pipe_present->push(cmd, PresentPush {
+                    .uv_scale = { (float)_render_extent.width / width, (float)_render_extent.height / height },
+                    .uv_max = { ((float)_render_extent.width - 0.5f) / width, ((float)_render_extent.height - 0.5f) / height },
+                    .color_i = _present_i,
+                });
+                _pipe_present->execute(cmd, _graph.get(_res_swap), vk::AttachmentLoadOp::eDontCare);
+            },
+        });
+    }
+    _graph.compile(device, _async_compute);
+
+    // images are only known once the graph was compiled
+    if (smaa) _smaa.register_targets(_bindless, _graph);
+    if (present) _present_i = _bindless.register_sampled(_graph.get(_res_present));
+    if (_antialiasing == AntiAliasing::eFXAA) _fxaa.register_targets(_bindless, _graph);
+    if (_visibility_buffer) _vbuffer_i = _bindless.register_storage(_graph.get(_res_vbuffer));
+}
+void Renderer::add_cull_pass(const std::string& name, Compute* pipe_p, bool late) {
+    std::vector<FrameGraph::Access> accesses;
+    if (late) accesses.push_back({ _res_depth_pyramid, FrameGraph::eSampled });
+    _graph.add_pass({
+        .name = name,
+        .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+        .accesses = std::move(accesses),
+        .record = [this, pipe_p, late](vk::CommandBuffer cmd) {
+            Frame& frame = _frames[_frame_i];
+            DrawList& draws = late ? frame._draws_late : frame._draws_early;
+            if (!late) {
+                // counts of both phases are reset at once, visibility whenever the instances changed
+                cmd.fillBuffer(frame._draws_early._count._data, 0, sizeof(uint32_t), 0);
+                cmd.fillBuffer(frame._draws_late._count._data, 0, sizeof(uint32_t), 0);
+                if (_visibility_reset) cmd.fillBuffer(_visibility._data, 0, vk::WholeSize, 0);
+                _visibility_reset = false;
+                std::array<vk::MemoryBarrier2, 2> barriers {{
+                    {
+                        .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                        .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+                    },
+                    // visibility written by the previous frame's late cull
+                    {
+                        .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                        .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                        .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                        .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+                    },
+                }};
+                cmd.pipelineBarrier2({ .memoryBarrierCount = (uint32_t)barriers.size(), .pMemoryBarriers = barriers.data() });
+            }
+            else {
+                // visibility is overwritten after the early cull read it
+                vk::MemoryBarrier2 barrier_read {
+                    .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                    .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                };
+                cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_read });
+            }
+
+            uint32_t instance_count = _scene_p->_instances.instance_count();
+            if (instance_count > 0) {
+                struct CullPush {
+                    uint32_t camera_i, instances_i, meshes_i;
+                    uint32_t commands_i, count_i, instance_count;
+                    uint32_t visibility_i, pyramid_i;
+                    std::array<uint32_t, 2> pyramid_size;
+                    uint32_t pyramid_levels;
+                };
+                pipe_p->push(cmd, CullPush {
+                    .camera_i = frame._camera_i,
+                    .instances_i = _instances_i,
+                    .meshes_i = _meshes_i,
+                    .commands_i = draws._commands_i,
+                    .count_i = draws._count_i,
+                    .instance_count = instance_count,
+                    .visibility_i = _visibility_i,
+                    .pyramid_i = _pyramid_i,
+                    .pyramid_size = { _depth_pyramid._extent.width, _depth_pyramid._extent.height },
+                    .pyramid_levels = _depth_pyramid._levels,
+                });
+                pipe_p->execute(cmd, (instance_count + 63) / 64, 1, 1);
+            }
+            // buffers are not tracked by the frame graph, hand them to the indirect draw manually
+            vk::MemoryBarrier2 barrier_draw {
+                .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eDrawIndirect,
+                .dstAccessMask = vk::AccessFlagBits2::eIndirectCommandRead,
+            };
+            cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_draw });
+        },
     });
-    _pipe_tone.write_descriptor(device, 0, 0, _storage, vk::DescriptorType::eStorageImage);
-}
-void Renderer::execute_pipes(vk::CommandBuffer cmd, Scene& scene) {
-    // draw scene data
-    _color.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eAttachmentOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-        .dst_access = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite });
-    _depth_stencil.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eEarlyFragmentTests,
-        .dst_access = vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite});
-    cmd.setCullMode(vk::CullModeFlagBits::eNone); // want to see both front and back faces
-    _pipe_default.execute(cmd, _color, vk::AttachmentLoadOp::eClear, _depth_stencil, vk::AttachmentLoadOp::eClear, scene._mesh._mesh);
-    // _pipe_default.execute(cmd, _color, vk::AttachmentLoadOp::eClear, _depth_stencil, vk::AttachmentLoadOp::eClear, scene._grid._query_points);
-
-    // optionally run SMAA
-    if (_smaa_enabled) _smaa.execute(cmd, _color, _depth_stencil);
-
-    // convert from linear to srgb
-    Image& final_image = _smaa_enabled ? _smaa.get_output() : _color;
-    final_image.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eTransferSrcOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eBlit,
-        .dst_access = vk::AccessFlagBits2::eTransferRead
+}
+void Renderer::add_scene_pass(const std::string& name, bool late, vk::AttachmentLoadOp load_op) {
+    // draw all instances of one list with a single indirect call, either shaded or as ids into the visibility buffer
+    FrameGraph::Resource target = _visibility_buffer ? _res_vbuffer : _res_color;
+    _graph.add_pass({
+        .name = name,
+        .accesses = {
+            { target, FrameGraph::eColorAttachment },
+            { _res_depth_stencil, FrameGraph::eDepthStencilAttachment },
+        },
+        .record = [this, late, load_op, target](vk::CommandBuffer cmd) {
+            Frame& frame = _frames[_frame_i];
+            DrawList& draws = late ? frame._draws_late : frame._draws_early;
+            MeshInstances& instances = _scene_p->_instances;
+            Graphics* pipe_p = _visibility_buffer ? _pipe_vbuffer : _pipe_default;
+            cmd.setCullMode(vk::CullModeFlagBits::eNone); // want to see both front and back faces
+            pipe_p->push(cmd, std::array<uint32_t, 2>{ frame._camera_i, _instances_i });
+            pipe_p->execute(cmd, _graph.get(target), load_op, _depth_stencil, load_op,
+                instances._geometry, draws._commands, draws._count, instances.instance_count());
+            // _pipe_default->execute(cmd, _color, vk::AttachmentLoadOp::eClear, _depth_stencil, vk::AttachmentLoadOp::eClear, _scene_p->_grid._query_points);
+        },
     });
-    _storage.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eTransferDstOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eBlit,
-        .dst_access = vk::AccessFlagBits2::eTransferWrite
+}
+void Renderer::add_point_passes() {
+    _graph.add_pass({
+        .name = "points raster",
+        .shader_stage = vk::PipelineStageFlagBits2::eComputeShader,
+        .record = [this](vk::CommandBuffer cmd) {
+            uint32_t point_count = _scene_p->_points.point_count();
+            if (point_count == 0) return;
+            // the previous frame's resolve has to finish reading before the target is cleared
+            vk::MemoryBarrier2 barrier_read {
+                .srcStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+                .dstStageMask = vk::PipelineStageFlagBits2::eTransfer,
+            };
+            cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_read });
+            // all bits set is farther than any depth and marks empty pixels
+            cmd.fillBuffer(_points_target._data, 0, vk::WholeSize, 0xffffffff);
+            vk::MemoryBarrier2 barrier_clear {
+                .srcStageMask = vk::PipelineStageFlagBits2::eTransfer,
+                .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+            };
+            cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_clear });
+
+            struct RasterPush {
+                uint32_t camera_i, points_i, target_i;
+                uint32_t point_count, target_width;
+                uint32_t _padding; // uvec2 is 8-byte aligned in the push constant block
+                std::array<uint32_t, 2> render_size;
+            };
+            _pipe_points_raster->push(cmd, RasterPush {
+                .camera_i = _frames[_frame_i]._camera_i,
+                .points_i = _points_i,
+                .target_i = _points_target_i,
+                .point_count = point_count,
+                .target_width = _color._extent.width,
+                .render_size = { _render_extent.width, _render_extent.height },
+            });
+            // larger clouds are covered by looping within the shader
+            _pipe_points_raster->execute(cmd, std::min((point_count + 255) / 256, 65535u), 1, 1);
+
+            // buffers are not tracked by the frame graph, hand the target to the resolve manually
+            vk::MemoryBarrier2 barrier_resolve {
+                .srcStageMask = vk::PipelineStageFlagBits2::eComputeShader,
+                .srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite,
+                .dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader,
+                .dstAccessMask = vk::AccessFlagBits2::eShaderStorageRead,
+            };
+            cmd.pipelineBarrier2({ .memoryBarrierCount = 1, .pMemoryBarriers = &barrier_resolve });
+        },
     });
-    _storage.blit(cmd, final_image);
-    _storage.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eGeneral,
-        .dst_stage = vk::PipelineStageFlagBits2::eComputeShader,
-        .dst_access = vk::AccessFlagBits2::eShaderRead | vk::AccessFlagBits2::eShaderWrite
+    // depth tested against the meshes, so both kinds of geometry occlude each other
+    _graph.add_pass({
+        .name = "points resolve",
+        .accesses = {
+            { _res_color, FrameGraph::eColorAttachment },
+            { _res_depth_stencil, FrameGraph::eDepthStencilAttachment },
+        },
+        .record = [this](vk::CommandBuffer cmd) {
+            if (_scene_p->_points.point_count() == 0) return;
+            struct ResolvePush {
+                uint32_t target_i, target_width;
+                std::array<uint32_t, 2> render_size;
+            };
+            _pipe_points_resolve->set_render_area(_render_extent);
+            _pipe_points_resolve->push(cmd, ResolvePush {
+                .target_i = _points_target_i,
+                .target_width = _color._extent.width,
+                .render_size = { _render_extent.width, _render_extent.height },
+            });
+            _pipe_points_resolve->execute(cmd, _color, vk::AttachmentLoadOp::eLoad, _depth_stencil, vk::AttachmentLoadOp::eLoad);
+        },
     });
-    uint32_t nx = (uint32_t)std::ceil(_storage._extent.width / 8.0);
-    uint32_t ny = (uint32_t)std::ceil(_storage._extent.height / 8.0);
-    _pipe_tone.execute(cmd, nx, ny, 1);
+}
+void Renderer::release_graph_targets() {
+    // release indices of every mode, unused ones are invalid already
+    _smaa.release_targets(_bindless);
+    _fxaa.release_targets(_bindless);
+    _bindless.release(Bindless::eSampledImage, _present_i);
+    _bindless.release(Bindless::eStorageImage, _vbuffer_i);
 }
\ No newline at end of file
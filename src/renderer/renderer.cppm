@@ -1,42 +1,176 @@
 export module renderer.renderer;
+import std;
 import vulkan_hpp;
 import core.device;
 import renderer.swapchain;
 import renderer.pipeline;
+import renderer.bindless;
+import renderer.specialization;
 import renderer.semaphore;
+import renderer.graph;
+import renderer.resolution;
+import renderer.profiler;
 import buffers.image;
+import buffers.device;
 import scene.scene;
 import ext.smaa;
+import ext.fxaa;
+
+// anti-aliasing applied between the scene and the final pass
+export enum class AntiAliasing: uint32_t { eOff, eFXAA, eSMAALow, eSMAAMedium, eSMAAHigh, eSMAAUltra };
 
 export struct Renderer {
-    void init(Device& device, Scene& scene, vk::Extent2D extent, bool srgb_output);
+    void init(Device& device, Scene& scene, Swapchain& swapchain, uint32_t frame_count);
     void destroy(Device& device);
     
     // resize internal buffers to match the new swapchain
-    void resize(Device& device, Scene& scene, vk::Extent2D extent, bool srgb_output);
-    // record command buffer and submit it to the universal queue. wait() needs to have been called before this
+    void resize(Device& device, Swapchain& swapchain);
+    // record the frame into one command buffer per graph segment, the last one renders into the swapchain image. wait() needs to have been called before this
     void render(Device& device, Swapchain& swapchain, Scene& scene);
-    // wait until device buffers are no longer in use and the command buffers can be recorded again
+    // wait until the upcoming frame's buffers are no longer in use and its command buffer can be recorded again
     void wait(Device& device);
+    // index of the upcoming frame, selects per-frame resources
+    auto frame_index() -> uint32_t { return _frame_i; }
+    // switch anti-aliasing mode, rebuilding the frame graph. GPU needs to be idle
+    void set_antialiasing(Device& device, Swapchain& swapchain, AntiAliasing antialiasing, bool smaa_compute);
+    auto antialiasing() -> AntiAliasing { return _antialiasing; }
+    auto smaa_compute() -> bool { return _smaa_compute; }
+    // render at a scale adjusted to GPU frame time and upscale in the final pass. GPU needs to be idle
+    void set_dynamic_resolution(Device& device, Swapchain& swapchain, bool enabled);
+    auto dynamic_resolution() -> bool { return _dynamic_resolution; }
+    // two-phase occlusion culling against a depth pyramid, falls back to frustum culling only. GPU needs to be idle
+    void set_occlusion_culling(Device& device, Swapchain& swapchain, bool enabled);
+    auto occlusion_culling() -> bool { return _occlusion_culling; }
+    // fill single-pixel gaps between rasterized points from their neighbours. GPU needs to be idle
+    void set_point_hole_filling(Device& device, Swapchain& swapchain, bool enabled);
+    auto point_hole_filling() -> bool { return _point_hole_filling; }
+    // rasterize triangle ids only and shade each pixel once in compute, instead of shading every fragment. GPU needs to be idle
+    void set_visibility_buffer(Device& device, Swapchain& swapchain, bool enabled);
+    auto visibility_buffer() -> bool { return _visibility_buffer; }
+    // run compute post-processing on the async compute queue, overlapping the next frame's culling. GPU needs to be idle
+    void set_async_compute(Device& device, Swapchain& swapchain, bool enabled);
+    auto async_compute() -> bool { return _async_compute; }
+    // record graph passes into secondary command buffers across the job system's workers instead of serially
+    void set_parallel_recording(bool enabled) { _parallel_recording = enabled; }
+    auto parallel_recording() -> bool { return _parallel_recording; }
+
+    // per-pass GPU timings and pipeline statistics
+    Profiler _profiler;
     
 private:
     void init_images(Device& device, vk::Extent2D extent);
-    void init_pipelines(Device& device, vk::Extent2D extent, Scene& scene, bool srgb_output);
-    void execute_pipes(vk::CommandBuffer cmd, Scene& scene);
+    void init_pipelines(Device& device, Swapchain& swapchain);
+    void init_graph(Device& device, vk::Extent2D extent);
+    // register scene buffers after uploads and grow this frame's indirect draw buffers
+    void prepare_draws(Device& device, Scene& scene);
+    // culling and scene passes of one phase, writing and drawing the frame's early or late draw list
+    void add_cull_pass(const std::string& name, Compute* pipe_p, bool late);
+    void add_scene_pass(const std::string& name, bool late, vk::AttachmentLoadOp load_op);
+    // compute rasterization of the scene's point cloud and its depth tested composite into the scene
+    void add_point_passes();
+    void rebuild_graph(Device& device, Swapchain& swapchain);
+    void release_graph_targets();
+    void destroy_images(Device& device);
 
 private:
+    // draw commands of visible instances and their count, written by a culling pass
+    struct DrawList {
+        void init(Device& device, Bindless& bindless, uint32_t capacity);
+        void destroy(Device& device, Bindless& bindless);
+        DeviceBuffer _commands;
+        DeviceBuffer _count;
+        uint32_t _commands_i = Bindless::invalid_index;
+        uint32_t _count_i = Bindless::invalid_index;
+    };
+    // resources recorded into by one frame while others may still execute
+    struct Frame {
+        vk::CommandPool _command_pool;
+        vk::CommandPool _compute_pool; // of the async compute queue's family
+        // one per graph segment, allocated as the graph grows
+        std::vector<vk::CommandBuffer> _command_buffers;
+        std::vector<vk::CommandBuffer> _compute_buffers;
+        // one per recording job, their secondaries are stitched into the buffers above
+        std::vector<FrameGraph::RecordPool> _record_pools;
+        uint32_t _camera_i = Bindless::invalid_index;
+        // early list holds all draws without occlusion culling, late list the newly visible instances
+        DrawList _draws_early;
+        DrawList _draws_late;
+        uint32_t _draw_capacity = 0;
+        uint64_t _timeline_value = 0; // signaled once all of this frame's submissions completed
+    };
     // synchronization
     RendererSemaphore _synchronization;
+    // the frame's last segment runs on a second queue of the universal family if there is one,
+    // so the universal queue can start on the next frame while post-processing still runs
+    vk::Queue _final_queue;
+    bool _async_supported = false; // the compute role got a queue of its own
+    bool _parallel_recording = true;
+    bool _inherited_queries = false; // profiler queries may stay active across secondary command buffers
     // command recording
-    vk::CommandPool _command_pool;
-    vk::CommandBuffer _command_buffer;
+    static constexpr uint32_t max_record_jobs = 8; // the graph has few passes, more jobs would mostly record empty ranges
+    std::vector<Frame> _frames;
+    uint32_t _frame_i = 0;
+    // descriptors
+    Bindless _bindless;
+    uint32_t _color_i = Bindless::invalid_index;
+    uint32_t _instances_i = Bindless::invalid_index;
+    uint32_t _meshes_i = Bindless::invalid_index;
+    uint32_t _instances_version = 0; // upload of the currently registered scene buffers
+    // per-instance visibility of the previous frame, shared by all frames as they run in order
+    DeviceBuffer _visibility;
+    uint32_t _visibility_i = Bindless::invalid_index;
+    bool _visibility_reset = true; // cleared before the next cull
+    // nearest point per pixel as depth and color packed into 64 bits, at swapchain extent
+    DeviceBuffer _points_target;
+    uint32_t _points_target_i = Bindless::invalid_index;
+    uint32_t _points_i = Bindless::invalid_index;
+    uint32_t _points_version = 0; // upload of the currently registered point buffer
+    bool _points_supported = false; // requires 64-bit integers and buffer atomics
+    // instance and triangle per pixel, registered once the graph was compiled
+    uint32_t _vbuffer_i = Bindless::invalid_index;
+    uint32_t _color_storage_i = Bindless::invalid_index;
+    uint32_t _vertices_i = Bindless::invalid_index;
+    uint32_t _indices_i = Bindless::invalid_index;
+    bool _vbuffer_supported = false; // fragment shaders read gl_PrimitiveID through the geometry shader feature
     // images
     DepthStencil _depth_stencil;
+    DepthPyramid _depth_pyramid;
     Image _color;
-    Image _storage;
-    // pipelines
-    Graphics _pipe_default;
-    Compute _pipe_tone;
+    uint32_t _depth_i = Bindless::invalid_index;
+    uint32_t _pyramid_i = Bindless::invalid_index;
+    std::vector<uint32_t> _pyramid_levels_i;
+    // passes and their transient images
+    FrameGraph _graph;
+    FrameGraph::Resource _res_color;
+    FrameGraph::Resource _res_depth_stencil;
+    FrameGraph::Resource _res_depth_pyramid;
+    FrameGraph::Resource _res_vbuffer;
+    FrameGraph::Resource _res_swap;
+    FrameGraph::Resource _res_present; // input of the plain present pass
+    uint32_t _present_i = Bindless::invalid_index;
+    // internal resolution, targets are allocated at swapchain extent and rendered through a sub-viewport
+    ResolutionScaler _scaler;
+    vk::Extent2D _render_extent;
+    bool _dynamic_resolution = false;
+    Scene* _scene_p = nullptr; // scene of the frame being recorded
+    // pipelines, owned by the variant cache
+    PipelineCache _pipelines;
+    Graphics* _pipe_default;
+    Compute* _pipe_cull; // frustum only
+    Compute* _pipe_cull_early;
+    Compute* _pipe_cull_late;
+    Compute* _pipe_depth_pyramid;
+    Compute* _pipe_points_raster;
+    Graphics* _pipe_points_resolve;
+    Graphics* _pipe_vbuffer;
+    Compute* _pipe_vbuffer_shade;
+    Graphics* _pipe_present;
     SMAA _smaa;
-    bool _smaa_enabled = true;
+    FXAA _fxaa;
+    AntiAliasing _antialiasing = AntiAliasing::eSMAAUltra;
+    bool _smaa_compute = false;
+    bool _occlusion_culling = true;
+    bool _point_hole_filling = true;
+    bool _visibility_buffer = false;
+    bool _async_compute = false;
 };
\ No newline at end of file
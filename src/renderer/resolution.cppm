@@ -0,0 +1,38 @@
+export module renderer.resolution;
+import std;
+import vulkan_hpp;
+
+// picks the internal render scale holding a target GPU frame time
+// pixel cost grows with the square of the scale, so the correction uses its square root
+export struct ResolutionScaler {
+    // feed the latest measured GPU frame time, returns the scale of the upcoming frame
+    auto update(double gpu_ms) -> float {
+        if (gpu_ms <= 0.0) return _scale; // no measurement yet
+        // smooth out single frame spikes
+        _smoothed_ms = _smoothed_ms > 0.0 ? std::lerp(_smoothed_ms, gpu_ms, 0.2) : gpu_ms;
+        float ideal = _scale * (float)std::sqrt(_target_ms / _smoothed_ms);
+        ideal = std::clamp(ideal, _min_scale, _max_scale);
+        // hysteresis keeps the scale steady when close to the target, steps are limited to avoid oscillation
+        if (std::abs(ideal - _scale) > 0.02f) {
+            _scale += std::clamp(ideal - _scale, -0.05f, 0.05f);
+        }
+        return _scale;
+    }
+    void reset() {
+        _scale = _max_scale;
+        _smoothed_ms = 0.0;
+    }
+    // extent covered by the scaled viewport within targets of the maximum extent
+    auto extent(vk::Extent2D max_extent) -> vk::Extent2D {
+        return {
+            std::clamp((uint32_t)((float)max_extent.width * _scale), 1u, max_extent.width),
+            std::clamp((uint32_t)((float)max_extent.height * _scale), 1u, max_extent.height),
+        };
+    }
+
+    double _target_ms = 1000.0 / 60.0;
+    double _smoothed_ms = 0.0;
+    float _min_scale = 0.5f;
+    float _max_scale = 1.0f;
+    float _scale = 1.0f;
+};
\ No newline at end of file
@@ -2,45 +2,31 @@ export module renderer.semaphore;
 import vulkan_hpp;
 import core.device;
 
+// monotonic timeline, every submission signals a fresh value
 export struct RendererSemaphore {
     void init(Device& device) {
         vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> chain_timeline {
             {}, { .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0 }
         };
         _semaphore = device._logical.createSemaphore(chain_timeline.get());
-        _val_ready_to_write = 0;
-        _val_ready_to_read = 0;
+        _value = 0;
     }
     void destroy(Device& device) {
         device._logical.destroySemaphore(_semaphore);
     }
-    // increase wait value for future write
-    void prepare_for_read() {
-        _val_ready_to_write = _val_ready_to_read + 1;
+    // reserve the value signaled by the next submission
+    auto next_value() -> uint64_t {
+        return ++_value;
     }
-    // increase wait value for future read
-    void prepare_for_write() {
-        _val_ready_to_read = _val_ready_to_write + 1;
-    }
-    // wait on the host thread until reading is permitted
-    void wait_ready_to_read(Device& device) {
-        vk::SemaphoreWaitInfo info_wait {
-            .semaphoreCount = 1,
-            .pSemaphores = &_semaphore,
-            .pValues = &_val_ready_to_read,
-        };
-        while (vk::Result::eTimeout == device._logical.waitSemaphores({ info_wait }, UINT64_MAX)) {};
-    }
-    // wait on the host thread until writing is permitted
-    void wait_ready_to_write(Device& device) {
+    // wait on the host thread until the given value was signaled
+    void wait(Device& device, uint64_t value) {
         vk::SemaphoreWaitInfo info_wait {
             .semaphoreCount = 1,
             .pSemaphores = &_semaphore,
-            .pValues = &_val_ready_to_write,
+            .pValues = &value,
         };
         while (vk::Result::eTimeout == device._logical.waitSemaphores({ info_wait }, UINT64_MAX)) {};
     }
     vk::Semaphore _semaphore;
-    uint64_t _val_ready_to_write;
-    uint64_t _val_ready_to_read;
+    uint64_t _value; // last value handed out
 };
\ No newline at end of file
@@ -1,17 +1,21 @@
 module;
 #include <vulkan/vulkan_to_string.hpp>
 module renderer.swapchain;
+import core.trace;
 
 void Swapchain::init(Device& device, Window& window) {
+    init(device, window._surface, window._size);
+}
+void Swapchain::init(Device& device, vk::SurfaceKHR surface, vk::Extent2D extent) {
     // query swapchain properties
-    auto capabilities = device._physical.getSurfaceCapabilitiesKHR(window._surface);
+    auto capabilities = device._physical.getSurfaceCapabilitiesKHR(surface);
     // manually clamp extent to capabilities
-    _extent = window._size;
+    _extent = extent;
     _extent.width = std::clamp(_extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
     _extent.height = std::clamp(_extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
 
     // pick color space and format
-    auto available_formats = device._physical.getSurfaceFormatsKHR(window._surface);
+    auto available_formats = device._physical.getSurfaceFormatsKHR(surface);
     // for (auto& format: available_formats) {
     //     std::println("Available format: {}, {}", vk::to_string(format.format), vk::to_string(format.colorSpace));
     // }
@@ -37,31 +41,28 @@ void Swapchain::init(Device& device, Window& window) {
     if (_format == vk::Format::eR8G8B8A8Srgb || _format == vk::Format::eB8G8R8A8Srgb) _manual_srgb_required = false;
     else _manual_srgb_required = true;
 
-    // pick present mode
-    auto available_present_modes = device._physical.getSurfacePresentModesKHR(window._surface);
-    std::vector<vk::PresentModeKHR> preferred_present_modes = {
-        vk::PresentModeKHR::eFifo,
-        vk::PresentModeKHR::eMailbox,
-        vk::PresentModeKHR::eImmediate,
-    };
-    vk::PresentModeKHR present_mode = available_present_modes.front();
-    for (auto pref: preferred_present_modes) {
-        if (std::find(available_present_modes.cbegin(), available_present_modes.cend(), pref) != available_present_modes.cend()) {
-            present_mode = pref;
-            break;
-        }
+    // pick present mode, FIFO is always supported
+    auto available_present_modes = device._physical.getSurfacePresentModesKHR(surface);
+    vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+    switch (_present_mode) {
+        case PresentMode::eFifo: present_mode = vk::PresentModeKHR::eFifo; break;
+        case PresentMode::eMailbox: present_mode = vk::PresentModeKHR::eMailbox; break;
+        case PresentMode::eImmediate: present_mode = vk::PresentModeKHR::eImmediate; break;
+    }
+    if (std::find(available_present_modes.cbegin(), available_present_modes.cend(), present_mode) == available_present_modes.cend()) {
+        present_mode = vk::PresentModeKHR::eFifo;
     }
 
     // create swapchain
     if (capabilities.maxImageCount == 0) capabilities.maxImageCount = std::numeric_limits<uint32_t>::max();
     vk::SwapchainCreateInfoKHR info_swapchain {
-        .surface = window._surface,
+        .surface = surface,
         .minImageCount = std::min<uint32_t>(capabilities.minImageCount + 1, capabilities.maxImageCount),
         .imageFormat = _format,
         .imageColorSpace = color_space,
         .imageExtent = _extent,
         .imageArrayLayers = 1,
-        .imageUsage = vk::ImageUsageFlagBits::eTransferDst,
+        .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
         .imageSharingMode = vk::SharingMode::eExclusive,
         .queueFamilyIndexCount = 1,
         .pQueueFamilyIndices = &device._universal_i,
@@ -73,21 +74,36 @@ void Swapchain::init(Device& device, Window& window) {
     };
     vk::SwapchainKHR swapchain_old = _swapchain;
     _swapchain = device._logical.createSwapchainKHR(info_swapchain);
+    // views of the old images go first, their images are owned by the old swapchain
+    for (auto& image: _images) device._logical.destroyImageView(image._view);
     if (_images.size() > 0) device._logical.destroySwapchainKHR(swapchain_old);
-
-    // retrieve and wrap swapchain images
     _images.clear();
+
+    // retrieve and wrap swapchain images, views are needed to render into them directly
     auto images = device._logical.getSwapchainImagesKHR(_swapchain);
     for (vk::Image image: images) {
+        vk::ImageView view = device._logical.createImageView({
+            .image = image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = _format,
+            .subresourceRange {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            }
+        });
         _images.emplace_back().wrap({
             .image = image,
-            .image_view = nullptr,
+            .image_view = view,
+            .format = _format,
             .extent = { _extent.width, _extent.height, 1 },
             .aspects = vk::ImageAspectFlagBits::eColor
         });
     }
 
-    // create command pools and buffers
+    // create synchronization objects per image
     if (_sync_frames.size() != _images.size()) {
         for (auto& frame: _sync_frames) frame.destroy(device);
         _sync_frames.clear();
@@ -95,6 +111,9 @@ void Swapchain::init(Device& device, Window& window) {
             _sync_frames.emplace_back().init(device);
         }
     }
+    // present ids restart with every swapchain
+    _present_wait = device.has_extension(vk::KHRPresentIdExtensionName) && device.has_extension(vk::KHRPresentWaitExtensionName);
+    _present_id = 0;
     _resize_requested = false;
     std::println("Swapchain created: {}, {}x{}, {}",
         vk::to_string(present_mode),
@@ -102,33 +121,93 @@ void Swapchain::init(Device& device, Window& window) {
         vk::to_string(_format)
     );
 }
+void Swapchain::init_headless(Device& device, vk::Extent2D extent, uint32_t image_count) {
+    _headless = true;
+    _extent = extent;
+    _format = vk::Format::eR8G8B8A8Unorm;
+    _manual_srgb_required = true;
+    _images.resize(image_count);
+    for (auto& image: _images) {
+        image.init({
+            .device = device,
+            .format = _format,
+            .extent = { _extent.width, _extent.height, 1 },
+            .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+        });
+    }
+    _image_values.assign(image_count, 0);
+    _resize_requested = false;
+    std::println("Headless target created: {}x{}, {}", _extent.width, _extent.height, vk::to_string(_format));
+}
 void Swapchain::destroy(Device& device) {
+    if (_headless) {
+        for (auto& image: _images) image.destroy(device);
+        _images.clear();
+        return;
+    }
     for (auto& frame: _sync_frames) frame.destroy(device);
+    for (auto& image: _images) device._logical.destroyImageView(image._view);
     if (_images.size() > 0) device._logical.destroySwapchainKHR(_swapchain);
     _images.clear();
 }
-void Swapchain::resize(Device& device, Window& window) {
-    init(device, window);
+void Swapchain::resize(Device& device, vk::SurfaceKHR surface, vk::Extent2D extent) {
+    if (_headless) return;
+    init(device, surface, extent);
 }
 void Swapchain::set_target_framerate(uint32_t frames_per_second) {
-    double ns = 0;
-    if (frames_per_second > 0) {
-        double fps = (double)frames_per_second;
-        double ms = 1.0 / fps * 1000.0;
-        ns = ms * 1000000.0;
+    _pacer.set_target_framerate(frames_per_second);
+}
+void Swapchain::set_present_mode(PresentMode mode) {
+    _present_mode = mode;
+    _resize_requested = true;
+}
+void Swapchain::pace(Device& device) {
+    // offscreen frames are only limited by the GPU
+    if (_headless) return;
+    // observe when the frame before the previous one was shown, keeping one frame queued for presentation
+    if (_present_wait && _present_id > 1) {
+        Trace::Zone zone("present wait");
+        try {
+            // a present that already completed happened at some unknown earlier point, only a blocking wait times it
+            vk::Result result = device._logical.waitForPresentKHR(_swapchain, _present_id - 1, 0);
+            bool blocked = result == vk::Result::eTimeout;
+            if (blocked) result = device._logical.waitForPresentKHR(_swapchain, _present_id - 1, 100'000'000);
+            if (result == vk::Result::eSuccess && blocked) _pacer.record_present(FramePacer::Clock::now());
+            else _pacer.skip_present();
+        }
+        catch (std::runtime_error& e) {
+            std::println("Present wait error: {}", e.what());
+            _resize_requested = true;
+        }
     }
-    _target_frame_time = std::chrono::nanoseconds(static_cast<int64_t>(ns));
+    _pacer.wait();
 }
-void Swapchain::present(Device& device, Image& src_image, RendererSemaphore& render_semaphore) {
-    // wait for this frame's fence to be signaled and reset it
-    SyncFrame& frame = _sync_frames[_sync_frame_i++ % _sync_frames.size()];
-    while (vk::Result::eTimeout == device._logical.waitForFences(frame._ready_to_record, vk::True, UINT64_MAX));
-    device._logical.resetFences(frame._ready_to_record);
+auto Swapchain::acquire(Device& device, RendererSemaphore& render_semaphore) -> Image* {
+    // cycle through offscreen images, waiting until the frame that last rendered into one completed
+    if (_headless) {
+        _swap_index = _sync_frame_i % _images.size();
+        {
+            Trace::Zone zone("timeline wait");
+            render_semaphore.wait(device, _image_values[_swap_index]);
+        }
+        Image& image = _images[_swap_index];
+        image._last_layout = vk::ImageLayout::eUndefined;
+        image._last_access = vk::AccessFlagBits2::eNone;
+        image._last_stage = vk::PipelineStageFlagBits2::eTopOfPipe;
+        return &image;
+    }
+
+    // wait until this frame's semaphores are no longer in use
+    SyncFrame& frame = _sync_frames[_sync_frame_i % _sync_frames.size()];
+    {
+        Trace::Zone zone("fence wait");
+        while (vk::Result::eTimeout == device._logical.waitForFences(frame._ready_to_record, vk::True, UINT64_MAX));
+    }
 
     // acquire image from swapchain
-    uint32_t swap_index = 0;
+    Trace::Zone zone("acquire");
     for (auto result = vk::Result::eTimeout; result == vk::Result::eTimeout;) {
-        std::tie(result, swap_index) = device._logical.acquireNextImageKHR(_swapchain, UINT64_MAX, frame._ready_to_write);
+        std::tie(result, _swap_index) = device._logical.acquireNextImageKHR(_swapchain, UINT64_MAX, frame._ready_to_write);
         switch (result) {
             case vk::Result::eSuccess: break;
             case vk::Result::eSuboptimalKHR: {
@@ -141,82 +220,93 @@ void Swapchain::present(Device& device, Image& src_image, RendererSemaphore& ren
                 // mark swapchain for resize and abort current immage presentation
                 std::println("Swapchain out of date");
                 _resize_requested = true;
-                return;
+                return nullptr;
             }
             default: {
                 std::println("Unexpected result during swapchain image acquisition: {}", vk::to_string(result));
-                return;
+                return nullptr;
             }
         }
     }
-    
-    // restart command buffer
-    device._logical.resetCommandPool(frame._command_pool);
-    vk::CommandBuffer cmd = frame._command_buffer;
-    cmd.begin({ .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+    // only reset once the following submission is guaranteed to signal it again
+    device._logical.resetFences(frame._ready_to_record);
 
-    // draw incoming image onto the current swapchain image via blit
-    src_image.transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::eTransferSrcOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eBlit,
-        .dst_access = vk::AccessFlagBits2::eTransferRead,
-    });
-    _images[swap_index].transition_layout({
+    // previous contents are discarded, the acquire semaphore is waited on before color output
+    Image& image = _images[_swap_index];
+    image._last_layout = vk::ImageLayout::eUndefined;
+    image._last_access = vk::AccessFlagBits2::eNone;
+    image._last_stage = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+    return &image;
+}
+void Swapchain::prepare_present(vk::CommandBuffer cmd, Image& image) {
+    // offscreen images are only ever read back by copies
+    image.transition_layout({
         .cmd = cmd,
-        .new_layout = vk::ImageLayout::eTransferDstOptimal,
-        .dst_stage = vk::PipelineStageFlagBits2::eBlit,
-        .dst_access = vk::AccessFlagBits2::eTransferWrite,
+        .new_layout = _headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR,
+        .dst_stage = _headless ? vk::PipelineStageFlagBits2::eCopy : vk::PipelineStageFlagBits2::eBottomOfPipe,
+        .dst_access = _headless ? vk::AccessFlagBits2::eTransferRead : vk::AccessFlagBits2::eNone,
     });
-    _images[swap_index].blit(cmd, src_image);
+}
+void Swapchain::present(Device& device, vk::Queue queue, vk::CommandBuffer cmd, RendererSemaphore& render_semaphore, uint64_t wait_value) {
+    Trace::Zone zone("Swapchain::present");
+    _presented_index = _swap_index;
+    vk::PipelineStageFlags wait_stage_timeline = vk::PipelineStageFlagBits::eAllCommands;
+    // without presentation, the timeline semaphore alone tracks completion
+    if (_headless) {
+        uint64_t sign_value = render_semaphore.next_value();
+        uint32_t wait_count = wait_value > 0 ? 1 : 0;
+        vk::TimelineSemaphoreSubmitInfo info_timeline {
+            .waitSemaphoreValueCount = wait_count, .pWaitSemaphoreValues = &wait_value,
+            .signalSemaphoreValueCount = 1, .pSignalSemaphoreValues = &sign_value,
+        };
+        queue.submit(vk::SubmitInfo {
+            .pNext = &info_timeline,
+            .waitSemaphoreCount = wait_count, .pWaitSemaphores = &render_semaphore._semaphore,
+            .pWaitDstStageMask = &wait_stage_timeline,
+            .commandBufferCount = 1, .pCommandBuffers = &cmd,
+            .signalSemaphoreCount = 1, .pSignalSemaphores = &render_semaphore._semaphore,
+        });
+        _image_values[_swap_index] = sign_value;
+        _sync_frame_i++;
+        return;
+    }
+    SyncFrame& frame = _sync_frames[_sync_frame_i++ % _sync_frames.size()];
 
-    // transition swapchain image into presentation layout
-    _images[swap_index].transition_layout({
-        .cmd = cmd,
-        .new_layout = vk::ImageLayout::ePresentSrcKHR,
-        .dst_stage = vk::PipelineStageFlagBits2::eBottomOfPipe,
-        .dst_access = vk::AccessFlagBits2::eNone,
-    });
-    cmd.end();
-    
-    // submit command buffer to graphics queue
-    render_semaphore.prepare_for_read();
-    std::array<uint64_t, 2> wait_timeline_values { render_semaphore._val_ready_to_read,  0 };
-    std::array<uint64_t, 2> sign_timeline_values { render_semaphore._val_ready_to_write, 0 };
-    std::array<vk::Semaphore, 2> wait_semaphores = { render_semaphore._semaphore, frame._ready_to_write };
+    // submit the whole frame, only color output has to wait for the acquired image
+    uint64_t sign_value = render_semaphore.next_value();
+    std::array<uint64_t, 2> sign_timeline_values { sign_value, 0 };
     std::array<vk::Semaphore, 2> sign_semaphores = { render_semaphore._semaphore, frame._ready_to_read };
-    std::array<vk::PipelineStageFlags, 2> wait_stages = { 
-        vk::PipelineStageFlagBits::eTopOfPipe, 
-        vk::PipelineStageFlagBits::eTopOfPipe 
-    };
+    std::array<uint64_t, 2> wait_timeline_values { 0, wait_value };
+    std::array<vk::Semaphore, 2> wait_semaphores = { frame._ready_to_write, render_semaphore._semaphore };
+    std::array<vk::PipelineStageFlags, 2> wait_stages = { vk::PipelineStageFlagBits::eColorAttachmentOutput, wait_stage_timeline };
+    uint32_t wait_count = wait_value > 0 ? 2 : 1;
     vk::TimelineSemaphoreSubmitInfo info_timeline {
-        .waitSemaphoreValueCount =   wait_timeline_values.size(), .pWaitSemaphoreValues =   wait_timeline_values.data(),
+        .waitSemaphoreValueCount = wait_count, .pWaitSemaphoreValues = wait_timeline_values.data(),
         .signalSemaphoreValueCount = sign_timeline_values.size(), .pSignalSemaphoreValues = sign_timeline_values.data(),
     };
-    device._universal_queue.submit(vk::SubmitInfo {
+    queue.submit(vk::SubmitInfo {
         .pNext = &info_timeline,
-        .waitSemaphoreCount = (uint32_t)wait_semaphores.size(), .pWaitSemaphores = wait_semaphores.data(),
+        .waitSemaphoreCount = wait_count, .pWaitSemaphores = wait_semaphores.data(),
         .pWaitDstStageMask = wait_stages.data(),
         .commandBufferCount = 1, .pCommandBuffers = &cmd,
         .signalSemaphoreCount = (uint32_t)sign_semaphores.size(), .pSignalSemaphores = sign_semaphores.data(),
     }, frame._ready_to_record);
 
-    // wait for target framerate
-    auto new_timestamp = std::chrono::high_resolution_clock::now();
-    std::chrono::nanoseconds frame_time = new_timestamp - _timestamp;
-    if (_target_frame_time > frame_time) {
-        std::this_thread::sleep_for(_target_frame_time - frame_time);
-    }
-    _timestamp = std::chrono::high_resolution_clock::now();
-    
     // present swapchain image
+    Trace::Zone zone_present("present");
+    _present_id++;
+    vk::PresentIdKHR info_present_id {
+        .swapchainCount = 1,
+        .pPresentIds = &_present_id,
+    };
     try {
-        auto res = device._universal_queue.presentKHR({
+        auto res = queue.presentKHR({
+            .pNext = _present_wait ? &info_present_id : nullptr,
             .waitSemaphoreCount = 1,
             .pWaitSemaphores = &frame._ready_to_read,
             .swapchainCount = 1,
             .pSwapchains = &_swapchain,
-            .pImageIndices = &swap_index,
+            .pImageIndices = &_swap_index,
             .pResults = nullptr
         });
         switch (res) {
@@ -238,25 +328,41 @@ void Swapchain::present(Device& device, Image& src_image, RendererSemaphore& ren
         _resize_requested = true;
     }
 }
+void Swapchain::save_ppm(Device& device, const std::filesystem::path& path) {
+    Image& image = _images[_presented_index];
+    std::vector<std::byte> data = image.read_texture(device);
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::println("Failed to write image to {}", path.string());
+        return;
+    }
+    // drop alpha, swizzle BGRA formats of surfaces
+    bool bgra = _format == vk::Format::eB8G8R8A8Unorm || _format == vk::Format::eB8G8R8A8Srgb;
+    if (vk::blockSize(_format) != 4 || vk::componentBits(_format, 0) != 8) {
+        std::println("Image format {} can not be written as PPM", vk::to_string(_format));
+        return;
+    }
+    file << std::format("P6\n{} {}\n255\n", _extent.width, _extent.height);
+    std::vector<char> row(_extent.width * 3);
+    for (uint32_t y = 0; y < _extent.height; y++) {
+        for (uint32_t x = 0; x < _extent.width; x++) {
+            const std::byte* pixel_p = &data[(y * _extent.width + x) * 4];
+            row[x * 3 + 0] = (char)pixel_p[bgra ? 2 : 0];
+            row[x * 3 + 1] = (char)pixel_p[1];
+            row[x * 3 + 2] = (char)pixel_p[bgra ? 0 : 2];
+        }
+        file.write(row.data(), (std::streamsize)row.size());
+    }
+    std::println("Image written to {}", path.string());
+}
 
 void Swapchain::SyncFrame::init(Device& device) {
-    // create command pool for this frame
-    _command_pool = device._logical.createCommandPool({ .queueFamilyIndex = device._universal_i });
-    
-    // allocate command buffer from command pool
-    _command_buffer = device._logical.allocateCommandBuffers({
-        .commandPool = _command_pool,
-        .level = vk::CommandBufferLevel::ePrimary,
-        .commandBufferCount = 1,
-    }).front();
-
     // create synchronization objects for this frame
     _ready_to_record = device._logical.createFence({ .flags = vk::FenceCreateFlagBits::eSignaled });
     _ready_to_write = device._logical.createSemaphore({});
     _ready_to_read = device._logical.createSemaphore({});
 }
 void Swapchain::SyncFrame::destroy(Device& device) {
-    device._logical.destroyCommandPool(_command_pool);
     device._logical.destroyFence(_ready_to_record);
     device._logical.destroySemaphore(_ready_to_write);
     device._logical.destroySemaphore(_ready_to_read);
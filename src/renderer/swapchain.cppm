@@ -5,13 +5,33 @@ import core.device;
 import core.window;
 import buffers.image;
 import renderer.semaphore;
+import renderer.pacer;
+
+// preferred presentation mode, FIFO is used whenever the preference is unavailable
+export enum class PresentMode: uint32_t { eFifo, eMailbox, eImmediate };
 
 export struct Swapchain {
     void init(Device& device, Window& window);
+    void init(Device& device, vk::SurfaceKHR surface, vk::Extent2D extent);
+    // render into offscreen images instead of a surface, frames are paced by the renderer's timeline semaphore
+    void init_headless(Device& device, vk::Extent2D extent, uint32_t image_count);
     void destroy(Device& device);
-    void resize(Device& device, Window& window);
+    // recreate at the given extent, which may be newer than what the window's own state reflects
+    void resize(Device& device, vk::SurfaceKHR surface, vk::Extent2D extent);
     void set_target_framerate(uint32_t fps);
-    void present(Device& device, Image& src_image, RendererSemaphore& render_semaphore);
+    // takes effect once the swapchain is recreated
+    void set_present_mode(PresentMode mode);
+    // block until the next frame is due, call before sampling input for it
+    void pace(Device& device);
+    // acquire the next image to render into, returns nullptr if the swapchain needs to be recreated
+    auto acquire(Device& device, RendererSemaphore& render_semaphore) -> Image*;
+    // record the final transition of the acquired image, for presentation or readback when headless
+    void prepare_present(vk::CommandBuffer cmd, Image& image);
+    // submit the recorded frame once the acquired image is writable, then present it after rendering finished
+    // the submission also waits for the timeline value of earlier segments of the frame if non-zero, the queue needs to support presentation
+    void present(Device& device, vk::Queue queue, vk::CommandBuffer cmd, RendererSemaphore& render_semaphore, uint64_t wait_value = 0);
+    // write the most recently presented image as binary PPM, GPU needs to be idle
+    void save_ppm(Device& device, const std::filesystem::path& path);
 
     vk::SwapchainKHR _swapchain;
     std::vector<Image> _images;
@@ -19,22 +39,26 @@ export struct Swapchain {
     vk::Format _format;
     bool _resize_requested;
     bool _manual_srgb_required;
+    bool _headless = false;
+    PresentMode _present_mode = PresentMode::eFifo;
+    FramePacer _pacer;
 
 private:
     struct SyncFrame;
     uint32_t _sync_frame_i = 0;
+    uint32_t _swap_index = 0;
+    uint32_t _presented_index = 0;
+    std::vector<uint64_t> _image_values; // timeline value signaled once an offscreen image was rendered
     std::vector<SyncFrame> _sync_frames;
-    std::chrono::duration<int64_t, std::nano> _target_frame_time;
-    std::chrono::time_point<std::chrono::high_resolution_clock> _timestamp;
+    // present ids of the current swapchain, waited on to observe actual presentation
+    bool _present_wait = false;
+    uint64_t _present_id = 0;
 };
 
 struct Swapchain::SyncFrame {
     void init(Device& device);
     void destroy(Device& device);
 
-    // command recording
-    vk::CommandPool _command_pool;
-    vk::CommandBuffer _command_buffer;
     // synchronization
     vk::Fence _ready_to_record;
     vk::Semaphore _ready_to_write;
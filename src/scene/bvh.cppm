@@ -0,0 +1,449 @@
+module;
+#include <glm/glm.hpp>
+#if defined(__SSE__) || defined(_M_X64)
+    #include <immintrin.h>
+    #define BVH_SSE
+#endif
+export module scene.bvh;
+import std;
+import core.parallel;
+import core.trace;
+
+// bounding volume hierarchy over a triangle list for picking and distance queries on the CPU
+// built top-down with binned SAH, large nodes are binned in parallel and the remaining subtrees are built on separate threads
+export struct Bvh {
+    // two nodes per cache line, interior nodes store their children adjacently at first and first + 1
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // child or triangle index
+        glm::vec3 max;
+        uint32_t count; // triangles of a leaf, zero for interior nodes
+    };
+    // vertex indices of a triangle and the face it came from
+    struct Triangle {
+        std::array<uint32_t, 3> indices;
+        uint32_t face;
+    };
+    struct Hit {
+        float t; // in units of the ray direction
+        uint32_t face;
+        glm::vec2 barycentrics;
+    };
+    struct Closest {
+        float distance;
+        glm::vec3 point;
+        uint32_t face;
+    };
+    static_assert(sizeof(Node) == 32, "nodes need to stay compact");
+
+    // copy vertex positions and build over the triangle list
+    template<typename Vertex>
+    void build(std::span<const Vertex> vertices, std::span<const uint32_t> indices, uint32_t thread_count = Parallel::default_thread_count()) {
+        Trace::Zone zone("Bvh::build");
+        _positions.resize(vertices.size());
+        Parallel::for_range(vertices.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) _positions[i] = vertices[i].pos;
+        });
+        build(indices, thread_count);
+    }
+    // build over triangles indexing into _positions
+    void build(std::span<const uint32_t> indices, uint32_t thread_count);
+    void clear();
+    auto empty() const -> bool { return _nodes.empty(); }
+
+    // nearest triangle along the ray up to t_max
+    auto intersect(glm::vec3 origin, glm::vec3 direction, float t_max = std::numeric_limits<float>::max()) const -> std::optional<Hit>;
+    // nearest point on any triangle within max_distance
+    auto closest_point(glm::vec3 point, float max_distance = std::numeric_limits<float>::max()) const -> std::optional<Closest>;
+
+    std::vector<Node> _nodes;
+    std::vector<Triangle> _triangles; // in leaf order
+    std::vector<glm::vec3> _positions;
+};
+
+module: private;
+constexpr uint32_t bin_count = 16;
+constexpr uint32_t min_leaf_size = 2; // never split below
+constexpr uint32_t max_leaf_size = 16; // always split above, even when SAH prefers a leaf
+constexpr uint32_t stack_size = 128; // traversal stack entries, holds at most one per level plus the current node
+constexpr uint32_t max_depth = stack_size - 1; // deeper nodes become leaves regardless of their size
+
+struct Bounds {
+    void grow(glm::vec3 point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void grow(const Bounds& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+    // half the surface area, only relative values matter for SAH
+    auto area() const -> float {
+        glm::vec3 extent = glm::max(max - min, glm::vec3(0));
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+    glm::vec3 min { std::numeric_limits<float>::max() };
+    glm::vec3 max { std::numeric_limits<float>::lowest() };
+};
+// triangle bounds during construction, reordered in place as nodes are split
+struct Prim {
+    auto centroid() const -> glm::vec3 { return (min + max) * 0.5f; }
+    glm::vec3 min;
+    uint32_t face;
+    glm::vec3 max;
+    uint32_t _padding;
+};
+struct Bin {
+    Bounds bounds;
+    uint32_t count = 0;
+};
+using Bins = std::array<std::array<Bin, bin_count>, 3>;
+struct Split {
+    uint32_t axis;
+    uint32_t bin; // first bin on the right side
+    float cost;
+};
+struct Job {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t depth;
+};
+
+// bounds of the triangles and of their centroids
+auto get_bounds(std::span<const Prim> prims, uint32_t thread_count) -> std::pair<Bounds, Bounds> {
+    Bounds bounds, centroids;
+    std::mutex mutex;
+    Parallel::for_range(prims.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+        Bounds local_bounds, local_centroids;
+        for (std::size_t i = begin; i < end; i++) {
+            local_bounds.grow(prims[i].min);
+            local_bounds.grow(prims[i].max);
+            local_centroids.grow(prims[i].centroid());
+        }
+        std::lock_guard lock(mutex);
+        bounds.grow(local_bounds);
+        centroids.grow(local_centroids);
+    }, 1 << 16);
+    return { bounds, centroids };
+}
+auto get_bin(const Bounds& centroids, glm::vec3 centroid, uint32_t axis) -> uint32_t {
+    float extent = centroids.max[axis] - centroids.min[axis];
+    float bin = (centroid[axis] - centroids.min[axis]) * ((float)bin_count / extent);
+    return std::min(bin_count - 1, (uint32_t)std::max(bin, 0.0f));
+}
+// cheapest split plane between bins along any axis
+auto find_split(std::span<const Prim> prims, const Bounds& centroids, uint32_t thread_count) -> std::optional<Split> {
+    Bins bins;
+    std::mutex mutex;
+    Parallel::for_range(prims.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+        Bins local;
+        for (std::size_t i = begin; i < end; i++) {
+            glm::vec3 centroid = prims[i].centroid();
+            for (uint32_t axis = 0; axis < 3; axis++) {
+                if (centroids.max[axis] <= centroids.min[axis]) continue;
+                Bin& bin = local[axis][get_bin(centroids, centroid, axis)];
+                bin.bounds.grow(prims[i].min);
+                bin.bounds.grow(prims[i].max);
+                bin.count++;
+            }
+        }
+        std::lock_guard lock(mutex);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            for (uint32_t i = 0; i < bin_count; i++) {
+                bins[axis][i].bounds.grow(local[axis][i].bounds);
+                bins[axis][i].count += local[axis][i].count;
+            }
+        }
+    }, 1 << 16);
+
+    // sweep from the right, then from the left evaluating every plane
+    std::optional<Split> best;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        if (centroids.max[axis] <= centroids.min[axis]) continue;
+        std::array<float, bin_count> right_cost;
+        Bounds right;
+        uint32_t right_count = 0;
+        for (uint32_t i = bin_count - 1; i > 0; i--) {
+            right.grow(bins[axis][i].bounds);
+            right_count += bins[axis][i].count;
+            right_cost[i] = right_count > 0 ? right.area() * (float)right_count : 0.0f;
+        }
+        Bounds left;
+        uint32_t left_count = 0;
+        for (uint32_t i = 1; i < bin_count; i++) {
+            left.grow(bins[axis][i - 1].bounds);
+            left_count += bins[axis][i - 1].count;
+            float cost = (left_count > 0 ? left.area() * (float)left_count : 0.0f) + right_cost[i];
+            if (!best.has_value() || cost < best->cost) best = Split { .axis = axis, .bin = i, .cost = cost };
+        }
+    }
+    return best;
+}
+// set the node's bounds and split its range, returns the first triangle of the right child or nullopt for a leaf
+auto split_node(Bvh::Node& node, std::span<Prim> prims, uint32_t begin, uint32_t end, uint32_t depth, uint32_t thread_count) -> std::optional<uint32_t> {
+    std::span<Prim> range = prims.subspan(begin, end - begin);
+    auto [bounds, centroids] = get_bounds(range, thread_count);
+    node.min = bounds.min;
+    node.max = bounds.max;
+    node.first = begin;
+    node.count = end - begin;
+    // degenerate splits could otherwise nest deeper than the fixed traversal stack
+    if (node.count <= min_leaf_size || depth >= max_depth) return std::nullopt;
+
+    // intersection and traversal are weighted equally
+    auto split = find_split(range, centroids, thread_count);
+    float leaf_cost = bounds.area() * (float)node.count;
+    if ((!split.has_value() || bounds.area() + split->cost >= leaf_cost) && node.count <= max_leaf_size) return std::nullopt;
+
+    uint32_t mid = begin;
+    if (split.has_value()) {
+        auto it = std::partition(range.begin(), range.end(), [&](const Prim& prim) {
+            return get_bin(centroids, prim.centroid(), split->axis) < split->bin;
+        });
+        mid = begin + (uint32_t)(it - range.begin());
+    }
+    // coincident centroids cannot be separated by planes, halve the range instead
+    if (mid == begin || mid == end) mid = begin + node.count / 2;
+    node.count = 0;
+    return mid;
+}
+// build the subtree of a job into its own node list, root first
+void build_subtree(std::vector<Bvh::Node>& nodes, std::span<Prim> prims, Job root) {
+    nodes.push_back({});
+    std::vector<Job> jobs { { 0, root.begin, root.end, root.depth } };
+    while (!jobs.empty()) {
+        Job job = jobs.back();
+        jobs.pop_back();
+        auto mid = split_node(nodes[job.node], prims, job.begin, job.end, job.depth, 1);
+        if (!mid.has_value()) continue;
+        uint32_t left = (uint32_t)nodes.size();
+        nodes[job.node].first = left;
+        nodes.resize(nodes.size() + 2);
+        jobs.push_back({ left, job.begin, *mid, job.depth + 1 });
+        jobs.push_back({ left + 1, *mid, job.end, job.depth + 1 });
+    }
+}
+
+void Bvh::build(std::span<const uint32_t> indices, uint32_t thread_count) {
+    _nodes.clear();
+    _triangles.clear();
+    uint32_t count = (uint32_t)(indices.size() / 3);
+    if (count == 0) return;
+
+    std::vector<Prim> prims(count);
+    Parallel::for_range(count, thread_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            Bounds bounds;
+            for (uint32_t v = 0; v < 3; v++) bounds.grow(_positions[indices[i * 3 + v]]);
+            prims[i] = { .min = bounds.min, .face = (uint32_t)i, .max = bounds.max };
+        }
+    });
+
+    // split large nodes breadth-first with parallel binning until enough independent subtrees exist
+    uint32_t subtree_size = std::max(count / (thread_count * 8), 1u << 12);
+    std::vector<Job> jobs { { 0, 0, count, 0 } };
+    std::vector<Job> subtrees;
+    _nodes.push_back({});
+    while (!jobs.empty()) {
+        Job job = jobs.back();
+        jobs.pop_back();
+        if (job.end - job.begin <= subtree_size) {
+            subtrees.push_back(job);
+            continue;
+        }
+        auto mid = split_node(_nodes[job.node], prims, job.begin, job.end, job.depth, thread_count);
+        if (!mid.has_value()) continue;
+        uint32_t left = (uint32_t)_nodes.size();
+        _nodes[job.node].first = left;
+        _nodes.resize(_nodes.size() + 2);
+        jobs.push_back({ left, job.begin, *mid, job.depth + 1 });
+        jobs.push_back({ left + 1, *mid, job.end, job.depth + 1 });
+    }
+
+    // largest subtrees first, threads pick the next one as they become idle
+    std::sort(subtrees.begin(), subtrees.end(), [](const Job& a, const Job& b) { return a.end - a.begin > b.end - b.begin; });
+    std::vector<std::vector<Node>> subtree_nodes(subtrees.size());
+    std::atomic<uint32_t> next = 0;
+    Parallel::for_range(thread_count, thread_count, [&](std::size_t, std::size_t) {
+        for (uint32_t i = next++; i < subtrees.size(); i = next++) build_subtree(subtree_nodes[i], prims, subtrees[i]);
+    }, 1);
+
+    // splice each subtree in place of its placeholder, offsetting child indices
+    for (uint32_t i = 0; i < subtrees.size(); i++) {
+        std::vector<Node>& nodes = subtree_nodes[i];
+        uint32_t offset = (uint32_t)_nodes.size() - 1;
+        for (auto& node: nodes) {
+            if (node.count == 0) node.first += offset;
+        }
+        _nodes[subtrees[i].node] = nodes.front();
+        _nodes.insert(_nodes.end(), nodes.begin() + 1, nodes.end());
+    }
+
+    // store triangles in leaf order so leaves read them contiguously
+    _triangles.resize(count);
+    Parallel::for_range(count, thread_count, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            uint32_t face = prims[i].face;
+            _triangles[i] = { .indices { indices[face * 3 + 0], indices[face * 3 + 1], indices[face * 3 + 2] }, .face = face };
+        }
+    });
+}
+void Bvh::clear() {
+    _nodes = {};
+    _triangles = {};
+    _positions = {};
+}
+
+#ifdef BVH_SSE
+struct Ray {
+    Ray(glm::vec3 origin, glm::vec3 direction) {
+        glm::vec3 inverse = 1.0f / direction;
+        _origin = _mm_setr_ps(origin.x, origin.y, origin.z, 0.0f);
+        _inverse = _mm_setr_ps(inverse.x, inverse.y, inverse.z, 0.0f);
+    }
+    // entry distance into the node's box, infinity if it is missed or farther than t_max
+    auto enter(const Bvh::Node& node, float t_max) const -> float {
+        // the fourth lane holds the node's index or count and is never read back
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.min.x), _origin), _inverse);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.max.x), _origin), _inverse);
+        __m128 near = _mm_min_ps(t0, t1);
+        __m128 far = _mm_max_ps(t0, t1);
+        // reduce x, y and z into the first lane
+        near = _mm_max_ps(near, _mm_max_ps(_mm_shuffle_ps(near, near, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(near, near, _MM_SHUFFLE(3, 1, 0, 2))));
+        far = _mm_min_ps(far, _mm_min_ps(_mm_shuffle_ps(far, far, _MM_SHUFFLE(3, 0, 2, 1)), _mm_shuffle_ps(far, far, _MM_SHUFFLE(3, 1, 0, 2))));
+        float t_near = std::max(_mm_cvtss_f32(near), 0.0f);
+        float t_far = std::min(_mm_cvtss_f32(far), t_max);
+        return t_near <= t_far ? t_near : std::numeric_limits<float>::infinity();
+    }
+    __m128 _origin;
+    __m128 _inverse;
+};
+#else
+struct Ray {
+    Ray(glm::vec3 origin, glm::vec3 direction): _origin(origin), _inverse(1.0f / direction) {}
+    // entry distance into the node's box, infinity if it is missed or farther than t_max
+    auto enter(const Bvh::Node& node, float t_max) const -> float {
+        glm::vec3 t0 = (node.min - _origin) * _inverse;
+        glm::vec3 t1 = (node.max - _origin) * _inverse;
+        glm::vec3 near = glm::min(t0, t1);
+        glm::vec3 far = glm::max(t0, t1);
+        float t_near = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float t_far = std::min(std::min(far.x, far.y), std::min(far.z, t_max));
+        return t_near <= t_far ? t_near : std::numeric_limits<float>::infinity();
+    }
+    glm::vec3 _origin;
+    glm::vec3 _inverse;
+};
+#endif
+
+struct StackEntry {
+    uint32_t node;
+    float distance; // entry distance along the ray, or squared distance to the box
+};
+auto Bvh::intersect(glm::vec3 origin, glm::vec3 direction, float t_max) const -> std::optional<Hit> {
+    if (_nodes.empty()) return std::nullopt;
+    Ray ray(origin, direction);
+    std::optional<Hit> hit;
+    std::array<StackEntry, stack_size> stack;
+    uint32_t stack_i = 0;
+    if (ray.enter(_nodes[0], t_max) < std::numeric_limits<float>::infinity()) stack[stack_i++] = { 0, 0.0f };
+
+    while (stack_i > 0) {
+        StackEntry entry = stack[--stack_i];
+        if (entry.distance > t_max) continue;
+        const Node& node = _nodes[entry.node];
+        if (node.count > 0) {
+            // Möller-Trumbore against each triangle of the leaf
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Triangle& triangle = _triangles[i];
+                glm::vec3 p0 = _positions[triangle.indices[0]];
+                glm::vec3 edge1 = _positions[triangle.indices[1]] - p0;
+                glm::vec3 edge2 = _positions[triangle.indices[2]] - p0;
+                glm::vec3 p = glm::cross(direction, edge2);
+                float det = glm::dot(edge1, p);
+                if (std::abs(det) < 1e-12f) continue;
+                float inv_det = 1.0f / det;
+                glm::vec3 s = origin - p0;
+                float u = glm::dot(s, p) * inv_det;
+                if (u < 0.0f || u > 1.0f) continue;
+                glm::vec3 q = glm::cross(s, edge1);
+                float v = glm::dot(direction, q) * inv_det;
+                if (v < 0.0f || u + v > 1.0f) continue;
+                float t = glm::dot(edge2, q) * inv_det;
+                if (t < 0.0f || t >= t_max) continue;
+                t_max = t;
+                hit = Hit { .t = t, .face = triangle.face, .barycentrics = { u, v } };
+            }
+            continue;
+        }
+        // push the farther child first so the nearer one is visited next
+        float t_left = ray.enter(_nodes[node.first], t_max);
+        float t_right = ray.enter(_nodes[node.first + 1], t_max);
+        StackEntry left { node.first, t_left };
+        StackEntry right { node.first + 1, t_right };
+        if (t_left < t_right) std::swap(left, right);
+        if (left.distance < std::numeric_limits<float>::infinity()) stack[stack_i++] = left;
+        if (right.distance < std::numeric_limits<float>::infinity()) stack[stack_i++] = right;
+    }
+    return hit;
+}
+
+// closest point on a triangle, from Ericson's Real-Time Collision Detection
+auto closest_on_triangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) -> glm::vec3 {
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+auto distance_squared(const Bvh::Node& node, glm::vec3 point) -> float {
+    glm::vec3 d = glm::max(glm::max(node.min - point, point - node.max), glm::vec3(0));
+    return glm::dot(d, d);
+}
+auto Bvh::closest_point(glm::vec3 point, float max_distance) const -> std::optional<Closest> {
+    if (_nodes.empty()) return std::nullopt;
+    std::optional<Closest> closest;
+    float best = max_distance < std::numeric_limits<float>::max() ? max_distance * max_distance : std::numeric_limits<float>::max();
+    std::array<StackEntry, stack_size> stack;
+    uint32_t stack_i = 0;
+    stack[stack_i++] = { 0, distance_squared(_nodes[0], point) };
+
+    while (stack_i > 0) {
+        StackEntry entry = stack[--stack_i];
+        if (entry.distance >= best) continue;
+        const Node& node = _nodes[entry.node];
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Triangle& triangle = _triangles[i];
+                glm::vec3 candidate = closest_on_triangle(point,
+                    _positions[triangle.indices[0]], _positions[triangle.indices[1]], _positions[triangle.indices[2]]);
+                float distance = glm::dot(candidate - point, candidate - point);
+                if (distance >= best) continue;
+                best = distance;
+                closest = Closest { .distance = 0.0f, .point = candidate, .face = triangle.face };
+            }
+            continue;
+        }
+        // visit the nearer child first, it most likely tightens the bound
+        StackEntry left { node.first, distance_squared(_nodes[node.first], point) };
+        StackEntry right { node.first + 1, distance_squared(_nodes[node.first + 1], point) };
+        if (left.distance < right.distance) std::swap(left, right);
+        if (left.distance < best) stack[stack_i++] = left;
+        if (right.distance < best) stack[stack_i++] = right;
+    }
+    if (closest.has_value()) closest->distance = std::sqrt(best);
+    return closest;
+}
\ No newline at end of file
@@ -3,28 +3,57 @@ module;
 #include <glm/gtc/type_aligned.hpp>
 #include <glm/gtc/quaternion.hpp>
 export module scene.camera;
+import std;
 import vulkan_hpp;
 import vulkan.allocator;
 import core.input;
+import core.trace;
 import buffers.device;
 
 export struct Camera {
-    void init(vma::Allocator vmalloc) {
-        // create camera matrix buffer
-		_buffer.init({
-            .vmalloc = vmalloc,
-            .size = sizeof(glm::aligned_mat4x4),
-            .usage = vk::BufferUsageFlagBits::eUniformBuffer,
-		});
+    void init(vma::Allocator vmalloc, uint32_t frame_count) {
+        // create one camera matrix buffer per frame in flight
+		_buffers.resize(frame_count);
+		for (auto& buffer: _buffers) {
+			buffer.init({
+				.vmalloc = vmalloc,
+				.size = sizeof(glm::aligned_mat4x4),
+				.usage = vk::BufferUsageFlagBits::eStorageBuffer,
+			});
+		}
     }
     void destroy(vma::Allocator vmalloc) {
-		_buffer.destroy(vmalloc);
+		for (auto& buffer: _buffers) buffer.destroy(vmalloc);
+		_buffers.clear();
     }
     
     void resize(vk::Extent2D extent) {
 		_extent = extent;
     }
-	void update(vma::Allocator vmalloc) {
+	void update(vma::Allocator vmalloc, uint32_t frame_i) {
+		Trace::Zone zone("Camera::update");
+		// scripted cameras have _pos and _rot driven externally
+		if (!_scripted) handle_input();
+
+		// merge rotation and projection matrices
+		glm::aligned_mat4x4 matrix;
+		matrix = glm::perspectiveFovLH<float>(glm::radians<float>(_fov), (float)_extent.width, (float)_extent.height, _near, _far);
+		matrix = glm::rotate(matrix, - _rot.x, glm::aligned_vec3(1, 0, 0));
+		matrix = glm::rotate(matrix, - _rot.y, glm::aligned_vec3(0, 1, 0));
+		matrix = glm::translate(matrix, - _pos);
+		
+		// upload data into the buffer of the frame being recorded
+		_buffers[frame_i].write(vmalloc, matrix);
+		_moved = matrix != _matrix;
+		_matrix = matrix;
+	}
+	// world space position of a window position at the given depth, using the latest matrix
+	auto unproject(glm::vec2 position, float depth) const -> glm::vec3 {
+		glm::vec2 ndc = position / glm::vec2(_extent.width, _extent.height) * 2.0f - 1.0f;
+		glm::vec4 world = glm::inverse(glm::mat4(_matrix)) * glm::vec4(ndc, depth, 1.0f);
+		return glm::vec3(world) / world.w;
+	}
+	void handle_input() {
 		// read input for movement and rotation
 		float speed = 0.05;
 		if (Keys::held(Keys::eLeftCtrl)) speed /= 4.0;
@@ -43,23 +72,16 @@ export struct Camera {
 		if (Mouse::relative()) {
 			_rot += glm::aligned_vec3(-Mouse::delta().y, +Mouse::delta().x, 0) * 0.003f;
 		}
-
-		// merge rotation and projection matrices
-		glm::aligned_mat4x4 matrix;
-		matrix = glm::perspectiveFovLH<float>(glm::radians<float>(_fov), (float)_extent.width, (float)_extent.height, _near, _far);
-		matrix = glm::rotate(matrix, - _rot.x, glm::aligned_vec3(1, 0, 0));
-		matrix = glm::rotate(matrix, - _rot.y, glm::aligned_vec3(0, 1, 0));
-		matrix = glm::translate(matrix, - _pos);
-		
-		// upload data
-		_buffer.write(vmalloc, matrix);
 	}
 
 	glm::aligned_vec3 _pos = { 0, 0, 0 };
 	glm::aligned_vec3 _rot = { 0, 0, 0 };
-	DeviceBuffer _buffer;
+	std::vector<DeviceBuffer> _buffers;
+	glm::aligned_mat4x4 _matrix; // most recently uploaded
+	bool _moved = true; // matrix changed with the last update
 	vk::Extent2D _extent;
 	float _fov = 60;
 	float _near = 0.01;
 	float _far = 1000.0;
+	bool _scripted = false;
 };
\ No newline at end of file
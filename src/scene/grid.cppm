@@ -5,70 +5,106 @@ import std;
 import vulkan.allocator;
 import buffers.mesh;
 import cme.datasets;
+import core.trace;
+import core.parallel;
 
 export struct Grid {
+    typedef uint32_t Index;
+    typedef std::pair<glm::vec3, float> QueryPoint;
+    struct Header {
+        float voxel_size;
+        std::size_t query_point_count;
+        std::size_t cell_count;
+    };
+    // binary records following the header
+    static constexpr std::size_t header_size = sizeof(float) + 2 * sizeof(std::size_t);
+    static constexpr std::size_t query_point_stride = sizeof(glm::vec3) + sizeof(float);
+    static constexpr std::size_t cell_stride = 8 * sizeof(Index);
+    static constexpr std::size_t indices_per_cell = 18; // two closed strips and the missing edges
+
     void init(vma::Allocator vmalloc, std::string_view path_rel) {
-		std::ifstream file;
+        Trace::Zone zone("Grid::init");
         std::string path_full = path_rel.data();
-		file.open(path_full, std::ifstream::binary);
-        if (file.good()) {
-            // read header
-            float voxelsize = 0;
-            std::size_t query_points_n = 0;
-            std::size_t cells_n = 0;
-			file.read(reinterpret_cast<char*>(&voxelsize), sizeof(float));
-			file.read(reinterpret_cast<char*>(&query_points_n), sizeof(std::size_t));
-			file.read(reinterpret_cast<char*>(&cells_n), sizeof(std::size_t));
-            
-			// alloc and read query points
-			std::vector<QueryPoint> query_points;
-            query_points.reserve(query_points_n);
-            for (std::size_t i = 0; i < query_points_n; i++) {
+		std::ifstream file(path_full, std::ifstream::binary | std::ifstream::ate);
+        if (!file.good()) {
+            std::println("unable to read grid: {}", path_full);
+            return;
+        }
+        // read whole file at once, then decode in parallel
+        std::vector<std::byte> data((std::size_t)file.tellg());
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        file.close();
+
+        std::vector<QueryPoint> query_points;
+        std::vector<Index> cell_indices;
+        if (!parse(data, query_points, cell_indices, Parallel::default_thread_count())) {
+            std::println("corrupted grid: {}", path_full);
+            return;
+        }
+        _query_points.init(vmalloc, query_points, cell_indices);
+    }
+    void destroy(vma::Allocator vmalloc) {
+		_query_points.destroy(vmalloc);
+    }
+
+    // CPU-only loading stages, separated to be measurable without a device
+    // read header and validate that all records fit, nullopt if truncated
+    static auto parse_header(std::span<const std::byte> data) -> std::optional<Header> {
+        if (data.size() < header_size) return std::nullopt;
+        Header header;
+        std::memcpy(&header.voxel_size, data.data(), sizeof(float));
+        std::memcpy(&header.query_point_count, data.data() + sizeof(float), sizeof(std::size_t));
+        std::memcpy(&header.cell_count, data.data() + sizeof(float) + sizeof(std::size_t), sizeof(std::size_t));
+        if (header.query_point_count > data.size() || header.cell_count > data.size()) return std::nullopt;
+        std::size_t body_size = header.query_point_count * query_point_stride + header.cell_count * cell_stride;
+        if (data.size() - header_size < body_size) return std::nullopt;
+        return header;
+    }
+    // swap y with z, flip y and normalize signed distances by voxel size
+    static void decode_query_points(const std::byte* records_p, float voxel_size, std::span<QueryPoint> query_points, uint32_t thread_count = 1) {
+        Parallel::for_range(query_points.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
                 glm::vec3 position;
-				float signed_distance;
-				file.read(reinterpret_cast<char*>(&position), sizeof(glm::vec3));
-				file.read(reinterpret_cast<char*>(&signed_distance), sizeof(float));
+                float signed_distance;
+                std::memcpy(&position, records_p + i * query_point_stride, sizeof(glm::vec3));
+                std::memcpy(&signed_distance, records_p + i * query_point_stride + sizeof(glm::vec3), sizeof(float));
                 std::swap(position.y, position.z);
                 position.y *= -1.0;
-                query_points.emplace_back(position, signed_distance * (1.0f / voxelsize));
+                query_points[i] = { position, signed_distance * (1.0f / voxel_size) };
             }
-            // alloc and read cells (indexing into query points)
-            std::vector<Index> cell_indices;
-            cell_indices.reserve(cells_n * 8); // TODO: multiply with indices per cell
-            for (std::size_t i = 0; i < cells_n; i++) {
-                std::array<Index, 8> cell;
-				file.read(reinterpret_cast<char*>(cell.data()), sizeof(cell));
-                // build cell edge via line strip indices
-                // front side
-                cell_indices.insert(cell_indices.end(), cell.cbegin() + 0, cell.cbegin() + 4);
-                cell_indices.push_back(cell[0]);
-                // back side
-                cell_indices.insert(cell_indices.end(), cell.cbegin() + 4, cell.cbegin() + 8);
-                cell_indices.push_back(cell[4]);
-                cell_indices.push_back(std::numeric_limits<Index>().max()); // restart strip
-                // missing edges
-                cell_indices.push_back(cell[3]);
-                cell_indices.push_back(cell[7]);
-                cell_indices.push_back(cell[6]);
-                cell_indices.push_back(cell[2]);
-                cell_indices.push_back(cell[1]);
-                cell_indices.push_back(cell[5]);
-                cell_indices.push_back(std::numeric_limits<Index>().max()); // restart strip
+        });
+    }
+    // build cell edges via line strip indices into the query points
+    static void expand_cells(const std::byte* records_p, std::span<Index> cell_indices, uint32_t thread_count = 1) {
+        constexpr Index restart = std::numeric_limits<Index>().max();
+        Parallel::for_range(cell_indices.size() / indices_per_cell, thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                std::array<Index, 8> c;
+                std::memcpy(c.data(), records_p + i * cell_stride, sizeof(c));
+                std::array<Index, indices_per_cell> strips {
+                    c[0], c[1], c[2], c[3], c[0], // front side
+                    c[4], c[5], c[6], c[7], c[4], // back side
+                    restart,
+                    c[3], c[7], c[6], c[2], c[1], c[5], // missing edges
+                    restart,
+                };
+                std::copy(strips.cbegin(), strips.cend(), cell_indices.begin() + i * indices_per_cell);
             }
-			_query_points.init(vmalloc, query_points, cell_indices);
-
-            file.close();
-        }
-        else {
-            std::println("unable to read grid: {}", path_full);
-        }
+        });
     }
-    void destroy(vma::Allocator vmalloc) {
-		_query_points.destroy(vmalloc);
+    // full parse of a file in memory, false if it is truncated
+    static auto parse(std::span<const std::byte> data, std::vector<QueryPoint>& query_points, std::vector<Index>& cell_indices, uint32_t thread_count = 1) -> bool {
+        auto header = parse_header(data);
+        if (!header.has_value()) return false;
+        const std::byte* query_points_p = data.data() + header_size;
+        const std::byte* cells_p = query_points_p + header->query_point_count * query_point_stride;
+        query_points.resize(header->query_point_count);
+        cell_indices.resize(header->cell_count * indices_per_cell);
+        decode_query_points(query_points_p, header->voxel_size, query_points, thread_count);
+        expand_cells(cells_p, cell_indices, thread_count);
+        return true;
     }
-    
-public:
-    typedef uint32_t Index;
-    typedef std::pair<glm::vec3, float> QueryPoint;
+
     Mesh<QueryPoint, Index> _query_points; // indexed line list
 };
\ No newline at end of file
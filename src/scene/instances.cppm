@@ -0,0 +1,228 @@
+module;
+#include <glm/glm.hpp>
+export module scene.instances;
+import std;
+import vulkan_hpp;
+import vulkan.allocator;
+import buffers.mesh;
+import buffers.device;
+import scene.plymesh;
+import scene.bvh;
+import core.trace;
+
+// many meshes packed into one vertex and index buffer, each drawn by any number of instances
+// instances carry their own transform and color, both tables live in storage buffers for GPU culling
+export struct MeshInstances {
+    using Vertex = Plymesh::Vertex;
+    using Index = Plymesh::Index;
+    // std430 layouts matching culling/instances.comp and defaults/default.vert
+    struct MeshRange {
+        glm::vec4 bounds; // local bounding sphere, center and radius
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        uint32_t _padding;
+    };
+    struct Instance {
+        glm::mat4 transform;
+        glm::vec4 color;
+        uint32_t mesh_i;
+        std::array<uint32_t, 3> _padding;
+    };
+    static_assert(sizeof(MeshRange) == 32 && sizeof(Instance) == 96, "layout must match the shaders");
+    // nearest surface along a ray or around a point, in world space
+    struct SurfaceHit {
+        glm::vec3 position;
+        float distance;
+        uint32_t instance_i;
+        uint32_t face; // triangle index within its mesh
+    };
+
+    // append geometry, returns its mesh index for add_instance()
+    // pickable meshes keep a BVH over their triangles on the CPU for raycast() and closest_point()
+    auto add_mesh(std::span<const Vertex> vertices, std::span<const Index> indices, bool pickable = true) -> uint32_t {
+        _meshes.push_back({
+            .bounds = get_bounds(vertices),
+            .first_index = _index_count,
+            .index_count = (uint32_t)indices.size(),
+            .vertex_offset = (int32_t)_vertex_count,
+        });
+        _vertex_count += (uint32_t)vertices.size();
+        _index_count += (uint32_t)indices.size();
+        _vertices.insert(_vertices.end(), vertices.begin(), vertices.end());
+        _indices.insert(_indices.end(), indices.begin(), indices.end());
+        _bvhs.emplace_back();
+        if (pickable) _bvhs.back().build(vertices, indices);
+        return (uint32_t)_meshes.size() - 1;
+    }
+    // bounding sphere around the center of the bounding box
+    static auto get_bounds(std::span<const Vertex> vertices) -> glm::vec4 {
+        glm::vec3 min { std::numeric_limits<float>::max() };
+        glm::vec3 max { std::numeric_limits<float>::lowest() };
+        for (auto& vertex: vertices) {
+            min = glm::min(min, vertex.pos);
+            max = glm::max(max, vertex.pos);
+        }
+        glm::vec3 center = vertices.empty() ? glm::vec3(0) : (min + max) * 0.5f;
+        float radius = 0.0f;
+        for (auto& vertex: vertices) radius = std::max(radius, glm::distance(center, vertex.pos));
+        return glm::vec4(center, radius);
+    }
+    auto add_instance(uint32_t mesh_i, const glm::mat4& transform, glm::vec4 color = glm::vec4(1)) -> uint32_t {
+        _instances.push_back({ .transform = transform, .color = color, .mesh_i = mesh_i });
+        return (uint32_t)_instances.size() - 1;
+    }
+    // create the GPU buffers from everything added since clear(), the pending geometry is released afterwards
+    // existing buffers are replaced, so none of them may be in use
+    void upload(vma::Allocator vmalloc) {
+        Trace::Zone zone("MeshInstances::upload");
+        // released geometry can't be uploaded again, mesh ranges would point past the new buffers
+        if (_vertices.size() != _vertex_count || _indices.size() != _index_count) {
+            std::println("Mesh geometry was already uploaded, clear() before adding meshes again");
+            return;
+        }
+        destroy(vmalloc);
+        if (_vertices.empty() || _instances.empty()) return;
+        _geometry.init(vmalloc, _vertices, _indices);
+        _vertices = {};
+        _indices = {};
+        init_tables(vmalloc, (uint32_t)_meshes.size(), (uint32_t)_instances.size());
+        _uploaded = true;
+        _version++;
+    }
+    // replace the mesh and instance tables with ones holding at least the given number of entries, creating them if none exist
+    // the geometry is left as is, neither table may be in use
+    void reserve(vma::Allocator vmalloc, uint32_t mesh_capacity, uint32_t instance_capacity) {
+        if (_mesh_capacity > 0) {
+            if (mesh_capacity <= _mesh_capacity && instance_capacity <= _instance_capacity) return;
+            _mesh_buffer.destroy(vmalloc);
+            _instance_buffer.destroy(vmalloc);
+        }
+        init_tables(vmalloc, std::max(mesh_capacity, _mesh_capacity), std::max(instance_capacity, _instance_capacity));
+        _version++;
+    }
+    // rewrite transforms and colors after changing _instances, the count needs to stay the same
+    void update_instances(vma::Allocator vmalloc) {
+        _instance_buffer.write(vmalloc, _instances.data(), sizeof(Instance) * _instances.size());
+    }
+    // rewrite single entries after changing them, appended ones need to fit the reserved capacity
+    void update_instance(vma::Allocator vmalloc, uint32_t instance_i) {
+        _instance_buffer.write(vmalloc, &_instances[instance_i], sizeof(Instance), sizeof(Instance) * instance_i);
+    }
+    void update_mesh(vma::Allocator vmalloc, uint32_t mesh_i) {
+        _mesh_buffer.write(vmalloc, &_meshes[mesh_i], sizeof(MeshRange), sizeof(MeshRange) * mesh_i);
+    }
+    void destroy(vma::Allocator vmalloc) {
+        if (!_uploaded) return;
+        _geometry.destroy(vmalloc);
+        _mesh_buffer.destroy(vmalloc);
+        _instance_buffer.destroy(vmalloc);
+        _mesh_capacity = 0;
+        _instance_capacity = 0;
+        _uploaded = false;
+    }
+    // drop meshes and instances, GPU buffers are kept until the next upload
+    void clear() {
+        _vertices.clear();
+        _indices.clear();
+        _vertex_count = 0;
+        _index_count = 0;
+        _meshes.clear();
+        _instances.clear();
+        _bvhs.clear();
+    }
+    // nearest pickable surface hit by the ray, direction needs to be normalized
+    auto raycast(glm::vec3 origin, glm::vec3 direction, float max_distance = std::numeric_limits<float>::max()) const -> std::optional<SurfaceHit> {
+        std::optional<SurfaceHit> hit;
+        for (uint32_t instance_i = 0; instance_i < _instances.size(); instance_i++) {
+            const Instance& instance = _instances[instance_i];
+            const Bvh& bvh = _bvhs[instance.mesh_i];
+            if (bvh.empty()) continue;
+            // skip instances whose bounding sphere lies off the ray or behind the current hit
+            auto [center, radius] = get_sphere(instance);
+            float t_center = glm::dot(center - origin, direction);
+            glm::vec3 offset = origin + direction * t_center - center;
+            if (glm::dot(offset, offset) > radius * radius || t_center + radius < 0.0f || t_center - radius > max_distance) continue;
+
+            // an unnormalized local direction keeps distances along the ray in world units
+            glm::mat4 inverse = glm::inverse(instance.transform);
+            glm::vec3 local_origin = inverse * glm::vec4(origin, 1.0f);
+            glm::vec3 local_direction = glm::mat3(inverse) * direction;
+            auto bvh_hit = bvh.intersect(local_origin, local_direction, max_distance);
+            if (!bvh_hit.has_value()) continue;
+            max_distance = bvh_hit->t;
+            hit = SurfaceHit { .position = origin + direction * bvh_hit->t, .distance = bvh_hit->t, .instance_i = instance_i, .face = bvh_hit->face };
+        }
+        return hit;
+    }
+    // nearest point on any pickable surface, exact for transforms without non-uniform scaling
+    auto closest_point(glm::vec3 point, float max_distance = std::numeric_limits<float>::max()) const -> std::optional<SurfaceHit> {
+        std::optional<SurfaceHit> hit;
+        for (uint32_t instance_i = 0; instance_i < _instances.size(); instance_i++) {
+            const Instance& instance = _instances[instance_i];
+            const Bvh& bvh = _bvhs[instance.mesh_i];
+            if (bvh.empty()) continue;
+            auto [center, radius] = get_sphere(instance);
+            if (glm::distance(center, point) - radius > max_distance) continue;
+
+            // local distances shrink by at most the smallest axis scale
+            glm::mat4 inverse = glm::inverse(instance.transform);
+            glm::vec3 local_point = inverse * glm::vec4(point, 1.0f);
+            float scale_min = std::min(glm::length(glm::vec3(instance.transform[0])), std::min(glm::length(glm::vec3(instance.transform[1])), glm::length(glm::vec3(instance.transform[2]))));
+            float local_max = max_distance < std::numeric_limits<float>::max() ? max_distance / scale_min : max_distance;
+            auto closest = bvh.closest_point(local_point, local_max);
+            if (!closest.has_value()) continue;
+            glm::vec3 position = instance.transform * glm::vec4(closest->point, 1.0f);
+            float distance = glm::distance(position, point);
+            if (distance > max_distance) continue;
+            max_distance = distance;
+            hit = SurfaceHit { .position = position, .distance = distance, .instance_i = instance_i, .face = closest->face };
+        }
+        return hit;
+    }
+    auto instance_count() -> uint32_t { return _uploaded ? (uint32_t)_instances.size() : 0; }
+    // entries the instance buffer holds, per-instance buffers of the renderer are sized to match
+    auto instance_capacity() -> uint32_t { return _uploaded ? _instance_capacity : 0; }
+    // world space bounding sphere of an instance, matching the culling shader
+    auto get_sphere(const Instance& instance) const -> std::pair<glm::vec3, float> {
+        glm::vec4 bounds = _meshes[instance.mesh_i].bounds;
+        glm::vec3 center = instance.transform * glm::vec4(glm::vec3(bounds), 1.0f);
+        float scale = std::max(glm::length(glm::vec3(instance.transform[0])), std::max(glm::length(glm::vec3(instance.transform[1])), glm::length(glm::vec3(instance.transform[2]))));
+        return { center, bounds.w * scale };
+    }
+
+    std::vector<MeshRange> _meshes;
+    std::vector<Instance> _instances;
+    std::vector<Bvh> _bvhs; // per mesh, empty unless pickable
+    Mesh<Vertex, Index> _geometry;
+    DeviceBuffer _mesh_buffer;
+    DeviceBuffer _instance_buffer;
+    uint32_t _version = 0; // incremented with every upload, buffers need to be registered again
+    uint32_t _mesh_capacity = 0;
+    uint32_t _instance_capacity = 0;
+    bool _uploaded = false;
+
+private:
+    void init_tables(vma::Allocator vmalloc, uint32_t mesh_capacity, uint32_t instance_capacity) {
+        _mesh_buffer.init({
+            .vmalloc = vmalloc,
+            .size = sizeof(MeshRange) * std::max(mesh_capacity, 1u),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+        });
+        if (!_meshes.empty()) _mesh_buffer.write(vmalloc, _meshes.data(), sizeof(MeshRange) * _meshes.size());
+        _instance_buffer.init({
+            .vmalloc = vmalloc,
+            .size = sizeof(Instance) * std::max(instance_capacity, 1u),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+        });
+        if (!_instances.empty()) update_instances(vmalloc);
+        _mesh_capacity = std::max(mesh_capacity, 1u);
+        _instance_capacity = std::max(instance_capacity, 1u);
+    }
+
+    std::vector<Vertex> _vertices; // pending upload
+    std::vector<Index> _indices;
+    // geometry added since clear(), mesh ranges keep counting past what was already uploaded
+    uint32_t _vertex_count = 0;
+    uint32_t _index_count = 0;
+};
\ No newline at end of file
@@ -6,112 +6,125 @@ import std;
 import vulkan.allocator;
 import buffers.mesh;
 import cme.datasets;
+import core.trace;
+import core.parallel;
 
 export struct Plymesh {
+    struct Vertex {
+        glm::vec3 pos;
+        glm::vec3 norm;
+        glm::vec3 color;
+    };
+    typedef uint32_t Index;
+    struct Header {
+        std::size_t vertex_count;
+        std::size_t face_count;
+        std::size_t body_offset; // bytes from the start of the file
+    };
+    // binary little endian records following the header
+    typedef std::pair<glm::vec3, glm::vec3> RawVertex;
+    static constexpr std::size_t face_stride = sizeof(uint8_t) + 3 * sizeof(int32_t);
+
     void init(vma::Allocator vmalloc, std::string_view path_rel, std::optional<glm::vec3> color = std::nullopt) {
+        Trace::Zone zone("Plymesh::init");
+        std::vector<Vertex> vertices;
+        std::vector<Index> indices;
+        if (!load(path_rel, color, vertices, indices)) return;
+        
+        // create actual mesh from raw data
+        _mesh.init(vmalloc, vertices, indices);
+    }
+    // read dataset into CPU memory, false if it is malformed
+    static auto load(std::string_view path_rel, std::optional<glm::vec3> color, std::vector<Vertex>& vertices, std::vector<Index>& indices) -> bool {
         // if it does not exist, simply quit (no point in going further)
         auto [asset, exists] = datasets::try_load(path_rel);
         if (!exists) {
             std::println("Plymesh not found: {}", path_rel);
             exit(0);
         }
+        if (!parse(asset._data, color, vertices, indices, Parallel::default_thread_count())) {
+            std::println("corrupted header for {}", path_rel);
+            return false;
+        }
+        return true;
+    }
 
-        // validate header
-        std::string line;
-        const uint8_t* it = asset._data;
-        while (*it != '\n') line.push_back(*it++);
-        it++;
-        if (line != "ply") std::println("corrupted header for {}", path_rel);
+    // CPU-only loading stages, separated to be measurable without a device
+    // validate header and locate the body, nullopt if malformed
+    static auto parse_header(const uint8_t* data_p) -> std::optional<Header> {
+        const uint8_t* it = data_p;
+        auto read_line = [&it]() {
+            const uint8_t* line_p = it;
+            while (*it != '\n') it++;
+            return std::string_view(reinterpret_cast<const char*>(line_p), (std::size_t)(it++ - line_p));
+        };
+        auto read_count = [](std::string_view line) {
+            std::size_t count = 0;
+            std::size_t str_pos = line.find_last_of(' ');
+            if (str_pos != std::string_view::npos) std::from_chars(line.data() + str_pos + 1, line.data() + line.size(), count);
+            return count;
+        };
 
+        Header header;
+        if (read_line() != "ply") return std::nullopt;
         // ignoring format for now
-        while (*it != '\n') it++;
-        it++;
-
+        read_line();
         // element vertex N
-        line.clear();
-        while (*it != '\n') line.push_back(*it++);
-        it++;
-        size_t str_pos = line.find_last_of(' ');
-        std::string vert_n_str = line.substr(str_pos + 1, line.size() - str_pos);
-        size_t vert_n = std::stoi(vert_n_str);
-
-        // skip parsing vertex contents for now
-        for (size_t i = 0; i < 6; i++) {
-            while (*it != '\n') it++;
-            it++;
-        }
-
+        header.vertex_count = read_count(read_line());
+        // skip parsing vertex properties for now
+        for (size_t i = 0; i < 6; i++) read_line();
         // element face N
-        line.clear();
-        while (*it != '\n') line.push_back(*it++);
-        it++;
-        str_pos = line.find_last_of(' ');
-        std::string face_n_str = line.substr(str_pos + 1, line.size() - str_pos);
-        size_t face_n = std::stoi(face_n_str);
-
+        header.face_count = read_count(read_line());
         // skip face properties
-        while (*it != '\n') it++;
-        it++;
-
-        // validate header end
-        line.clear();
-        while (*it != '\n') line.push_back(*it++);
-        it++;
-        if (line != "end_header") std::println("missing/unexpected header end for {}", path_rel);
-
-        // read little endian vertices
-        typedef std::pair<glm::vec3, glm::vec3> RawVertex;
-        auto beg = reinterpret_cast<const RawVertex*>(it);
-        it += sizeof(RawVertex) * vert_n;
-        auto end = reinterpret_cast<const RawVertex*>(it);
-        std::vector<RawVertex> raw_vertices{ beg, end };
-
-        // read little endian faces into indices
-        std::vector<uint32_t> raw_indices;
-        raw_indices.reserve(face_n * 3);
-        for (size_t face_i = 0; face_i < face_n; face_i++) {
-            // skip the number of face indices (single uint8_t)
-            it++;
-
-            // read 3 face indices into vector
-            for (size_t i = 0; i < 3; i++) {
-                const int* index_p = reinterpret_cast<const int*>(it);
-                it += sizeof(int);
-                raw_indices.push_back(*index_p);
+        read_line();
+        if (read_line() != "end_header") return std::nullopt;
+        header.body_offset = (std::size_t)(it - data_p);
+        return header;
+    }
+    // flip y and swap y with z
+    static void convert_vertices(const uint8_t* raw_p, std::optional<glm::vec3> color, std::span<Vertex> vertices, uint32_t thread_count = 1) {
+        Parallel::for_range(vertices.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                // records are not necessarily aligned within the file
+                RawVertex vertex;
+                std::memcpy(&vertex, raw_p + i * sizeof(RawVertex), sizeof(RawVertex));
+                glm::vec3 pos { vertex.first.x, -vertex.first.z, vertex.first.y };
+                glm::vec3 norm { vertex.second.x, -vertex.second.z, vertex.second.y };
+                glm::vec3 col = color.has_value() ? color.value() : vertex.second;
+                vertices[i] = { pos, norm, col };
             }
-        }
-
-        // flip y and swap y with z and insert into full vertex vector
-        std::vector<Vertex> vertices;
-        vertices.reserve(vert_n);
-        for (auto& vertex: raw_vertices) {
-            glm::vec3 pos { vertex.first.x, -vertex.first.z, vertex.first.y };
-            glm::vec3 norm { vertex.second.x, -vertex.second.z, vertex.second.y };
-            glm::vec3 col = color.has_value() ? glm::vec4(color.value(), 1) : vertex.second;
-            vertices.emplace_back(pos, norm, col);
-        }
-
-        // convert raw indices to Index type
-        std::vector<Index> indices;
-        indices.resize(raw_indices.size());
-        for (size_t i = 0; i < raw_indices.size(); i++) {
-            indices[i] = (Index)raw_indices[i];
-        }
-        
-        // create actual mesh from raw data
+        });
+    }
+    // read triangle faces into Index type, skipping each face's index count
+    static void convert_faces(const uint8_t* faces_p, std::span<Index> indices, uint32_t thread_count = 1) {
+        Parallel::for_range(indices.size() / 3, thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t face_i = begin; face_i < end; face_i++) {
+                std::array<int32_t, 3> face;
+                std::memcpy(face.data(), faces_p + face_i * face_stride + sizeof(uint8_t), sizeof(face));
+                for (size_t i = 0; i < 3; i++) indices[face_i * 3 + i] = (Index)face[i];
+            }
+        });
+    }
+    // full parse of a file in memory, false if the header is malformed
+    static auto parse(const uint8_t* data_p, std::optional<glm::vec3> color, std::vector<Vertex>& vertices, std::vector<Index>& indices, uint32_t thread_count = 1) -> bool {
+        auto header = parse_header(data_p);
+        if (!header.has_value()) return false;
+        const uint8_t* vertices_p = data_p + header->body_offset;
+        const uint8_t* faces_p = vertices_p + header->vertex_count * sizeof(RawVertex);
+        vertices.resize(header->vertex_count);
+        indices.resize(header->face_count * 3);
+        convert_vertices(vertices_p, color, vertices, thread_count);
+        convert_faces(faces_p, indices, thread_count);
+        return true;
+    }
+    // create from geometry generated in memory
+    void init(vma::Allocator vmalloc, std::span<Vertex> vertices, std::span<Index> indices) {
+        Trace::Zone zone("Plymesh::init");
         _mesh.init(vmalloc, vertices, indices);
-        
-        // TODO: validate iterator before performing all those steps
     }
     void destroy(vma::Allocator vmalloc) {
         _mesh.destroy(vmalloc);
     }
 
-    struct Vertex {
-        glm::vec3 pos;
-        glm::vec3 norm;
-        glm::vec3 color;
-    };
-    typedef uint32_t Index;
     Mesh<Vertex, Index> _mesh;
 };
\ No newline at end of file
@@ -0,0 +1,187 @@
+module;
+#include <glm/glm.hpp>
+#include <cme/detail/asset.hpp>
+export module scene.pointcloud;
+import std;
+import vulkan_hpp;
+import vulkan.allocator;
+import buffers.device;
+import cme.datasets;
+import core.trace;
+import core.parallel;
+
+// vertex-only PLY files, drawn by the compute point rasterizer instead of as triangles
+export struct PointCloud {
+    // std430 layout matching points/rasterize.comp
+    struct Point {
+        glm::vec3 pos;
+        uint32_t color; // rgba8
+    };
+    static_assert(sizeof(Point) == 16, "layout must match the shaders");
+    // binary little endian vertex property, any others are skipped over
+    struct Property {
+        uint32_t offset; // bytes from the start of the record
+        uint32_t size;
+        bool floating;
+    };
+    struct Header {
+        std::size_t vertex_count;
+        std::size_t vertex_stride;
+        std::size_t face_count;
+        std::size_t body_offset; // bytes from the start of the file
+        std::array<std::optional<Property>, 3> position;
+        std::array<std::optional<Property>, 3> color;
+    };
+
+    // read dataset into CPU memory, false if it is malformed or has no positions
+    static auto load(std::string_view path_rel, std::vector<Point>& points) -> bool {
+        Trace::Zone zone("PointCloud::load");
+        auto [asset, exists] = datasets::try_load(path_rel);
+        if (!exists) {
+            std::println("Point cloud not found: {}", path_rel);
+            return false;
+        }
+        auto header = parse_header(asset._data);
+        if (!header.has_value()) {
+            std::println("Unsupported point cloud header for {}", path_rel);
+            return false;
+        }
+        if (header->face_count > 0) std::println("Ignoring {} faces of {}", header->face_count, path_rel);
+        points.resize(header->vertex_count);
+        convert_points(asset._data + header->body_offset, *header, points, Parallel::default_thread_count());
+        return true;
+    }
+    // vertex element with its property layout, nullopt unless it is binary little endian with x, y and z
+    static auto parse_header(const uint8_t* data_p) -> std::optional<Header> {
+        const uint8_t* it = data_p;
+        auto read_line = [&it]() {
+            const uint8_t* line_p = it;
+            while (*it != '\n') it++;
+            std::string_view line(reinterpret_cast<const char*>(line_p), (std::size_t)(it++ - line_p));
+            // tolerate CRLF line endings
+            if (line.ends_with('\r')) line.remove_suffix(1);
+            return line;
+        };
+        auto split = [](std::string_view line) {
+            std::vector<std::string_view> words;
+            for (auto word: std::views::split(line, ' ')) {
+                if (!word.empty()) words.emplace_back(word.begin(), word.end());
+            }
+            return words;
+        };
+        auto type_size = [](std::string_view type) -> uint32_t {
+            if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+            if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+            if (type == "int" || type == "uint" || type == "int32" || type == "uint32" || type == "float" || type == "float32") return 4;
+            if (type == "double" || type == "float64") return 8;
+            return 0;
+        };
+
+        if (read_line() != "ply") return std::nullopt;
+        if (read_line() != "format binary_little_endian 1.0") return std::nullopt;
+        Header header {};
+        std::string_view element;
+        for (std::string_view line = read_line(); line != "end_header"; line = read_line()) {
+            auto words = split(line);
+            if (words.empty() || words[0] == "comment" || words[0] == "obj_info") continue;
+            std::size_t count = 0;
+            if (words[0] == "element" && words.size() == 3) {
+                element = words[1];
+                std::from_chars(words[2].data(), words[2].data() + words[2].size(), count);
+                if (element == "vertex") header.vertex_count = count;
+                else if (element == "face") header.face_count = count;
+                // vertices need to come first for the body offset to hold
+                else if (header.vertex_count == 0) return std::nullopt;
+            }
+            else if (words[0] == "property" && element == "vertex") {
+                // lists have no fixed stride
+                if (words.size() != 3) return std::nullopt;
+                uint32_t size = type_size(words[1]);
+                if (size == 0) return std::nullopt;
+                Property property {
+                    .offset = (uint32_t)header.vertex_stride,
+                    .size = size,
+                    .floating = words[1].starts_with("float") || words[1] == "double",
+                };
+                std::string_view name = words[2];
+                if (name == "x") header.position[0] = property;
+                else if (name == "y") header.position[1] = property;
+                else if (name == "z") header.position[2] = property;
+                else if (name == "red" || name == "r") header.color[0] = property;
+                else if (name == "green" || name == "g") header.color[1] = property;
+                else if (name == "blue" || name == "b") header.color[2] = property;
+                header.vertex_stride += size;
+            }
+        }
+        for (auto& property: header.position) {
+            if (!property.has_value() || !property->floating) return std::nullopt;
+        }
+        header.body_offset = (std::size_t)(it - data_p);
+        return header;
+    }
+    // flip y and swap y with z like Plymesh, colors are normalized to rgba8 or grey if absent
+    static void convert_points(const uint8_t* body_p, const Header& header, std::span<Point> points, uint32_t thread_count = 1) {
+        auto read = [](const uint8_t* record_p, const Property& property) -> double {
+            const uint8_t* value_p = record_p + property.offset;
+            switch (property.size) {
+                case 1: return (double)*value_p / 255.0;
+                case 2: { uint16_t value; std::memcpy(&value, value_p, 2); return (double)value / 65535.0; }
+                case 4: {
+                    if (!property.floating) { uint32_t value; std::memcpy(&value, value_p, 4); return (double)value; }
+                    float value; std::memcpy(&value, value_p, 4); return value;
+                }
+                case 8: { double value; std::memcpy(&value, value_p, 8); return value; }
+            }
+            return 0.0;
+        };
+        bool has_color = header.color[0].has_value() && header.color[1].has_value() && header.color[2].has_value();
+        Parallel::for_range(points.size(), thread_count, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                // records are not necessarily aligned within the file
+                const uint8_t* record_p = body_p + i * header.vertex_stride;
+                glm::vec3 pos {
+                    (float)read(record_p, *header.position[0]),
+                    (float)read(record_p, *header.position[1]),
+                    (float)read(record_p, *header.position[2]),
+                };
+                glm::vec4 color { 0.5f, 0.5f, 0.5f, 1.0f };
+                if (has_color) {
+                    for (uint32_t c = 0; c < 3; c++) color[c] = (float)read(record_p, *header.color[c]);
+                }
+                color = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+                points[i] = {
+                    .pos = { pos.x, -pos.z, pos.y },
+                    .color = (uint32_t)color.r | (uint32_t)color.g << 8 | (uint32_t)color.b << 16 | (uint32_t)color.a << 24,
+                };
+            }
+        });
+    }
+
+    // replace the GPU buffer, which may not be in use
+    void upload(vma::Allocator vmalloc, std::span<const Point> points) {
+        Trace::Zone zone("PointCloud::upload");
+        destroy(vmalloc);
+        if (points.empty()) return;
+        _buffer.init({
+            .vmalloc = vmalloc,
+            .size = sizeof(Point) * points.size(),
+            .usage = vk::BufferUsageFlagBits::eStorageBuffer,
+        });
+        _buffer.write(vmalloc, (void*)points.data(), _buffer._size);
+        _count = (uint32_t)points.size();
+        _uploaded = true;
+        _version++;
+    }
+    void destroy(vma::Allocator vmalloc) {
+        if (!_uploaded) return;
+        _buffer.destroy(vmalloc);
+        _count = 0;
+        _uploaded = false;
+    }
+    auto point_count() -> uint32_t { return _uploaded ? _count : 0; }
+
+    DeviceBuffer _buffer;
+    uint32_t _count = 0;
+    uint32_t _version = 0; // incremented with every upload, the buffer needs to be registered again
+    bool _uploaded = false;
+};
\ No newline at end of file
@@ -1,24 +1,42 @@
 module;
 #include <glm/glm.hpp>
 module scene.scene;
+import core.jobs;
 
-void Scene::init(vma::Allocator vmalloc) {
-    _camera.init(vmalloc);
+void Scene::init(vma::Allocator vmalloc, uint32_t frame_count) {
+    _camera.init(vmalloc, frame_count);
 
-    // load mesh and grid objects
-    _mesh.init(vmalloc, "v2/mesh.ply", glm::vec3{.5, .5, .5});
+    // load meshes and grid objects, the mesh is parsed as a job while this thread reads the points
+    std::vector<Plymesh::Vertex> vertices;
+    std::vector<Plymesh::Index> indices;
+    bool mesh_loaded = false;
+    Jobs::Handle mesh_job = Jobs::get().submit([&]() {
+        mesh_loaded = Plymesh::load("v2/mesh.ply", glm::vec3{.5, .5, .5}, vertices, indices);
+    });
+    std::vector<PointCloud::Point> points;
+    bool points_loaded = !_points_path.empty() && PointCloud::load(_points_path, points);
+    Jobs::get().wait(mesh_job);
+    if (mesh_loaded) {
+        uint32_t mesh_i = _instances.add_mesh(vertices, indices);
+        _instances.add_instance(mesh_i, glm::mat4(1));
+    }
+    _instances.upload(vmalloc);
+    if (points_loaded) _points.upload(vmalloc, points);
+    if (!_stream_path.empty()) _stream.init(_stream_path, frame_count);
     // _grid.init(vmalloc, "v2/hashgrid.grid");
 }
 void Scene::destroy(vma::Allocator vmalloc) {
     _camera.destroy(vmalloc);
 
     // delete mesh and grid objects
-    _mesh.destroy(vmalloc);
+    _stream.destroy();
+    _instances.destroy(vmalloc);
+    _points.destroy(vmalloc);
     // _grid.destroy(vmalloc);
 }
-void Scene::update_safe() {
-    
+void Scene::update_safe(Device& device) {
+    if (_stream.apply(device, _instances)) _dirty = true;
 }
-void Scene::update_unsafe(vma::Allocator vmalloc) {
-    _camera.update(vmalloc);
+void Scene::update_unsafe(vma::Allocator vmalloc, uint32_t frame_i) {
+    _camera.update(vmalloc, frame_i);
 }
\ No newline at end of file
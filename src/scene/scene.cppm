@@ -1,19 +1,29 @@
 export module scene.scene;
+import std;
 import vulkan.allocator;
+import core.device;
 import scene.grid;
 import scene.camera;
 import scene.plymesh;
+import scene.instances;
+import scene.pointcloud;
+import scene.stream;
 
 export struct Scene {
-    void init(vma::Allocator vmalloc);
+    void init(vma::Allocator vmalloc, uint32_t frame_count);
     void destroy(vma::Allocator vmalloc);
 
     // update without affecting current frames in flight
-    void update_safe();
-    // update after buffers are no longer being read
-    void update_unsafe(vma::Allocator vmalloc);
+    void update_safe(Device& device);
+    // update per-frame buffers after they are no longer being read
+    void update_unsafe(vma::Allocator vmalloc, uint32_t frame_i);
 
     Camera _camera;
-    Plymesh _mesh;
+    MeshInstances _instances;
+    PointCloud _points;
+    std::string _points_path; // dataset of face-less PLY points, none if empty
+    MeshStream _stream;
+    std::string _stream_path; // file or named pipe of live mesh updates, none if empty
+    bool _dirty = true; // contents changed since the last rendered frame
     // Grid _grid;
 };
\ No newline at end of file
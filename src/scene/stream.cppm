@@ -0,0 +1,388 @@
+module;
+#include <glm/glm.hpp>
+export module scene.stream;
+import std;
+import vulkan_hpp;
+import vulkan.allocator;
+import core.device;
+import core.queue;
+import core.trace;
+import buffers.mesh;
+import scene.bvh;
+import scene.instances;
+
+// live mesh updates from a file or named pipe that another process appends to, e.g. a running reconstruction
+// the stream is a sequence of little endian records, each replacing one region of the mesh:
+//   uint32 magic "CVMR", uint32 region, uint32 vertex count, uint32 index count,
+//   then the vertices as MeshInstances::Vertex in world space, then the triangle list as uint32 indices into them
+// a record without indices removes its region. every region is a mesh with one instance, so it is culled on its own
+// geometry lives in fixed-size chunks of the scene's shared buffers, an update only writes the chunks of its region
+export struct MeshStream {
+    using Vertex = MeshInstances::Vertex;
+    using Index = MeshInstances::Index;
+    static constexpr uint32_t magic = 0x524d5643; // "CVMR"
+    static constexpr uint32_t max_count = 1 << 26; // larger counts are taken as corruption
+    static constexpr uint32_t chunk_vertices = 1024;
+    static constexpr uint32_t chunk_indices = 3 * 1024;
+    static constexpr uint32_t initial_chunks = 64;
+    struct Header {
+        uint32_t magic;
+        uint32_t region;
+        uint32_t vertex_count;
+        uint32_t index_count;
+    };
+    // received record, its bounds and BVH are prepared on the render thread when applied
+    struct Record {
+        uint32_t region;
+        std::vector<Vertex> vertices;
+        std::vector<Index> indices;
+        glm::vec4 bounds;
+        Bvh bvh;
+    };
+
+    // start reading records on a thread of its own, replaced geometry is reused once frame_count frames passed
+    void init(const std::filesystem::path& path, uint32_t frame_count);
+    // stop reading, records that were not applied yet are dropped
+    void destroy();
+    // apply all records received so far, called at a frame boundary before waiting for the upcoming frame
+    // their BVHs are built here on the job system, which the detached reader thread must not rely on
+    // only chunks and table entries no frame in flight reads are written, growing the buffers waits for the GPU to idle
+    // the scene may not be uploaded again while streaming. returns whether it changed
+    auto apply(Device& device, MeshInstances& instances) -> bool;
+    // records are waiting to be applied
+    auto pending() -> bool { return _reader_p && _reader_p->pending.load(std::memory_order_acquire) > 0; }
+
+    // invoked on the reader thread for every received record, e.g. to wake an idle render loop. set before init()
+    std::function<void()> _on_record;
+
+private:
+    // runs of consecutive chunks within a buffer
+    struct Run {
+        uint32_t first;
+        uint32_t count;
+    };
+    struct Chunks {
+        auto allocate(uint32_t count) -> std::optional<Run>;
+        // freed runs merge with adjacent free ones
+        void free(Run run);
+        // append free chunks at the end
+        void grow(uint32_t count);
+        std::vector<Run> _free; // sorted by first chunk
+        uint32_t _count = 0;
+    };
+    struct Region {
+        uint32_t instance_i;
+        uint32_t mesh_i;
+        Run vertices;
+        Run indices;
+    };
+    // replaced geometry and its mesh entry, reusable once the frames that might read them completed
+    struct Retired {
+        uint64_t frame;
+        uint32_t mesh_i;
+        Run vertices;
+        Run indices;
+    };
+    // shared with the reader thread, which is detached as it may block on a pipe whose writer stays silent
+    // it touches nothing but this state, neither the job system nor trace buffers, so outliving the engine is harmless
+    struct Reader {
+        std::filesystem::path path;
+        SpscQueue<Record, 64> queue;
+        std::atomic<uint32_t> pending = 0; // pushed or about to be, but not popped yet
+        std::atomic<bool> stop = false;
+        std::mutex mutex; // guards on_record against destroy()
+        std::function<void()> on_record;
+    };
+    static void read_loop(std::shared_ptr<Reader> reader_p);
+    // validate indices and prepare the record for picking and culling, false if it has to be dropped
+    static auto prepare(Record& record) -> bool;
+    // move the scene's geometry into growable buffers, streamed chunks start after what was uploaded before
+    void attach(Device& device, MeshInstances& instances);
+    void apply_record(Device& device, MeshInstances& instances, Record&& record);
+    // replace the geometry buffers with ones holding the additional chunks, copying the contents over on the GPU
+    void grow_geometry(Device& device, MeshInstances& instances, uint32_t vertex_chunks, uint32_t index_chunks);
+    // grow the mesh and instance tables if the latest entries do not fit
+    void reserve_tables(Device& device, MeshInstances& instances);
+    auto allocate_mesh(Device& device, MeshInstances& instances) -> uint32_t;
+    void retire(const Region& region);
+
+    std::shared_ptr<Reader> _reader_p;
+    std::unordered_map<uint32_t, Region> _regions;
+    std::vector<Retired> _retired;
+    std::vector<uint32_t> _free_meshes;
+    std::vector<uint32_t> _free_instances; // of removed regions, drawing the empty mesh meanwhile
+    Chunks _vertex_chunks;
+    Chunks _index_chunks;
+    uint32_t _vertex_base = 0; // element of the first chunk
+    uint32_t _index_base = 0;
+    uint32_t _empty_mesh = 0;
+    uint32_t _frame_count = 1;
+    uint64_t _frame = 0; // applies so far, one per rendered frame
+    bool _attached = false;
+};
+
+module: private;
+
+void MeshStream::init(const std::filesystem::path& path, uint32_t frame_count) {
+    _frame_count = frame_count;
+    _reader_p = std::make_shared<Reader>();
+    _reader_p->path = path;
+    _reader_p->on_record = _on_record;
+    std::thread(read_loop, _reader_p).detach();
+}
+void MeshStream::destroy() {
+    if (!_reader_p) return;
+    {
+        std::scoped_lock lock(_reader_p->mutex);
+        _reader_p->stop.store(true, std::memory_order_relaxed);
+        _reader_p->on_record = nullptr;
+    }
+    _reader_p.reset();
+    _regions.clear();
+    _retired.clear();
+    _free_meshes.clear();
+    _free_instances.clear();
+    _vertex_chunks = {};
+    _index_chunks = {};
+    _attached = false;
+}
+auto MeshStream::apply(Device& device, MeshInstances& instances) -> bool {
+    if (!_reader_p) return false;
+    _frame++;
+    // the upcoming wait only covers the frame frame_count before this one, later ones may still read retired geometry
+    std::erase_if(_retired, [this](const Retired& retired) {
+        if (retired.frame + _frame_count > _frame) return false;
+        _free_meshes.push_back(retired.mesh_i);
+        _vertex_chunks.free(retired.vertices);
+        _index_chunks.free(retired.indices);
+        return true;
+    });
+    if (!pending()) return false;
+
+    Trace::Zone zone("MeshStream::apply");
+    if (!_attached) attach(device, instances);
+    bool changed = false;
+    Record record;
+    while (_reader_p->queue.pop(record)) {
+        _reader_p->pending.fetch_sub(1, std::memory_order_release);
+        if (!record.indices.empty() && !prepare(record)) continue;
+        apply_record(device, instances, std::move(record));
+        changed = true;
+    }
+    return changed;
+}
+void MeshStream::attach(Device& device, MeshInstances& instances) {
+    if (instances._uploaded) {
+        _vertex_base = instances._geometry._vertices._capacity;
+        _index_base = instances._geometry._indices._capacity;
+    }
+    // removed regions keep their instance until it is reused, drawing this one meanwhile
+    _empty_mesh = instances.add_mesh({}, {}, false);
+    grow_geometry(device, instances, initial_chunks, initial_chunks);
+    reserve_tables(device, instances);
+    instances._uploaded = true;
+    _attached = true;
+}
+void MeshStream::apply_record(Device& device, MeshInstances& instances, Record&& record) {
+    vma::Allocator vmalloc = device._vmalloc;
+    auto it = _regions.find(record.region);
+    if (record.indices.empty()) {
+        if (it == _regions.end()) return;
+        Region& region = it->second;
+        instances._instances[region.instance_i].mesh_i = _empty_mesh;
+        instances.update_instance(vmalloc, region.instance_i);
+        _free_instances.push_back(region.instance_i);
+        retire(region);
+        _regions.erase(it);
+        return;
+    }
+
+    // fresh chunks for the new geometry, the region's previous ones are retired below
+    uint32_t vertex_chunks = ((uint32_t)record.vertices.size() + chunk_vertices - 1) / chunk_vertices;
+    uint32_t index_chunks = ((uint32_t)record.indices.size() + chunk_indices - 1) / chunk_indices;
+    std::optional<Run> vertices = _vertex_chunks.allocate(vertex_chunks);
+    std::optional<Run> indices = _index_chunks.allocate(index_chunks);
+    if (!vertices.has_value() || !indices.has_value()) {
+        grow_geometry(device, instances, vertices.has_value() ? 0 : vertex_chunks, indices.has_value() ? 0 : index_chunks);
+        if (!vertices.has_value()) vertices = _vertex_chunks.allocate(vertex_chunks);
+        if (!indices.has_value()) indices = _index_chunks.allocate(index_chunks);
+    }
+    uint32_t first_vertex = _vertex_base + vertices->first * chunk_vertices;
+    uint32_t first_index = _index_base + indices->first * chunk_indices;
+    instances._geometry._vertices.write(vmalloc, record.vertices, first_vertex);
+    instances._geometry._indices.write(vmalloc, record.indices, first_index);
+
+    uint32_t mesh_i = allocate_mesh(device, instances);
+    instances._meshes[mesh_i] = {
+        .bounds = record.bounds,
+        .first_index = first_index,
+        .index_count = (uint32_t)record.indices.size(),
+        .vertex_offset = (int32_t)first_vertex,
+    };
+    instances._bvhs[mesh_i] = std::move(record.bvh);
+    instances.update_mesh(vmalloc, mesh_i);
+
+    Region region { .mesh_i = mesh_i, .vertices = *vertices, .indices = *indices };
+    if (it != _regions.end()) {
+        region.instance_i = it->second.instance_i;
+        retire(it->second);
+    }
+    else if (!_free_instances.empty()) {
+        region.instance_i = _free_instances.back();
+        _free_instances.pop_back();
+    }
+    else {
+        region.instance_i = instances.add_instance(_empty_mesh, glm::mat4(1));
+        reserve_tables(device, instances);
+    }
+    // only the mesh index differs from what frames in flight read, they see either the previous mesh or this one
+    instances._instances[region.instance_i].mesh_i = mesh_i;
+    instances.update_instance(vmalloc, region.instance_i);
+    _regions[record.region] = region;
+}
+void MeshStream::grow_geometry(Device& device, MeshInstances& instances, uint32_t vertex_chunks, uint32_t index_chunks) {
+    Trace::Zone zone("MeshStream::grow_geometry");
+    // at least double whichever ran out, so growing stays rare
+    if (vertex_chunks > 0) vertex_chunks = std::max(vertex_chunks, _vertex_chunks._count);
+    if (index_chunks > 0) index_chunks = std::max(index_chunks, _index_chunks._count);
+    Mesh<Vertex, Index> geometry;
+    geometry.init(device._vmalloc, {}, {},
+        _vertex_base + (_vertex_chunks._count + vertex_chunks) * chunk_vertices,
+        _index_base + (_index_chunks._count + index_chunks) * chunk_indices);
+
+    // the current buffers may still be read by frames in flight
+    device._logical.waitIdle();
+    if (instances._uploaded) {
+        Mesh<Vertex, Index>& current = instances._geometry;
+        vk::CommandBuffer cmd = device.command_begin(QueueType::eUniversal);
+        cmd.copyBuffer(current._vertices._buffer._data, geometry._vertices._buffer._data, vk::BufferCopy { .size = current._vertices._buffer._size });
+        if (current._indices._capacity > 0) {
+            cmd.copyBuffer(current._indices._buffer._data, geometry._indices._buffer._data, vk::BufferCopy { .size = current._indices._buffer._size });
+        }
+        device.submit(QueueType::eUniversal, cmd).wait();
+        current.destroy(device._vmalloc);
+    }
+    instances._geometry = geometry;
+    _vertex_chunks.grow(vertex_chunks);
+    _index_chunks.grow(index_chunks);
+    instances._version++;
+}
+void MeshStream::reserve_tables(Device& device, MeshInstances& instances) {
+    uint32_t mesh_count = (uint32_t)instances._meshes.size();
+    uint32_t instance_count = (uint32_t)instances._instances.size();
+    if (mesh_count <= instances._mesh_capacity && instance_count <= instances._instance_capacity) return;
+    device._logical.waitIdle();
+    instances.reserve(device._vmalloc, std::max(mesh_count, 2 * instances._mesh_capacity), std::max(instance_count, 2 * instances._instance_capacity));
+}
+auto MeshStream::allocate_mesh(Device& device, MeshInstances& instances) -> uint32_t {
+    if (!_free_meshes.empty()) {
+        uint32_t mesh_i = _free_meshes.back();
+        _free_meshes.pop_back();
+        return mesh_i;
+    }
+    uint32_t mesh_i = instances.add_mesh({}, {}, false);
+    reserve_tables(device, instances);
+    return mesh_i;
+}
+void MeshStream::retire(const Region& region) {
+    _retired.push_back({ .frame = _frame, .mesh_i = region.mesh_i, .vertices = region.vertices, .indices = region.indices });
+}
+
+auto MeshStream::Chunks::allocate(uint32_t count) -> std::optional<Run> {
+    // first fit keeps the used chunks packed towards the start
+    for (auto it = _free.begin(); it != _free.end(); it++) {
+        if (it->count < count) continue;
+        Run run { it->first, count };
+        it->first += count;
+        it->count -= count;
+        if (it->count == 0) _free.erase(it);
+        return run;
+    }
+    return std::nullopt;
+}
+void MeshStream::Chunks::free(Run run) {
+    if (run.count == 0) return;
+    auto it = std::lower_bound(_free.begin(), _free.end(), run.first, [](const Run& free, uint32_t first) { return free.first < first; });
+    it = _free.insert(it, run);
+    if (it + 1 != _free.end() && it->first + it->count == (it + 1)->first) {
+        it->count += (it + 1)->count;
+        _free.erase(it + 1);
+    }
+    if (it != _free.begin() && (it - 1)->first + (it - 1)->count == it->first) {
+        (it - 1)->count += it->count;
+        _free.erase(it);
+    }
+}
+void MeshStream::Chunks::grow(uint32_t count) {
+    free({ _count, count });
+    _count += count;
+}
+
+void MeshStream::read_loop(std::shared_ptr<Reader> reader_p) {
+    Reader& reader = *reader_p;
+    // opening a named pipe blocks until a writer connects
+    std::ifstream file(reader.path, std::ios::binary);
+    if (!file) {
+        std::println("Mesh stream not found: {}", reader.path.string());
+        return;
+    }
+    // exactly size bytes, waiting at the end of the stream for the writer to append more. false once stopped
+    auto read = [&](void* dst_p, std::size_t size) {
+        std::size_t filled = 0;
+        while (filled < size) {
+            if (reader.stop.load(std::memory_order_relaxed)) return false;
+            file.read(static_cast<char*>(dst_p) + filled, (std::streamsize)(size - filled));
+            filled += (std::size_t)file.gcount();
+            if (filled == size) break;
+            // seeking in place resets the end of file state of buffered C streams, pipes simply fail it
+            file.clear();
+            file.seekg(0, std::ios::cur);
+            file.clear();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return true;
+    };
+
+    std::array<char, sizeof(Header)> bytes;
+    bool synced = true;
+    while (read(bytes.data(), bytes.size())) {
+        // skip garbage byte by byte until a plausible header shows up
+        Header header;
+        std::memcpy(&header, bytes.data(), sizeof(Header));
+        if (header.magic != magic || header.vertex_count > max_count || header.index_count > max_count) {
+            if (synced) std::println("Mesh stream {} is corrupted, skipping to the next record", reader.path.string());
+            synced = false;
+            std::memmove(bytes.data(), bytes.data() + 1, bytes.size() - 1);
+            if (!read(bytes.data() + bytes.size() - 1, 1)) return;
+            continue;
+        }
+        synced = true;
+
+        Record record { .region = header.region };
+        record.vertices.resize(header.vertex_count);
+        record.indices.resize(header.index_count);
+        if (!read(record.vertices.data(), sizeof(Vertex) * record.vertices.size())) return;
+        if (!read(record.indices.data(), sizeof(Index) * record.indices.size())) return;
+
+        // wait for the render thread to catch up if it fell behind
+        reader.pending.fetch_add(1, std::memory_order_release);
+        while (!reader.queue.push(std::move(record))) {
+            if (reader.stop.load(std::memory_order_relaxed)) return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        std::scoped_lock lock(reader.mutex);
+        if (reader.on_record) reader.on_record();
+    }
+}
+auto MeshStream::prepare(Record& record) -> bool {
+    Trace::Zone zone("MeshStream::prepare");
+    uint32_t vertex_count = (uint32_t)record.vertices.size();
+    bool valid = record.indices.size() % 3 == 0 && std::ranges::all_of(record.indices, [vertex_count](Index index) { return index < vertex_count; });
+    if (!valid) {
+        std::println("Mesh stream region {} has indices out of range, skipping it", record.region);
+        return false;
+    }
+    record.bounds = MeshInstances::get_bounds(record.vertices);
+    record.bvh.build(std::span<const Vertex>(record.vertices), std::span<const Index>(record.indices));
+    return true;
+}
\ No newline at end of file